@@ -130,6 +130,37 @@ VideoFrameQueue::VideoFrameQueue(ConnectionData cData, const StreamInfo *si,
 {
 }
 
+Frame* VideoFrameQueue::getRear()
+{
+    Frame *frame;
+    InterleavedVideoFrame *vFrame;
+
+    frame = AVFramedQueue::getRear();
+    vFrame = dynamic_cast<InterleavedVideoFrame*>(frame);
+
+    if (vFrame) {
+        vFrame->detachBuffer();
+    }
+
+    return frame;
+}
+
+int VideoFrameQueue::removeFrame()
+{
+    InterleavedVideoFrame *vFrame;
+    size_t last = (front + (max - 1)) % max;
+
+    //Removed frame is still returned by forceGetFront, so only the previous one is released
+    if (rear != front && last != rear) {
+        vFrame = dynamic_cast<InterleavedVideoFrame*>(frames[last]);
+        if (vFrame) {
+            vFrame->releaseView();
+        }
+    }
+
+    return AVFramedQueue::removeFrame();
+}
+
 bool VideoFrameQueue::setup()
 {
     switch(streamInfo->video.codec) {
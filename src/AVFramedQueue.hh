@@ -100,6 +100,16 @@ public:
     static VideoFrameQueue* createNew(ConnectionData cData, const StreamInfo *si,
             unsigned maxFrames);
 
+    /**
+    * See FrameQueue::getRear. Returned frame is detached from any shared buffer
+    */
+    virtual Frame *getRear();
+
+    /**
+    * See FrameQueue::removeFrame. Views held by already consumed frames are released
+    */
+    int removeFrame();
+
 protected:
     VideoFrameQueue(ConnectionData cData, const StreamInfo *si, unsigned maxFrames);
 
@@ -24,6 +24,11 @@
 #include "Utils.hh"
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define MAX_DEVIATION_SAMPLES 64
 
@@ -43,56 +48,131 @@ AudioCircularBuffer* AudioCircularBuffer::createNew(struct ConnectionData cData,
 
 AudioCircularBuffer::AudioCircularBuffer(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt)
 : FrameQueue(cData), channels(ch), sampleRate(sRate), bytesPerSample(0), chMaxSamples(maxSamples), channelMaxLength(0), 
-sampleFormat(sFmt), fillNewFrame(true), samplesBufferingThreshold(0), bufferingState(BUFFERING), 
-inputFrame(NULL), outputFrame(NULL), dummyFrame(NULL), synchronized(false), setupSuccess(false), tsDeviationThreshold(0), elements(0)
+channelsAllocated(0), sampleFormat(sFmt), fillNewFrame(true), samplesBufferingThreshold(0), bufferingState(BUFFERING), 
+adaptive(false), targetSamples(0), jitterUs(0), jitter(0), arrivalReference(false), avgLevel(0), phase(0),
+inputFrame(NULL), outputFrame(NULL), outputBytes(0), outSamples(0), rearPos(0), frontPos(0), discardPos(0), syncTimestamp(0), 
+orgTime(0), synchronized(false), setupSuccess(false), tsDeviationThreshold(0)
 {
 
 }
 
 AudioCircularBuffer::~AudioCircularBuffer()
 {
-    if (setupSuccess) {
-
-        for (unsigned i=0; i<channels; i++) {
-            delete[] data[i];
-        }        
-        
-        delete inputFrame;
-        delete outputFrame;
+    for (unsigned i=0; i<channelsAllocated; i++) {
+        munmap(data[i], 2*channelMaxLength);
     }
+
+    delete inputFrame;
+    delete outputFrame;
 }
 
 void AudioCircularBuffer::setBufferingThreshold(std::chrono::milliseconds th)
 {
     samplesBufferingThreshold = th.count()*sampleRate/std::milli::den;
+    targetSamples = samplesBufferingThreshold;
+}
+
+void AudioCircularBuffer::setAdaptiveBuffering(bool enable)
+{
+    if (!enable) {
+        targetSamples = samplesBufferingThreshold;
+    }
+
+    adaptive = enable;
+}
+
+std::chrono::microseconds AudioCircularBuffer::getTargetDepth()
+{
+    return std::chrono::microseconds((uint64_t) targetSamples.load(std::memory_order_relaxed)*std::micro::den/sampleRate);
 }
 
 Frame* AudioCircularBuffer::getRear()
 {
+    size_t rear = rearPos.load(std::memory_order_relaxed);
+    size_t front = frontPos.load(std::memory_order_acquire);
+
+    //The producer writes in place if a whole frame fits, otherwise it is copied at addFrame
+    if (channelMaxLength - (rear - front) >= inputFrame->getMaxLength()) {
+        inputFrame->setView(data, rear % channelMaxLength);
+    } else {
+        inputFrame->releaseView();
+    }
+
     return inputFrame;
 }
 
 Frame* AudioCircularBuffer::getFront()
 {
-    std::chrono::microseconds ts;
-    unsigned frontSampleIdx;
-
-    std::lock_guard<std::mutex> guard(mtx);
+    size_t rear, front, discard, elements;
+    int64_t syncTs;
+    unsigned target;
+    double ratio = 1;
 
     if (!fillNewFrame) {
         return outputFrame;
     }
 
-    frontSampleIdx = front/bytesPerSample;
-    ts = std::chrono::microseconds(frontSampleIdx*std::micro::den/sampleRate) + syncTimestamp;
-    outputFrame->setPresentationTime(ts);
+    rear = rearPos.load(std::memory_order_acquire);
+    discard = discardPos.load(std::memory_order_acquire);
+    syncTs = syncTimestamp.load(std::memory_order_acquire);
+
+    //A flush in between means that the timestamp may not describe this data, it is read again next time
+    if (discard != discardPos.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+
+    front = frontPos.load(std::memory_order_relaxed);
+
+    if (front < discard) {
+        front = discard;
+        frontPos.store(front, std::memory_order_release);
+        outSamples = front/bytesPerSample;
+    }
+
+    elements = rear > front ? rear - front : 0;
+    outputBytes = outputFrame->getSamples()*bytesPerSample;
+
+    target = targetSamples.load(std::memory_order_relaxed);
 
-    if (!popFront(outputFrame->getPlanarDataBuf(), outputFrame->getSamples())) {
+    if (elements < outputBytes) {
         utils::debugMsg("There is not enough data to fill a frame. Impossible to get new frame!");
+        bufferingState = BUFFERING;
+        return NULL;
+    }
+
+    if (adaptive) {
+        //After an underrun, output restarts once the target depth is reached
+        if (bufferingState == BUFFERING && elements < target * bytesPerSample + outputBytes) {
+            return NULL;
+        }
+
+        if (bufferingState == BUFFERING) {
+            avgLevel = elements/bytesPerSample;
+            outSamples = front/bytesPerSample;
+        }
+
+        ratio = driftCorrection(elements, target);
+
+    } else if (elements < target * bytesPerSample) {
+        bufferingState = BUFFERING;
         return NULL;
     }
 
-    outputFrame->setOriginTime(orgTime - std::chrono::microseconds(elements*std::micro::den/(bytesPerSample*sampleRate)));
+    bufferingState = OK;
+
+    if (ratio != 1) {
+        resampleOutput(front, ratio);
+    } else {
+        phase = 0;
+        outSamples = front/bytesPerSample;
+        outputFrame->setView(data, front % channelMaxLength);
+    }
+
+    //Resampled frames do not match their ring position, they are timestamped by the output sample count
+    outputFrame->setPresentationTime(std::chrono::microseconds(syncTs) + 
+                                     std::chrono::microseconds(outSamples*std::micro::den/sampleRate));
+    outputFrame->setOriginTime(std::chrono::system_clock::time_point(std::chrono::microseconds(orgTime.load(std::memory_order_relaxed))) 
+                               - std::chrono::microseconds(elements/bytesPerSample*std::micro::den/sampleRate));
     
     fillNewFrame = false;
     return outputFrame;
@@ -103,18 +183,22 @@ int AudioCircularBuffer::addFrame()
     std::chrono::microseconds inTs;
     std::chrono::microseconds rearTs;
     std::chrono::microseconds deviation;
-    unsigned paddingSamples;
-    unsigned rearSampleIdx;
+    unsigned paddingSamples = 0;
+    size_t rear;
 
     inTs = inputFrame->getPresentationTime();
+    rear = rearPos.load(std::memory_order_relaxed);
+
+    if (adaptive) {
+        updateJitter(inTs);
+    }
 
     if (!synchronized) {
-        syncTimestamp = inTs;
+        syncTimestamp.store((inTs - positionToTime(rear)).count(), std::memory_order_release);
         synchronized = true;
     }
 
-    rearSampleIdx = rear/bytesPerSample;
-    rearTs = std::chrono::microseconds(rearSampleIdx*std::micro::den/sampleRate) + syncTimestamp;
+    rearTs = std::chrono::microseconds(syncTimestamp.load(std::memory_order_relaxed)) + positionToTime(rear);
     deviation = inTs - rearTs;
 
     if (deviation.count() < -tsDeviationThreshold) {
@@ -132,38 +216,34 @@ int AudioCircularBuffer::addFrame()
             flush();
             return -1;
         }
-
-        if(!pushBack(dummyFrame->getPlanarDataBuf(), paddingSamples)) {
-            utils::warningMsg("[AudioCircularBuffer] Cannot push padding");
-            return -1;
-        }
     }
 
-    if(!pushBack(inputFrame->getPlanarDataBuf(), inputFrame->getSamples())) {
+    if(!pushBack(paddingSamples)) {
         utils::warningMsg("[AudioCircularBuffer] Cannot push frame");
         return -1;
     }
     
-    std::lock_guard<std::mutex> guard(mtx);
-    
-    orgTime = inputFrame->getOriginTime();
-    
     return connectionData.rFilterId;
 }
 
 int AudioCircularBuffer::removeFrame()
 {
+    //The frame keeps pointing to the ring, its samples may be overwritten from now on
+    if (!fillNewFrame) {
+        frontPos.store(frontPos.load(std::memory_order_relaxed) + outputBytes, std::memory_order_release);
+        outSamples += outputFrame->getSamples();
+    }
+
     fillNewFrame = true;
     return connectionData.wFilterId;
 }
 
 void AudioCircularBuffer::doFlush()
 {
-    std::lock_guard<std::mutex> guard(mtx);
-    rear = 0;
-    front = 0;
-    elements = 0;
+    //Called by the producer, the consumer skips the discarded data at its next getFront
+    discardPos.store(rearPos.load(std::memory_order_relaxed), std::memory_order_release);
     synchronized = false;
+    arrivalReference = false;
 }
 
 
@@ -177,9 +257,42 @@ Frame* AudioCircularBuffer::forceGetFront()
     return outputFrame;
 }
 
+unsigned char* AudioCircularBuffer::allocMirroredRing(size_t length)
+{
+    unsigned char *ring;
+    void *first, *second;
+
+    //Reserve the address space for both copies
+    ring = (unsigned char*) mmap(NULL, 2*length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ring == MAP_FAILED) {
+        return NULL;
+    }
+
+    first = mmap(ring, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+
+    if (first == MAP_FAILED) {
+        munmap(ring, 2*length);
+        return NULL;
+    }
+
+    //A zero old size duplicates the shared mapping, so both halves share the same pages
+    second = mremap(first, 0, length, MREMAP_MAYMOVE | MREMAP_FIXED, ring + length);
+
+    if (second == MAP_FAILED) {
+        munmap(ring, 2*length);
+        return NULL;
+    }
+
+    return ring;
+}
+
 bool AudioCircularBuffer::setup()
 {
-    if (channels <= 0 || sampleRate <= 0 || chMaxSamples <= 0) {
+    size_t pageSize;
+    size_t maxFrameSamples;
+
+    if (channels <= 0 || channels > MAX_CHANNELS || sampleRate <= 0 || chMaxSamples <= 0) {
         return false;
     }
 
@@ -199,16 +312,26 @@ bool AudioCircularBuffer::setup()
             return false;
     }
 
+    //Mappings are page granular
+    pageSize = sysconf(_SC_PAGESIZE);
     channelMaxLength = chMaxSamples*(sampleRate/1000) * bytesPerSample;
+    channelMaxLength = ((channelMaxLength + pageSize - 1)/pageSize)*pageSize;
+    maxFrameSamples = std::min((size_t) AudioFrame::getMaxSamples(sampleRate), channelMaxLength/bytesPerSample/2);
 
     for (unsigned i=0; i<channels; i++) {
-        data[i] = new unsigned char [channelMaxLength]();
+        data[i] = allocMirroredRing(channelMaxLength);
+
+        if (!data[i]) {
+            utils::errorMsg("[Audio Circular Buffer] Could not map the ring buffer");
+            return false;
+        }
+
+        channelsAllocated++;
     }
 
-    inputFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, sampleFormat);
-    outputFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, sampleFormat);
-    dummyFrame = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, sampleFormat);
-    dummyFrame->fillWithValue(0);
+    //Frames can not be longer than half the ring, so that small rings still hold two of them
+    inputFrame = PlanarAudioFrame::createNew(channels, sampleRate, maxFrameSamples, PCM, sampleFormat);
+    outputFrame = PlanarAudioFrame::createNew(channels, sampleRate, maxFrameSamples, PCM, sampleFormat);
 
     outputFrame->setSamples(AudioFrame::getDefaultSamples(sampleRate));
     outputFrame->setLength(AudioFrame::getDefaultSamples(sampleRate)*bytesPerSample);
@@ -219,110 +342,152 @@ bool AudioCircularBuffer::setup()
     return true;
 }
 
+std::chrono::microseconds AudioCircularBuffer::positionToTime(size_t position)
+{
+    return std::chrono::microseconds((position/bytesPerSample)*std::micro::den/sampleRate);
+}
 
-bool AudioCircularBuffer::pushBack(unsigned char **buffer, int samplesRequested)
+bool AudioCircularBuffer::pushBack(unsigned paddingSamples)
 {
-    unsigned bytesRequested = samplesRequested * bytesPerSample;
-    unsigned rearMod;
-    int firstCopiedBytes;
+    size_t paddingBytes = paddingSamples * bytesPerSample;
+    size_t frameBytes = inputFrame->getSamples() * bytesPerSample;
+    size_t rear = rearPos.load(std::memory_order_relaxed);
+    size_t front = frontPos.load(std::memory_order_acquire);
+    size_t rearMod;
 
-    if (bytesRequested > (channelMaxLength - elements)) {
+    if (paddingBytes + frameBytes > channelMaxLength - (rear - front)) {
         return false;
     }
 
     rearMod = rear % channelMaxLength;
 
-    if ((rearMod + bytesRequested) < channelMaxLength) {
-
-        for (unsigned i=0; i<channels; i++) {
-            memcpy(data[i] + rearMod, buffer[i], bytesRequested);
+    //Thanks to the mirrored mapping, spans crossing the end of the ring are contiguous
+    for (unsigned i=0; i<channels; i++) {
+        if (inputFrame->isView()) {
+            //The frame has been written in place, it is moved behind the padding
+            if (paddingBytes > 0) {
+                memmove(data[i] + rearMod + paddingBytes, data[i] + rearMod, frameBytes);
+            }
+        } else {
+            memcpy(data[i] + rearMod + paddingBytes, inputFrame->getPlanarDataBuf()[i], frameBytes);
         }
 
-    } else {
-
-        firstCopiedBytes = channelMaxLength - rearMod;
-        
-        for (unsigned i=0; i<channels;  i++) {
-            memcpy(data[i] + rearMod, buffer[i], firstCopiedBytes);
-            memcpy(data[i], buffer[i] + firstCopiedBytes, bytesRequested - firstCopiedBytes);
-        }
+        memset(data[i] + rearMod, 0, paddingBytes);
     }
 
-    elements += bytesRequested;
-    rear += bytesRequested;
+    orgTime.store(std::chrono::duration_cast<std::chrono::microseconds>(inputFrame->getOriginTime().time_since_epoch()).count(), 
+                  std::memory_order_relaxed);
+    rearPos.store(rear + paddingBytes + frameBytes, std::memory_order_release);
     return true;
 }
 
-bool AudioCircularBuffer::popFront(unsigned char **buffer, unsigned samplesRequested)
+void AudioCircularBuffer::updateJitter(std::chrono::microseconds inTs)
 {
-    unsigned bytesRequested = samplesRequested * bytesPerSample;
-
-    if (elements < bytesRequested) {
-        return false;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    int64_t transitDiff;
+    size_t maxTarget;
+    size_t target;
+
+    //Interarrival jitter estimation as defined in RFC 3550
+    if (arrivalReference) {
+        transitDiff = std::chrono::duration_cast<std::chrono::microseconds>(now - lastArrival).count() 
+                      - (inTs - lastInTs).count();
+        jitter += (std::abs(transitDiff) - jitter)/16;
+        jitterUs.store(jitter, std::memory_order_relaxed);
     }
 
-    if (elements < samplesBufferingThreshold * bytesPerSample) {
-        bufferingState = BUFFERING;
-    } else {
-	    bufferingState = OK;
-    }
+    lastArrival = now;
+    lastInTs = inTs;
+    arrivalReference = true;
 
-    if (bufferingState == BUFFERING) {
-	   return false;
-    }
-
-    fillOutputBuffers(buffer, bytesRequested);
+    maxTarget = channelMaxLength/bytesPerSample/2;
+    target = JITTER_DEPTH_FACTOR*jitter*sampleRate/std::micro::den;
+    target = std::max(target, (size_t) samplesBufferingThreshold);
+    target = std::min(target, maxTarget);
 
-    return true;
+    targetSamples.store(target, std::memory_order_relaxed);
 }
 
-void AudioCircularBuffer::fillOutputBuffers(unsigned char **buffer, int bytesRequested)
+double AudioCircularBuffer::driftCorrection(size_t elements, unsigned target)
 {
-    int firstCopiedBytes = 0;
-    unsigned frontMod;
+    double error;
+    double correction;
 
-    frontMod = front % channelMaxLength;
+    //The depth is smoothed so that only the drift is compensated, not the jitter
+    avgLevel += (elements/bytesPerSample - avgLevel)/32;
+    error = avgLevel - target;
 
-    if (frontMod + bytesRequested < channelMaxLength) {
-        for (unsigned i=0; i<channels; i++) {
-            memcpy(buffer[i], data[i] + frontMod, bytesRequested);
-        }
+    if (std::abs(error) < DRIFT_DEADBAND*sampleRate/std::milli::den) {
+        return 1;
+    }
 
-    } else {
-        firstCopiedBytes = channelMaxLength - frontMod;
+    //The error is recovered in DRIFT_CORRECTION_TIME, with a bounded pitch deviation
+    correction = error/(sampleRate*DRIFT_CORRECTION_TIME);
+    correction = std::max(-MAX_DRIFT_CORRECTION, std::min(MAX_DRIFT_CORRECTION, correction));
 
-        for (unsigned i=0; i<channels;  i++) {
-            memcpy(buffer[i], data[i] + frontMod, firstCopiedBytes);
-            memcpy(buffer[i] + firstCopiedBytes, data[i], bytesRequested - firstCopiedBytes);
-        }
+    //Reading faster needs data beyond the frame, and interpolating needs the next sample
+    if ((phase + outputFrame->getSamples()*(1 + correction) + 1)*bytesPerSample > elements) {
+        return 1;
     }
 
-    elements -= bytesRequested;
-    front += bytesRequested;
+    return 1 + correction;
 }
 
-int AudioCircularBuffer::getFreeSamples()
+template <typename T>
+static void interpolate(const unsigned char *in, unsigned char *out, unsigned samples, double phase, double ratio)
 {
-    int freeBytes = channelMaxLength - elements;
-
-    if (freeBytes == 0) {
-        return freeBytes;
+    const T *src = reinterpret_cast<const T*>(in);
+    T *dst = reinterpret_cast<T*>(out);
+    double pos, frac;
+    size_t idx;
+
+    for (unsigned i = 0; i < samples; i++) {
+        pos = phase + i*ratio;
+        idx = (size_t) pos;
+        frac = pos - idx;
+        dst[i] = (T) (src[idx] + (src[idx + 1] - src[idx])*frac);
     }
-
-    return (freeBytes/bytesPerSample);
 }
 
-bool AudioCircularBuffer::forcePushBack(unsigned char **buffer, int samplesRequested)
+void AudioCircularBuffer::resampleOutput(size_t front, double ratio)
 {
-    if(!pushBack(inputFrame->getPlanarDataBuf(), inputFrame->getSamples())) {
-        utils::debugMsg("There is not enough free space in the buffer. Discarding samples");
-        if (getFreeSamples() != 0) {
-            pushBack(inputFrame->getPlanarDataBuf(), getFreeSamples());
+    unsigned samples = outputFrame->getSamples();
+    unsigned char **planes;
+    size_t consumed;
+    double end;
+
+    //The output frame can not be a view, it holds samples that are not in the ring
+    outputFrame->releaseView();
+    planes = outputFrame->getPlanarDataBuf();
+
+    for (unsigned i = 0; i < channels; i++) {
+        switch(sampleFormat) {
+            case U8P:
+                interpolate<uint8_t>(data[i] + front % channelMaxLength, planes[i], samples, phase, ratio);
+                break;
+            case S16P:
+                interpolate<int16_t>(data[i] + front % channelMaxLength, planes[i], samples, phase, ratio);
+                break;
+            case FLTP:
+                interpolate<float>(data[i] + front % channelMaxLength, planes[i], samples, phase, ratio);
+                break;
+            default:
+                break;
         }
-        return false;
     }
 
-    return true;
+    end = phase + samples*ratio;
+    consumed = (size_t) end;
+    phase = end - consumed;
+    outputBytes = consumed*bytesPerSample;
+}
+
+int AudioCircularBuffer::getFreeSamples()
+{
+    size_t rear = rearPos.load(std::memory_order_relaxed);
+    size_t front = frontPos.load(std::memory_order_acquire);
+
+    return (channelMaxLength - (rear - front))/bytesPerSample;
 }
 
 void AudioCircularBuffer::setOutputFrameSamples(int samples) 
@@ -333,6 +498,12 @@ void AudioCircularBuffer::setOutputFrameSamples(int samples)
 
 unsigned AudioCircularBuffer::getElements() 
 {
-    return elements/(outputFrame->getSamples()*bytesPerSample);
-};
+    size_t rear = rearPos.load(std::memory_order_acquire);
+    size_t front = std::max(frontPos.load(std::memory_order_acquire), discardPos.load(std::memory_order_acquire));
 
+    if (rear <= front) {
+        return 0;
+    }
+
+    return (rear - front)/(outputFrame->getSamples()*bytesPerSample);
+};
@@ -26,13 +26,22 @@
 #include "Types.hh"
 #include "FrameQueue.hh"
 #include "AudioFrame.hh"
-#include <mutex>
+#include <atomic>
 
 #define DEFAULT_BUFFER_SIZE 32768 //samples (~600ms at 48KHz)
 #define BUFFERING_THRESHOLD 40 //ms
 
+#define JITTER_DEPTH_FACTOR 4 //target depth in measured jitters
+#define DRIFT_DEADBAND 2 //ms
+#define DRIFT_CORRECTION_TIME 1 //s
+#define MAX_DRIFT_CORRECTION 0.005 //relative rate deviation
 
- class AudioCircularBuffer : public FrameQueue {
+/*! Single producer single consumer audio buffer. Each channel is a ring mapped twice in
+    consecutive virtual memory, so any span of up to one ring length is contiguous and
+    frames are read and written in place. Positions are atomic byte counters, so there
+    is no lock between the producer and the consumer
+*/
+class AudioCircularBuffer : public FrameQueue {
 
 public:
     static AudioCircularBuffer* createNew(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt, std::chrono::milliseconds bufferingThreshold);
@@ -50,45 +59,77 @@ public:
     int getFreeSamples();
     void setBufferingThreshold(std::chrono::milliseconds th);
     unsigned getChannelMaxSamples() {return chMaxSamples;};
+    unsigned getSampleRate() {return sampleRate;};
     unsigned getElements();
 
+    /**
+    * Enables the adaptive jitter buffer. The buffering threshold becomes the minimum depth, the
+    * target depth follows the inter-arrival jitter and the depth is kept around it by slightly
+    * resampling the output instead of dropping or padding samples
+    * @param enable true to enable it
+    */
+    void setAdaptiveBuffering(bool enable);
+    bool getAdaptiveBuffering() {return adaptive;};
+    std::chrono::microseconds getJitter() {return std::chrono::microseconds(jitterUs.load(std::memory_order_relaxed));};
+    std::chrono::microseconds getTargetDepth();
+
 private:
     AudioCircularBuffer(struct ConnectionData cData, unsigned ch, unsigned sRate, unsigned maxSamples, SampleFmt sFmt);
 
     enum State {BUFFERING, OK, FULL};
 
-    bool pushBack(unsigned char **buffer, int samplesRequested);
-    bool forcePushBack(unsigned char **buffer, int samplesRequested);
-    bool popFront(unsigned char **buffer, unsigned samplesRequested);
-    void fillOutputBuffers(unsigned char **buffer, int bytesRequested);
+    bool pushBack(unsigned paddingSamples);
+    void updateJitter(std::chrono::microseconds inTs);
+    double driftCorrection(size_t elements, unsigned target);
+    void resampleOutput(size_t front, double ratio);
+    size_t effectiveFront();
+    std::chrono::microseconds positionToTime(size_t position);
+    unsigned char* allocMirroredRing(size_t length);
     bool setup();
 
     unsigned channels;
     unsigned sampleRate;
     unsigned bytesPerSample;
     unsigned chMaxSamples;
-    unsigned channelMaxLength;
+    size_t channelMaxLength;
     unsigned char *data[MAX_CHANNELS];
+    unsigned channelsAllocated;
     SampleFmt sampleFormat;
     bool fillNewFrame;
 
     unsigned samplesBufferingThreshold;
     State bufferingState;
 
+    //Adaptive buffering, the target depth is computed by the producer
+    std::atomic<bool> adaptive;
+    std::atomic<unsigned> targetSamples;
+    std::atomic<int64_t> jitterUs;
+    double jitter;
+    bool arrivalReference;
+    std::chrono::steady_clock::time_point lastArrival;
+    std::chrono::microseconds lastInTs;
+    double avgLevel;
+    double phase;
+
     PlanarAudioFrame* inputFrame;
     PlanarAudioFrame* outputFrame;
-    PlanarAudioFrame* dummyFrame;
+    size_t outputBytes;
+    //Output sample count, it follows the ring position while the output is not resampled
+    size_t outSamples;
+
+    //Byte positions, written by one side and read by the other
+    std::atomic<size_t> rearPos;
+    std::atomic<size_t> frontPos;
+    std::atomic<size_t> discardPos;
+
+    //Timestamp of byte position 0 and origin time of the last frame (us)
+    std::atomic<int64_t> syncTimestamp;
+    std::atomic<int64_t> orgTime;
 
-    std::chrono::microseconds syncTimestamp;
     bool synchronized;
     bool setupSuccess;
-    
-    std::chrono::system_clock::time_point orgTime;
 
     int tsDeviationThreshold;
-    std::mutex mtx;
-
-    unsigned elements;
 };
 
 #endif
@@ -98,12 +98,13 @@ PlanarAudioFrame* PlanarAudioFrame::createNew(int ch, int sRate, int maxSamples,
 }
 
 PlanarAudioFrame::PlanarAudioFrame(int ch, int sRate, int maxSamples, ACodecType codec, SampleFmt sFmt)
-: AudioFrame(ch, sRate, maxSamples, codec, sFmt)
+: AudioFrame(ch, sRate, maxSamples, codec, sFmt), view(false)
 {
     bufferMaxLen = bytesPerSample * maxSamples;
 
     for (int i=0; i<MAX_CHANNELS; i++) {
         frameBuff[i] = new unsigned char [bufferMaxLen]();
+        planes[i] = frameBuff[i];
     }
 }
 
@@ -117,6 +118,24 @@ PlanarAudioFrame::~PlanarAudioFrame()
 void PlanarAudioFrame::fillWithValue(int value)
 {
     for (unsigned i = 0; i < channels; i++) {
-        memset(frameBuff[i], value, bufferMaxLen);
+        memset(planes[i], value, bufferMaxLen);
+    }
+}
+
+void PlanarAudioFrame::setView(unsigned char **data, unsigned offset)
+{
+    for (unsigned i = 0; i < channels && i < MAX_CHANNELS; i++) {
+        planes[i] = data[i] + offset;
+    }
+
+    view = true;
+}
+
+void PlanarAudioFrame::releaseView()
+{
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        planes[i] = frameBuff[i];
     }
+
+    view = false;
 } 
\ No newline at end of file
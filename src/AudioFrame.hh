@@ -90,16 +90,32 @@ class PlanarAudioFrame : public AudioFrame {
         ~PlanarAudioFrame();
 
         unsigned char *getDataBuf() {return NULL;};
-        unsigned char** getPlanarDataBuf() {return frameBuff;};
+        unsigned char** getPlanarDataBuf() {return planes;};
         unsigned int getLength() {return bufferLen;};
         unsigned int getMaxLength() {return bufferMaxLen;};
         bool isPlanar() {return true;};
         void setLength(unsigned int length) {bufferLen = length;};
         void fillWithValue(int value);
 
+        /**
+        * Makes the frame point to external planes (at the same offset) instead of its own buffers.
+        * The planes must hold at least getMaxLength() bytes from the offset and outlive the view
+        * @param data external planes, one per channel
+        * @param offset bytes from the beginning of each plane
+        */
+        void setView(unsigned char **data, unsigned offset);
+
+        /**
+        * Makes the frame point back to its own buffers
+        */
+        void releaseView();
+        bool isView() {return view;};
+
     private:
         PlanarAudioFrame(int ch, int sRate, int maxSamples, ACodecType codec, SampleFmt sFmt);
         unsigned char* frameBuff[MAX_CHANNELS];
+        unsigned char* planes[MAX_CHANNELS];
+        bool view;
         unsigned int bufferLen;
         unsigned int bufferMaxLen;
 };
@@ -239,6 +239,10 @@ void Controller::initializeEventMap()
                                             std::placeholders::_1, std::placeholders::_2);
     eventMap["createFilter"] = std::bind(&PipelineManager::createFilterEvent, pipeMngrInstance,
                                             std::placeholders::_1, std::placeholders::_2);
+    eventMap["configRateControl"] = std::bind(&PipelineManager::configRateControlEvent, pipeMngrInstance,
+                                            std::placeholders::_1, std::placeholders::_2);
+    eventMap["configEncoderBudget"] = std::bind(&PipelineManager::configEncoderBudgetEvent, pipeMngrInstance,
+                                            std::placeholders::_1, std::placeholders::_2);
     eventMap["stop"] = std::bind(&PipelineManager::stopEvent, pipeMngrInstance,
                                             std::placeholders::_1, std::placeholders::_2);
 
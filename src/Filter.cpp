@@ -216,6 +216,37 @@ std::vector<int> BaseFilter::addFrames(std::map<int, Frame*> &dFrames)
     return enabledJobs;
 }
 
+void BaseFilter::addAsyncFrames(std::function<bool()> writeFrames)
+{
+    std::vector<int> enabledJobs;
+
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        if (!writeFrames()) {
+            return;
+        }
+
+        for (auto it : writers){
+            if (it.second->isConnected()){
+                enabledJobs.push_back(it.second->getCData().rFilterId);
+            }
+        }
+    }
+
+    enableJobs(enabledJobs);
+}
+
+bool BaseFilter::nextDestinationFrames(std::map<int, Frame*> &dFrames)
+{
+    std::vector<int> enabledJobs;
+
+    enabledJobs = addFrames(dFrames);
+    addedJobs.insert(addedJobs.end(), enabledJobs.begin(), enabledJobs.end());
+
+    return demandDestinationFrames(dFrames);
+}
+
 bool BaseFilter::removeFrames(std::vector<int> framesToRemove)
 {
     bool removed = true;
@@ -508,6 +539,8 @@ std::vector<int> BaseFilter::regularProcessFrame(int& ret)
     
     //TODO: manage ret value
     enabledJobs = addFrames(dFrames);
+    enabledJobs.insert(enabledJobs.end(), addedJobs.begin(), addedJobs.end());
+    addedJobs.clear();
     
     removeFrames(newFrames);
 
@@ -529,6 +562,8 @@ std::vector<int> BaseFilter::serverProcessFrame(int& ret)
     runDoProcessFrame(oFrames, dFrames, newFrames);
 
     enabledJobs = addFrames(dFrames);
+    enabledJobs.insert(enabledJobs.end(), addedJobs.begin(), addedJobs.end());
+    addedJobs.clear();
     removeFrames(newFrames);
     
     ret = 0;
@@ -727,17 +762,28 @@ bool BaseFilter::demandOriginFramesFrameTime(std::map<int, Frame*> &oFrames, std
 }
 
 OneToOneFilter::OneToOneFilter(FilterRole fRole_, bool periodic) :
-    BaseFilter(1, 1, fRole_, periodic)
+    BaseFilter(1, 1, fRole_, periodic), processedFrames(NULL)
 {
 }
 
 bool OneToOneFilter::runDoProcessFrame(std::map<int, Frame*> &oFrames, std::map<int, Frame*> &dFrames, std::vector<int> /*newFrames*/)
 {
-    if (!doProcessFrame(oFrames.begin()->second, dFrames.begin()->second)) {
-        return false;
+    bool processed;
+
+    processedFrames = &dFrames;
+    processed = doProcessFrame(oFrames.begin()->second, dFrames.begin()->second);
+    processedFrames = NULL;
+
+    return processed;
+}
+
+Frame* OneToOneFilter::nextDestinationFrame()
+{
+    if (!processedFrames || !nextDestinationFrames(*processedFrames)) {
+        return NULL;
     }
-    
-    return true;
+
+    return processedFrames->begin()->second;
 }
 
 OneToManyFilter::OneToManyFilter(unsigned writersNum, FilterRole fRole_, bool periodic) :
@@ -844,3 +890,23 @@ bool ManyToOneFilter::runDoProcessFrame(std::map<int, Frame*> &oFrames, std::map
     return true;
 }
 
+ManyToManyFilter::ManyToManyFilter(unsigned readersNum, unsigned writersNum, FilterRole fRole_, bool periodic) :
+    BaseFilter(readersNum, writersNum, fRole_, periodic)
+{
+}
+
+bool ManyToManyFilter::runDoProcessFrame(std::map<int, Frame*> &oFrames, std::map<int, Frame*> &dFrames, std::vector<int> newFrames)
+{
+    if (!doProcessFrame(oFrames, dFrames, newFrames)) {
+        return false;
+    }
+
+    for (auto it : dFrames) {
+        if (it.second->getConsumed()) {
+            it.second->setOriginTime(std::chrono::high_resolution_clock::now());
+            it.second->setSequenceNumber(seqNums[it.first]++);
+        }
+    }
+
+    return true;
+}
@@ -194,6 +194,22 @@ protected:
     BaseFilter(unsigned readersNum = MAX_READERS, unsigned writersNum = MAX_WRITERS, FilterRole fRole_ = REGULAR, bool periodic = false);
 
     std::vector<int> addFrames(std::map<int, Frame*> &dFrames);
+    /**
+    * Writes frames to the writers out of processFrame, e.g. from a filter own thread, and enables
+    * the filters reading them without waiting for the next processFrame. Frames are written by
+    * writeFrames with the filter lock held, so that each queue keeps a single producer.
+    * It must not be called while the filter lock is held by a thread waiting for the calling one.
+    * @param writeFrames writes the frames to the writers queues, it returns false if none was written
+    */
+    void addAsyncFrames(std::function<bool()> writeFrames);
+    /**
+    * Adds the written destination frames and replaces them by new ones, so that a filter can
+    * write several frames (e.g. repeated ones) for the same origin frames in one processFrame.
+    * Their readers are enabled when processFrame returns.
+    * @param dFrames destination frames given to runDoProcessFrame
+    * @return true if there are new destination frames to write
+    */
+    bool nextDestinationFrames(std::map<int, Frame*> &dFrames);
     bool removeFrames(std::vector<int> framesToRemove);
     virtual FrameQueue *allocQueue(struct ConnectionData cData) = 0;
 
@@ -258,6 +274,9 @@ private:
     
     unsigned refReader;
     std::chrono::microseconds syncMargin;
+
+    //Readers of the frames added by nextDestinationFrames
+    std::vector<int> addedJobs;
 };
 
 class OneToOneFilter : public BaseFilter {
@@ -268,11 +287,19 @@ protected:
     using BaseFilter::setFrameTime;
     using BaseFilter::getFrameTime;
 
+    /**
+    * Adds the destination frame written by doProcessFrame and gets a new one, so that
+    * several frames can be written for the same origin frame. It is only valid inside doProcessFrame
+    * @return new destination frame or NULL if there is none
+    */
+    Frame* nextDestinationFrame();
+
 private:
     bool runDoProcessFrame(std::map<int, Frame*> &oFrames, std::map<int, Frame*> &dFrames, std::vector<int> /*newFrames*/);
     
     using BaseFilter::demandOriginFrames;
     using BaseFilter::demandDestinationFrames;
+    using BaseFilter::nextDestinationFrames;
     using BaseFilter::addFrames;
     using BaseFilter::removeFrames;
     using BaseFilter::writers;
@@ -283,6 +310,8 @@ private:
     using BaseFilter::maxReaders;
     using BaseFilter::maxWriters;
     using BaseFilter::mtx;
+
+    std::map<int, Frame*> *processedFrames;
 };
 
 class OneToManyFilter : public BaseFilter {
@@ -400,4 +429,29 @@ private:
     using BaseFilter::mtx;
 };
 
+class ManyToManyFilter : public BaseFilter {
+
+protected:
+    ManyToManyFilter(unsigned readersNum = MAX_READERS, unsigned writersNum = MAX_WRITERS, FilterRole fRole_ = REGULAR, bool periodic = false);
+    virtual bool doProcessFrame(std::map<int, Frame *> &orgFrames, std::map<int, Frame *> &dstFrames, std::vector<int> newFrames) = 0;
+    using BaseFilter::setFrameTime;
+    using BaseFilter::getFrameTime;
+
+private:
+    bool runDoProcessFrame(std::map<int, Frame*> &oFrames, std::map<int, Frame*> &dFrames, std::vector<int> newFrames);
+
+    using BaseFilter::demandOriginFrames;
+    using BaseFilter::demandDestinationFrames;
+    using BaseFilter::addFrames;
+    using BaseFilter::removeFrames;
+    using BaseFilter::writers;
+    using BaseFilter::readers;
+    using BaseFilter::seqNums;
+    using BaseFilter::processEvent;
+    using BaseFilter::frameTime;
+    using BaseFilter::maxReaders;
+    using BaseFilter::maxWriters;
+    using BaseFilter::mtx;
+};
+
 #endif
@@ -32,6 +32,7 @@ Frame::Frame()
 void Frame::setPresentationTime(std::chrono::microseconds pTime)
 {
     presentationTime = pTime;
+    decodeTime = pTime;
 }
 
 void Frame::setOriginTime(std::chrono::system_clock::time_point orgTime)
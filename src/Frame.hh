@@ -60,6 +60,18 @@ public:
 
     std::chrono::microseconds getPresentationTime() const {return presentationTime;};
 
+    /**
+    * Set frame decode time, which is reset to the presentation time when the latter is set
+    * @param dTime decode time, earlier than the presentation time for reordered frames
+    */
+    void setDecodeTime(std::chrono::microseconds dTime) {decodeTime = dTime;};
+
+    /**
+    * Gets frame decode time
+    * @return decode time, equal to the presentation time unless frames are reordered
+    */
+    std::chrono::microseconds getDecodeTime() const {return decodeTime;};
+
     /**
     * Gets origin frame time point
     * @return system_clock::time_point frame origin time
@@ -122,6 +134,7 @@ public:
 
 protected:
     std::chrono::microseconds presentationTime;
+    std::chrono::microseconds decodeTime;
     std::chrono::system_clock::time_point originTime;
     size_t sequenceNumber;
     bool consumed;
@@ -27,10 +27,15 @@
 #include "modules/audioDecoder/AudioDecoderLibav.hh"
 #include "modules/audioMixer/AudioMixer.hh"
 #include "modules/videoEncoder/VideoEncoderX264.hh"
+#include "modules/videoEncoder/LadderEncoderX264.hh"
+#include "modules/videoEncoder/VideoEncoderPlugin.hh"
 #include "modules/videoDecoder/VideoDecoderLibav.hh"
 #include "modules/videoMixer/VideoMixer.hh"
 #include "modules/videoSplitter/VideoSplitter.hh"
 #include "modules/videoResampler/VideoResampler.hh"
+#include "modules/videoLadder/VideoLadder.hh"
+#include "modules/frameRateConverter/FrameRateConverter.hh"
+#include "modules/audioDecoder/MultiAudioDecoderLibav.hh"
 #include "modules/receiver/SourceManager.hh"
 #include "modules/transmitter/SinkManager.hh"
 #include "modules/headDemuxer/HeadDemuxerLibav.hh"
@@ -39,10 +44,10 @@
 
 #define WORKER_DELETE_SLEEPING_TIME 1000 //us
 
-PipelineManager::PipelineManager(const unsigned thds) : threads(thds)
+PipelineManager::PipelineManager(const unsigned thds) : threads(thds), budget(0, thds)
 {
     pipeMngrInstance = this;
-    pool = new WorkersPool(threads);
+    pool = new WorkersPool(budget.getPoolThreads());
 }
 
 PipelineManager::~PipelineManager()
@@ -88,6 +93,7 @@ bool PipelineManager::stop()
     utils::infoMsg("Paths deleted");
 
     for (auto it : filters) {
+        budget.removeEncoder(it.first);
         delete it.second;
     }
 
@@ -159,6 +165,21 @@ bool PipelineManager::createFilter(int id, FilterType type)
         case VIDEO_SPLITTER:
             filter = VideoSplitter::createNew();
             break;            
+        case VIDEO_LADDER:
+            filter = VideoLadder::createNew();
+            break;
+        case FRAME_RATE_CONVERTER:
+            filter = FrameRateConverter::createNew();
+            break;
+        case MULTI_AUDIO_DECODER:
+            filter = new MultiAudioDecoderLibav();
+            break;
+        case LADDER_ENCODER:
+            filter = LadderEncoderX264::createNew();
+            break;
+        case PLUGIN_ENCODER:
+            filter = VideoEncoderPlugin::createNew();
+            break;
         //TODO include sharedMemory filter
         default:
             utils::errorMsg("Unknown filter type");
@@ -196,10 +217,19 @@ bool PipelineManager::addFilter(int id, BaseFilter* filter)
 
     if (!pool){
         utils::warningMsg("Creating new thread pool!");
-        pool = new WorkersPool(threads);
+        pool = new WorkersPool(budget.getPoolThreads());
     }
     
-    return pool->addTask(filter);
+    if (!pool->addTask(filter)) {
+        return false;
+    }
+
+    if (dynamic_cast<VideoEncoderX264or5*>(filter)) {
+        budget.addEncoder(id);
+        rebalanceEncoders();
+    }
+
+    return true;
 }
 
 BaseFilter* PipelineManager::getFilter(int id)
@@ -410,8 +440,13 @@ bool PipelineManager::deletePath(Path* path)
             return false;
         }
         pool->removeTask(it);
+        removeRateControls(filters[it]);
         delete filters[it];
         filters.erase(it);
+
+        if (budget.removeEncoder(it)) {
+            rebalanceEncoders();
+        }
     }
 
     delete path;
@@ -419,6 +454,79 @@ bool PipelineManager::deletePath(Path* path)
     return true;
 }
 
+void PipelineManager::removeRateControls(BaseFilter* encoder)
+{
+    SinkManager* sink;
+
+    for (auto it : filters) {
+        if ((sink = dynamic_cast<SinkManager*>(it.second))) {
+            sink->removeRateControls(encoder);
+        }
+    }
+}
+
+void PipelineManager::rebalanceEncoders()
+{
+    for (auto it : budget.rebalance()) {
+        if (filters.count(it.first) <= 0) {
+            continue;
+        }
+
+        //Other encoding parameters are kept by the encoder
+        Jzon::Object root, params;
+        root.Add("action", "configThreads");
+        params.Add("threads", (int) it.second);
+        root.Add("params", params);
+
+        Event e(root, std::chrono::system_clock::now(), 0);
+        filters[it.first]->pushEvent(e);
+    }
+}
+
+bool PipelineManager::configEncoderBudget(int encoderId, unsigned weight)
+{
+    if (filters.count(encoderId) <= 0 || !dynamic_cast<VideoEncoderX264or5*>(filters[encoderId])) {
+        utils::errorMsg("[PipelineManager::configEncoderBudget] Filter is not a video encoder");
+        return false;
+    }
+
+    if (weight == 0) {
+        budget.removeEncoder(encoderId);
+    } else {
+        budget.addEncoder(encoderId, weight);
+    }
+
+    rebalanceEncoders();
+    return true;
+}
+
+bool PipelineManager::configRateControl(int sinkId, int connectionId, int encoderId,
+                                        unsigned minBitrate, unsigned maxBitrate, unsigned maxFps)
+{
+    SinkManager* sink;
+    VideoEncoderX264or5* encoder;
+
+    if (filters.count(sinkId) <= 0 || filters.count(encoderId) <= 0) {
+        utils::errorMsg("[PipelineManager::configRateControl] Filter does not exist");
+        return false;
+    }
+
+    sink = dynamic_cast<SinkManager*>(filters[sinkId]);
+    encoder = dynamic_cast<VideoEncoderX264or5*>(filters[encoderId]);
+
+    if (!sink || !encoder) {
+        utils::errorMsg("[PipelineManager::configRateControl] Filters must be a transmitter and a video encoder");
+        return false;
+    }
+
+    if (sink->getConnections().count(connectionId) <= 0) {
+        utils::errorMsg("[PipelineManager::configRateControl] Connection does not exist");
+        return false;
+    }
+
+    return sink->setRateControl(connectionId, encoder, minBitrate, maxBitrate, maxFps);
+}
+
 bool PipelineManager::deleteRelatedPaths(int filterId)
 {
     bool ret = true;
@@ -589,6 +697,70 @@ void PipelineManager::removePathEvent(Jzon::Node* params, Jzon::Object &outputNo
 }
 
 
+void PipelineManager::configRateControlEvent(Jzon::Node* params, Jzon::Object &outputNode)
+{
+    int sinkId, connectionId, encoderId;
+    SinkManager* sink;
+
+    if(!params) {
+        outputNode.Add("error", "Error configuring rate control. Invalid JSON format...");
+        return;
+    }
+
+    if (!params->Has("sinkFilterId") || !params->Has("connectionId") || !params->Has("encoderFilterId")) {
+        outputNode.Add("error", "Error configuring rate control. Invalid JSON format...");
+        return;
+    }
+
+    sinkId = params->Get("sinkFilterId").ToInt();
+    connectionId = params->Get("connectionId").ToInt();
+    encoderId = params->Get("encoderFilterId").ToInt();
+
+    if (params->Has("enable") && !params->Get("enable").ToBool()) {
+        if (filters.count(sinkId) <= 0 || !(sink = dynamic_cast<SinkManager*>(filters[sinkId])) ||
+            !sink->removeRateControl(connectionId)) {
+            outputNode.Add("error", "Error removing rate control. Check introduced IDs...");
+            return;
+        }
+
+        outputNode.Add("error", Jzon::null);
+        return;
+    }
+
+    if (!params->Has("minBitrate") || !params->Has("maxBitrate") || !params->Has("maxFps")) {
+        outputNode.Add("error", "Error configuring rate control. Invalid JSON format...");
+        return;
+    }
+
+    if (!configRateControl(sinkId, connectionId, encoderId, params->Get("minBitrate").ToInt(),
+                           params->Get("maxBitrate").ToInt(), params->Get("maxFps").ToInt())) {
+        outputNode.Add("error", "Error configuring rate control. Check introduced IDs and values...");
+        return;
+    }
+
+    outputNode.Add("error", Jzon::null);
+}
+
+void PipelineManager::configEncoderBudgetEvent(Jzon::Node* params, Jzon::Object &outputNode)
+{
+    if(!params) {
+        outputNode.Add("error", "Error configuring encoder budget. Invalid JSON format...");
+        return;
+    }
+
+    if (!params->Has("encoderFilterId") || !params->Has("weight")) {
+        outputNode.Add("error", "Error configuring encoder budget. Invalid JSON format...");
+        return;
+    }
+
+    if (!configEncoderBudget(params->Get("encoderFilterId").ToInt(), params->Get("weight").ToInt())) {
+        outputNode.Add("error", "Error configuring encoder budget. Check introduced ID...");
+        return;
+    }
+
+    outputNode.Add("error", Jzon::null);
+}
+
 void PipelineManager::stopEvent(Jzon::Node* params, Jzon::Object &outputNode)
 {
     if (!stop()) {
@@ -28,6 +28,7 @@
 #include "Filter.hh"
 #include "Path.hh"
 #include "WorkersPool.hh"
+#include "ThreadBudget.hh"
 
 #include <map>
 
@@ -127,6 +128,28 @@ public:
      */
     bool removePath(int id);
 
+    /**
+     * Closes a rate control loop between a transmitter connection and a video encoder
+     * @param sinkId SinkManager filter ID
+     * @param connectionId ID of the connection whose receiver reports drive the encoder
+     * @param encoderId video encoder filter ID
+     * @param minBitrate lower bitrate bound in kbps
+     * @param maxBitrate upper bitrate bound in kbps
+     * @param maxFps nominal frame rate
+     * @return returns true if succeeded, false otherwise.
+     */
+    bool configRateControl(int sinkId, int connectionId, int encoderId,
+                           unsigned minBitrate, unsigned maxBitrate, unsigned maxFps);
+
+    /**
+     * Sets the share of the encoders cores taken by a video encoder. Video encoders
+     * join the budget with weight 1 when they are added
+     * @param encoderId video encoder filter ID
+     * @param weight relative encoding load, 0 to manage its threads by hand
+     * @return returns true if succeeded, false otherwise.
+     */
+    bool configEncoderBudget(int encoderId, unsigned weight);
+
     /**
     * Sets outputNode jzon object by getting pipeline state
     */
@@ -150,6 +173,18 @@ public:
     */
     void removePathEvent(Jzon::Node* params, Jzon::Object &outputNode);
 
+    /**
+    * Sets outputNode jzon object with the results coming from rate control event
+    * filled by incoming jzon object params
+    */
+    void configRateControlEvent(Jzon::Node* params, Jzon::Object &outputNode);
+
+    /**
+    * Sets outputNode jzon object with the results coming from encoder budget event
+    * filled by incoming jzon object params
+    */
+    void configEncoderBudgetEvent(Jzon::Node* params, Jzon::Object &outputNode);
+
     /**
     * Sets outputNode jzon object with results of pipeline stop event
     */
@@ -164,12 +199,15 @@ private:
     bool handleGrouping(int orgFId, int dstFId, int orgWId, int dstRId);
     bool validCData(ConnectionData cData, int orgFId, int dstFId);
     bool deleteRelatedPaths(int filterId);
+    void removeRateControls(BaseFilter* encoder);
+    void rebalanceEncoders();
 
     static PipelineManager* pipeMngrInstance;
     const unsigned threads;
 
     std::map<int, Path*> paths;
     std::map<int, BaseFilter*> filters;
+    ThreadBudget budget;
     WorkersPool *pool;
 };
 
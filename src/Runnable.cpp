@@ -80,6 +80,27 @@ bool Runnable::setId(int id_){
     return true;
 }
 
+void Runnable::setJobEnabler(std::function<void(std::vector<int>)> enabler)
+{
+    std::lock_guard<std::mutex> guard(enablerMtx);
+    jobEnabler = enabler;
+}
+
+void Runnable::enableJobs(std::vector<int> jobs)
+{
+    std::function<void(std::vector<int>)> enabler;
+
+    {
+        std::lock_guard<std::mutex> guard(enablerMtx);
+        enabler = jobEnabler;
+    }
+
+    //The enabler takes the pool lock, so it is not called holding the runnable one
+    if (enabler && !jobs.empty()) {
+        enabler(jobs);
+    }
+}
+
 void Runnable::setRunning()
 {
     std::lock_guard<std::mutex> guard(mtx);
@@ -127,6 +127,12 @@ public:
      */ 
     virtual bool pendingJobs() = 0;
 
+    /**
+     * Sets the function that enables jobs out of runProcessFrame, it is set by the WorkersPool running it
+     * @param enabler function enabling the runnables with the given ids, NULL to unset it
+     */
+    void setJobEnabler(std::function<void(std::vector<int>)> enabler);
+
 protected:
     /**
      * Runnable constructor
@@ -141,6 +147,13 @@ protected:
      * this process (e.g new data has been generated)
      */
     virtual std::vector<int> processFrame(int& ret) = 0;
+
+    /**
+     * Enables jobs from threads other than the worker ones, e.g. when a runnable own thread
+     * generates new data. It does nothing if the runnable is not run by a WorkersPool.
+     * @param jobs ids of the runnables that can be executed
+     */
+    void enableJobs(std::vector<int> jobs);
     
 private:
     void addInGroup(Runnable *r, std::shared_ptr<unsigned> run = NULL);
@@ -156,6 +169,8 @@ private:
     const bool periodic;
     std::shared_ptr<unsigned> running;
     int id;
+    std::mutex enablerMtx;
+    std::function<void(std::vector<int>)> jobEnabler;
 };
 
 
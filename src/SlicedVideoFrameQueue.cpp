@@ -46,8 +46,9 @@ SlicedVideoFrameQueue* SlicedVideoFrameQueue::createNew(struct ConnectionData cD
 }
 
 SlicedVideoFrameQueue::SlicedVideoFrameQueue(struct ConnectionData cData, const StreamInfo *si,
-        unsigned maxFrames) : VideoFrameQueue(cData, si, maxFrames)
+        unsigned maxFrames) : VideoFrameQueue(cData, si, maxFrames), inputFrame(NULL), maxSliceSize(0), arenaSize(0), arenaRear(0)
 {
+    memset(entries, 0, sizeof(entries));
 }
 
 SlicedVideoFrameQueue::~SlicedVideoFrameQueue()
@@ -91,6 +92,9 @@ Frame* SlicedVideoFrameQueue::innerForceGetRear()
     while ((frame = innerGetRear()) == NULL) {
         utils::debugMsg("Frame discarted by X264 Circular Buffer");
         flush();
+        //Flush drops the newest frame, whose slice was the last one written to the arena
+        entries[rear].flags &= ~SLICE_ENTRY_USED;
+        arenaRear = entries[rear].offset;
     }
     return frame;
 }
@@ -100,7 +104,7 @@ void SlicedVideoFrameQueue::innerAddFrame()
     rear =  (rear + 1) % max;
 }
 
-bool SlicedVideoFrameQueue::setup(unsigned maxSliceSize)
+bool SlicedVideoFrameQueue::setup(unsigned maxSliceSize_)
 {
     inputFrame = SlicedVideoFrame::createNew(streamInfo->video.codec);
 
@@ -108,8 +112,13 @@ bool SlicedVideoFrameQueue::setup(unsigned maxSliceSize)
         return false;
     }
 
+    maxSliceSize = maxSliceSize_;
+    arenaSize = (size_t) maxSliceSize * ARENA_SLICES;
+    arena.reset(new unsigned char [arenaSize](), std::default_delete<unsigned char[]>());
+
+    //Frames do not need their own buffer, they are views of the arena
     for (unsigned i=0; i < max; i++) {
-        frames[i] = InterleavedVideoFrame::createNew(streamInfo->video.codec, maxSliceSize);
+        frames[i] = InterleavedVideoFrame::createNew(streamInfo->video.codec, 0);
 
         if (!frames[i]) {
             return false;
@@ -119,25 +128,119 @@ bool SlicedVideoFrameQueue::setup(unsigned maxSliceSize)
     return true;
 }
 
+bool SlicedVideoFrameQueue::isLive(size_t slot)
+{
+    //The last removed frame is live too, as it is still returned by forceGetFront
+    if (slot == (front + (max - 1)) % max) {
+        return slot != rear && (entries[slot].flags & SLICE_ENTRY_USED);
+    }
+
+    return front > rear ? (slot >= front || slot < rear) : (slot >= front && slot < rear);
+}
+
+bool SlicedVideoFrameQueue::allocSlice(unsigned size, size_t &offset)
+{
+    size_t oldest = (front + (max - 1)) % max;
+    size_t tail;
+
+    if (!isLive(oldest)) {
+        oldest = front;
+    }
+
+    //Nothing to keep, the whole arena can be reused from its beginning
+    if (!isLive(oldest)) {
+        if (size > arenaSize) {
+            return false;
+        }
+
+        offset = 0;
+        return true;
+    }
+
+    tail = entries[oldest].offset;
+
+    //Live bytes go from tail to arenaRear, slices are never split at the arena end.
+    //Wrapped arenaRear never reaches tail, so that they are only equal when there is nothing to keep
+    if (tail <= arenaRear) {
+        if (arenaRear + size <= arenaSize) {
+            offset = arenaRear;
+            return true;
+        }
+
+        if (size < tail) {
+            offset = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (arenaRear + size < tail) {
+        offset = arenaRear;
+        return true;
+    }
+
+    return false;
+}
+
+bool SlicedVideoFrameQueue::pushSlice(unsigned char *data, unsigned size, VideoFrame *times)
+{
+    return pushBackSlice(data, size, times ? times : inputFrame);
+}
+
 void SlicedVideoFrameQueue::pushBackSliceGroup(Slice* slices, int sliceNum) 
+{
+    for (int i=0; i<sliceNum; i++) {
+        pushBackSlice(slices[i].getData(), slices[i].getDataSize(), inputFrame);
+    }
+}
+
+bool SlicedVideoFrameQueue::pushBackSlice(unsigned char *data, unsigned size, VideoFrame *times)
 {
     Frame* frame;
-    VideoFrame* vFrame;
+    InterleavedVideoFrame* vFrame;
+    size_t offset;
 
-    for (int i=0; i<sliceNum; i++) {
+    if (size > maxSliceSize) {
+        utils::errorMsg("Slice too big for SlicedVideoFrameQueue frames, discarding it");
+        return false;
+    }
 
-        if ((frame = innerGetRear()) == NULL){
-            frame = innerForceGetRear();
-        }
+    if ((frame = innerGetRear()) == NULL){
+        frame = innerForceGetRear();
+    }
 
-        vFrame = dynamic_cast<VideoFrame*>(frame);
-        vFrame->setSequenceNumber(inputFrame->getSequenceNumber());
+    //Slices not consumed yet fill the arena, drop the newest ones as when the queue is full
+    while (!allocSlice(size, offset)) {
+        if (rear == front) {
+            utils::errorMsg("No room for the slice in SlicedVideoFrameQueue arena, discarding it");
+            return false;
+        }
 
-        memcpy(vFrame->getDataBuf(), slices[i].getData(), slices[i].getDataSize());
-        vFrame->setLength(slices[i].getDataSize());
-        vFrame->setPresentationTime(inputFrame->getPresentationTime());
-        vFrame->setOriginTime(inputFrame->getOriginTime());
-        vFrame->setSize(inputFrame->getWidth(), inputFrame->getHeight());
-        innerAddFrame();
+        utils::debugMsg("Frame discarted by X264 Circular Buffer");
+        flush();
+        entries[rear].flags &= ~SLICE_ENTRY_USED;
+        arenaRear = entries[rear].offset;
+        frame = frames[rear];
     }
-}      
+
+    vFrame = dynamic_cast<InterleavedVideoFrame*>(frame);
+
+    vFrame->setSequenceNumber(times->getSequenceNumber());
+
+    memcpy(arena.get() + offset, data, size);
+    vFrame->setView(arena, arena.get() + offset, 0);
+    vFrame->setLength(size);
+    entries[rear].offset = offset;
+    entries[rear].length = size;
+    entries[rear].flags = SLICE_ENTRY_USED;
+    arenaRear = offset + size;
+
+    vFrame->setPresentationTime(times->getPresentationTime());
+    vFrame->setDecodeTime(times->getDecodeTime());
+    vFrame->setOriginTime(times->getOriginTime());
+    vFrame->setSize(times->getWidth(), times->getHeight());
+    innerAddFrame();
+
+    return true;
+}
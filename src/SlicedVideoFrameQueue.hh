@@ -27,8 +27,14 @@
 #include "AVFramedQueue.hh"
 #include "VideoFrame.hh"
 
+#include <memory>
+
+#define ARENA_SLICES 4 //arena size in maximum size slices
+#define SLICE_ENTRY_USED 0x1 //entry holds arena bytes
+
 /*! Virtual interface for X264VideoCircularBuffer and X265VideoCircularBuffer. In is a child class from VideoFrameQueue, modifying its 
-    input behaviour. */
+    input behaviour. Slices are packed back to back in a byte arena shared by all the queue frames, which are views of it, 
+    instead of being copied to a maximum slice size buffer per frame. */
 
 class SlicedVideoFrameQueue : public VideoFrameQueue {
 
@@ -64,17 +70,45 @@ public:
     */
     Frame *forceGetRear();
 
+    /**
+    * It copies one slice of the input frame into the internal VideoFrameQueue right away, so that
+    * readers can consume it before the whole frame is encoded. Input frame timing and size must be set before,
+    * unless they are given by times, which lets slices be pushed from outside the filter thread. As the other
+    * input operations, it must not run concurrently with them, which filters ensure holding their lock.
+    * @param data slice data
+    * @param size slice size in bytes
+    * @param times frame holding the slice timing and size, NULL to use the input frame ones
+    * @return true if succeeded and false if not
+    */
+    bool pushSlice(unsigned char *data, unsigned size, VideoFrame *times = NULL);
+
 private:
     SlicedVideoFrameQueue(struct ConnectionData cData, const StreamInfo *si, unsigned maxFrames);
 
     void pushBackSliceGroup(Slice* slices, int sliceNum);
+    bool pushBackSlice(unsigned char *data, unsigned size, VideoFrame *times);
     Frame *innerGetRear();
     Frame *innerForceGetRear();
     void innerAddFrame();
-    bool setup(unsigned maxSliceSize);
+    bool setup(unsigned maxSliceSize_);
+    bool allocSlice(unsigned size, size_t &offset);
+    bool isLive(size_t slot);
+
+    struct SliceEntry {
+        size_t offset;
+        unsigned length;
+        unsigned flags;
+    };
 
     SlicedVideoFrame* inputFrame;
 
+    std::shared_ptr<unsigned char> arena;
+    unsigned maxSliceSize;
+    size_t arenaSize;
+    size_t arenaRear;
+    //Arena position of the slice of each queue frame
+    SliceEntry entries[MAX_FRAMES];
+
 };
 
 #endif
@@ -46,6 +46,9 @@ struct StreamInfo {
         struct {
             VCodecType codec;
             PixType pixelFormat;
+            /** Picture size, 0 when unknown or variable */
+            unsigned width;
+            unsigned height;
             union {
                 struct {
                     /** If true, bitstream is in Annex B format, so each NALU is prefixed with a
@@ -129,6 +132,8 @@ struct StreamInfo {
                 case VIDEO:
                     video.codec = VC_NONE;
                     video.pixelFormat = P_NONE;
+                    video.width = 0;
+                    video.height = 0;
                     video.h264or5.annexb = false;
                     video.h264or5.framed = true;
                     break;
@@ -0,0 +1,94 @@
+/*
+ *  ThreadBudget.cpp - CPU budget shared by the workers pool and the encoders
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <thread>
+#include <algorithm>
+
+#include "ThreadBudget.hh"
+
+ThreadBudget::ThreadBudget(unsigned cores_, unsigned poolThreads_) : cores(cores_), poolThreads(poolThreads_)
+{
+    if (cores == 0) {
+        cores = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    if (poolThreads == 0) {
+        poolThreads = std::max((unsigned) (cores * BUDGET_POOL_SHARE), (unsigned) BUDGET_MIN_POOL_THREADS);
+    }
+
+    //WorkersPool does not start more threads than cores
+    poolThreads = std::min(poolThreads, cores);
+}
+
+bool ThreadBudget::addEncoder(int id, unsigned weight)
+{
+    if (weight == 0) {
+        return false;
+    }
+
+    if (encoders.count(id) > 0) {
+        encoders[id].weight = weight;
+        return true;
+    }
+
+    encoders[id] = {weight, 0};
+    return true;
+}
+
+bool ThreadBudget::removeEncoder(int id)
+{
+    return encoders.erase(id) > 0;
+}
+
+std::map<int, unsigned> ThreadBudget::rebalance()
+{
+    std::map<int, unsigned> changes;
+    unsigned totalWeight = 0;
+    unsigned threads;
+
+    for (auto it : encoders) {
+        totalWeight += it.second.weight;
+    }
+
+    for (auto &it : encoders) {
+        //The pool worker running the encoder is not counted, it waits for the encoder threads
+        threads = (unsigned) ((unsigned long) getEncoderCores() * it.second.weight / totalWeight);
+        threads = std::max(threads, (unsigned) BUDGET_MIN_ENCODER_THREADS);
+
+        if (threads != it.second.threads) {
+            it.second.threads = threads;
+            changes[it.first] = threads;
+        }
+    }
+
+    return changes;
+}
+
+unsigned ThreadBudget::getEncoderThreads(int id)
+{
+    if (encoders.count(id) <= 0) {
+        return 0;
+    }
+
+    return encoders[id].threads;
+}
@@ -0,0 +1,90 @@
+/*
+ *  ThreadBudget.hh - CPU budget shared by the workers pool and the encoders
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#ifndef _THREAD_BUDGET_HH
+#define _THREAD_BUDGET_HH
+
+#include <map>
+
+#define BUDGET_POOL_SHARE 0.5 //of the cores given to the workers pool by default
+#define BUDGET_MIN_POOL_THREADS 2
+#define BUDGET_MIN_ENCODER_THREADS 1
+
+/*! Splits the CPU cores between the workers pool threads and the internal threads
+*   of the encoders, so that several encoders do not oversubscribe the machine.
+*   Cores that are not used by the pool are shared by the registered encoders
+*   proportionally to their weight.
+*/
+class ThreadBudget {
+
+public:
+    /**
+    * Class constructor
+    * @param cores available cores, 0 to use the hardware concurrency
+    * @param poolThreads workers pool threads, 0 to use a share of the cores
+    */
+    ThreadBudget(unsigned cores = 0, unsigned poolThreads = 0);
+
+    /**
+    * Adds an encoder to the budget or changes its weight
+    * @param id encoder filter id
+    * @param weight relative encoding load, e.g. pixels per second
+    * @return false if weight is 0
+    */
+    bool addEncoder(int id, unsigned weight = 1);
+
+    /**
+    * Removes an encoder from the budget
+    * @param id encoder filter id
+    * @return false if the encoder is not in the budget
+    */
+    bool removeEncoder(int id);
+
+    /**
+    * Shares the encoders cores again
+    * @return threads of each encoder whose assignment has changed
+    */
+    std::map<int, unsigned> rebalance();
+
+    /**
+    * @param id encoder filter id
+    * @return threads assigned to the encoder, 0 if it is not in the budget
+    */
+    unsigned getEncoderThreads(int id);
+
+    unsigned getCores() {return cores;};
+    unsigned getPoolThreads() {return poolThreads;};
+    unsigned getEncoderCores() {return cores > poolThreads ? cores - poolThreads : 0;};
+
+private:
+    struct EncoderShare {
+        unsigned weight;
+        unsigned threads;
+    };
+
+    unsigned cores;
+    unsigned poolThreads;
+    std::map<int, EncoderShare> encoders;
+};
+
+#endif
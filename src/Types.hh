@@ -78,7 +78,7 @@ enum SampleFmt {S_NONE = -1, U8, S16, FLT, U8P, S16P, FLTP};
 /**
 * Filter types
 */
-enum FilterType {FT_NONE = -1, RECEIVER, TRANSMITTER, VIDEO_DECODER, VIDEO_ENCODER, VIDEO_RESAMPLER, VIDEO_MIXER, AUDIO_DECODER, AUDIO_ENCODER, AUDIO_MIXER, SHARED_MEMORY, DASHER, DEMUXER, VIDEO_SPLITTER};
+enum FilterType {FT_NONE = -1, RECEIVER, TRANSMITTER, VIDEO_DECODER, VIDEO_ENCODER, VIDEO_RESAMPLER, VIDEO_MIXER, AUDIO_DECODER, AUDIO_ENCODER, AUDIO_MIXER, SHARED_MEMORY, DASHER, DEMUXER, VIDEO_SPLITTER, VIDEO_LADDER, FRAME_RATE_CONVERTER, MULTI_AUDIO_DECODER, LADDER_ENCODER, PLUGIN_ENCODER};
 
 enum FilterRole {FR_NONE = -1, REGULAR, SERVER};
 
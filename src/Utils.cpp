@@ -277,6 +277,21 @@ namespace utils
             case VIDEO_SPLITTER:
                 stringType = "videoSplitter";
                 break;
+            case VIDEO_LADDER:
+                stringType = "videoLadder";
+                break;
+            case FRAME_RATE_CONVERTER:
+                stringType = "frameRateConverter";
+                break;
+            case MULTI_AUDIO_DECODER:
+                stringType = "multiAudioDecoder";
+                break;
+            case LADDER_ENCODER:
+                stringType = "ladderEncoder";
+                break;
+            case PLUGIN_ENCODER:
+                stringType = "pluginEncoder";
+                break;
             case DASHER:
                 stringType = "dasher";
                 break;                
@@ -321,6 +336,16 @@ namespace utils
            fType = DEMUXER;
         }  else if (stringFilterType.compare("videoSplitter") == 0) {
            fType = VIDEO_SPLITTER;
+        }  else if (stringFilterType.compare("videoLadder") == 0) {
+           fType = VIDEO_LADDER;
+        }  else if (stringFilterType.compare("frameRateConverter") == 0) {
+           fType = FRAME_RATE_CONVERTER;
+        }  else if (stringFilterType.compare("multiAudioDecoder") == 0) {
+           fType = MULTI_AUDIO_DECODER;
+        }  else if (stringFilterType.compare("ladderEncoder") == 0) {
+           fType = LADDER_ENCODER;
+        }  else if (stringFilterType.compare("pluginEncoder") == 0) {
+           fType = PLUGIN_ENCODER;
         }  else {
            fType = FT_NONE;
         }
@@ -525,6 +550,9 @@ namespace utils
             case VIDEO:
                 desc += " codec:" + getVideoCodecAsString(si->video.codec);
                 desc += " pixelFormat:" + getPixTypeAsString(si->video.pixelFormat);
+                if (si->video.width > 0 && si->video.height > 0) {
+                    desc += " size:" + std::to_string(si->video.width) + "x" + std::to_string(si->video.height);
+                }
                 switch (si->video.codec) {
                     case H264:
                     case H265:
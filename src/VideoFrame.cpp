@@ -25,13 +25,13 @@
  #include <string.h>
 
 VideoFrame::VideoFrame(VCodecType codec_) : 
-Frame(), codec(codec_), width(0), height(0), pixelFormat(P_NONE)
+Frame(), codec(codec_), width(0), height(0), pixelFormat(P_NONE), stride(0)
 {
 
 }
 
 VideoFrame::VideoFrame(VCodecType codec_, int width_, int height_, PixType pixFormat)
-: Frame(), codec(codec_), width(width_), height(height_), pixelFormat(pixFormat)
+: Frame(), codec(codec_), width(width_), height(height_), pixelFormat(pixFormat), stride(0)
 {
 
 }
@@ -67,14 +67,15 @@ InterleavedVideoFrame* InterleavedVideoFrame::createNew(VCodecType codec, int wi
 }
 
 InterleavedVideoFrame::InterleavedVideoFrame(VCodecType codec, unsigned int maxLength)
-: VideoFrame(codec), bufferLen(0)
+: VideoFrame(codec), bufferLen(0), planarView(false)
 {
     bufferMaxLen = maxLength;
-    frameBuff = new unsigned char [bufferMaxLen]();
+    buffer.reset(new unsigned char [bufferMaxLen](), std::default_delete<unsigned char[]>());
+    frameBuff = buffer.get();
 }
 
 InterleavedVideoFrame::InterleavedVideoFrame(VCodecType codec, int width, int height, PixType pixelFormat)
-: VideoFrame(codec, width, height, pixelFormat), bufferLen(0)
+: VideoFrame(codec, width, height, pixelFormat), bufferLen(0), planarView(false)
 {
     int bytesPerPixel;
 
@@ -94,12 +95,182 @@ InterleavedVideoFrame::InterleavedVideoFrame(VCodecType codec, int width, int he
     }
 
     bufferMaxLen = width * height * bytesPerPixel;
-    frameBuff = new unsigned char [bufferMaxLen]();
+    buffer.reset(new unsigned char [bufferMaxLen](), std::default_delete<unsigned char[]>());
+    frameBuff = buffer.get();
 }
 
 InterleavedVideoFrame::~InterleavedVideoFrame()
 {
-    delete[] frameBuff;
+
+}
+
+void InterleavedVideoFrame::setView(std::shared_ptr<unsigned char> sharedBuf, unsigned char *data, int stride)
+{
+    view = sharedBuf;
+    frameBuff = data;
+    this->stride = stride;
+    planarView = false;
+}
+
+void InterleavedVideoFrame::releaseView()
+{
+    if (!view) {
+        return;
+    }
+
+    view.reset();
+    frameBuff = buffer.get();
+    stride = 0;
+    planarView = false;
+}
+
+void InterleavedVideoFrame::setPlanarView(std::shared_ptr<unsigned char> sharedBuf, unsigned char **planes, int *strides)
+{
+    view = sharedBuf;
+    frameBuff = planes[0];
+    stride = strides[0];
+
+    for (int i = 0; i < MAX_PLANES; i++) {
+        viewPlanes[i] = NULL;
+        viewStrides[i] = 0;
+    }
+
+    for (int i = 0; i < MAX_PLANES && planes[i]; i++) {
+        viewPlanes[i] = planes[i];
+        viewStrides[i] = strides[i];
+    }
+
+    planarView = true;
+}
+
+int InterleavedVideoFrame::getPlanes(unsigned char **planes, int *strides)
+{
+    int chromaWidth;
+    int chromaHeight;
+    int lumaStride;
+    int chromaStride;
+    int nPlanes;
+
+    for (int i = 0; i < MAX_PLANES; i++) {
+        planes[i] = NULL;
+        strides[i] = 0;
+    }
+
+    if (planarView) {
+        for (nPlanes = 0; nPlanes < MAX_PLANES && viewPlanes[nPlanes]; nPlanes++) {
+            planes[nPlanes] = viewPlanes[nPlanes];
+            strides[nPlanes] = viewStrides[nPlanes];
+        }
+
+        return nPlanes;
+    }
+
+    switch (pixelFormat) {
+        case RGB24:
+            planes[0] = frameBuff;
+            strides[0] = stride > 0 ? stride : width * 3;
+            return 1;
+        case RGB32:
+            planes[0] = frameBuff;
+            strides[0] = stride > 0 ? stride : width * 4;
+            return 1;
+        case YUYV422:
+            planes[0] = frameBuff;
+            strides[0] = stride > 0 ? stride : width * 2;
+            return 1;
+        case YUV420P:
+        case YUVJ420P:
+            chromaWidth = (width + 1) / 2;
+            chromaHeight = (height + 1) / 2;
+            break;
+        case YUV422P:
+            chromaWidth = (width + 1) / 2;
+            chromaHeight = height;
+            break;
+        case YUV444P:
+            chromaWidth = width;
+            chromaHeight = height;
+            break;
+        default:
+            return 0;
+    }
+
+    //Planar layout, one plane after the other. Chroma lines are padded like luma ones
+    lumaStride = stride > 0 ? stride : width;
+    chromaStride = stride > 0 ? (chromaWidth == width ? stride : (stride + 1) / 2) : chromaWidth;
+
+    planes[0] = frameBuff;
+    strides[0] = lumaStride;
+    planes[1] = planes[0] + lumaStride * height;
+    strides[1] = chromaStride;
+    planes[2] = planes[1] + chromaStride * chromaHeight;
+    strides[2] = chromaStride;
+
+    return 3;
+}
+
+int InterleavedVideoFrame::getPlaneSizes(int *rowBytes, int *rows)
+{
+    int chromaWidth;
+    int chromaHeight;
+
+    for (int i = 0; i < MAX_PLANES; i++) {
+        rowBytes[i] = 0;
+        rows[i] = 0;
+    }
+
+    switch (pixelFormat) {
+        case RGB24:
+            rowBytes[0] = width * 3;
+            rows[0] = height;
+            return 1;
+        case RGB32:
+            rowBytes[0] = width * 4;
+            rows[0] = height;
+            return 1;
+        case YUYV422:
+            rowBytes[0] = width * 2;
+            rows[0] = height;
+            return 1;
+        case YUV420P:
+        case YUVJ420P:
+            chromaWidth = (width + 1) / 2;
+            chromaHeight = (height + 1) / 2;
+            break;
+        case YUV422P:
+            chromaWidth = (width + 1) / 2;
+            chromaHeight = height;
+            break;
+        case YUV444P:
+            chromaWidth = width;
+            chromaHeight = height;
+            break;
+        default:
+            return 0;
+    }
+
+    rowBytes[0] = width;
+    rows[0] = height;
+
+    for (int i = 1; i < 3; i++) {
+        rowBytes[i] = chromaWidth;
+        rows[i] = chromaHeight;
+    }
+
+    return 3;
+}
+
+void InterleavedVideoFrame::detachBuffer()
+{
+    releaseView();
+
+    //Views of this frame are still alive downstream, leave the old buffer to them. Views are only
+    //taken by the filter writing this frame, other threads can just drop theirs, so a stale count
+    //may only cause an unneeded reallocation
+    if (buffer.use_count() != 1) {
+        buffer.reset(new unsigned char [bufferMaxLen], std::default_delete<unsigned char[]>());
+        frameBuff = buffer.get();
+    }
 }
 
 /////////////////////////
@@ -27,9 +27,11 @@
 #include "Frame.hh"
 #include "Types.hh"
 #include "Utils.hh"
+#include <memory>
 
 #define MAX_COPIED_SLICES 8
 #define MAX_SLICES 16
+#define MAX_PLANES 4
 
 class VideoFrame : public Frame {
 
@@ -40,16 +42,24 @@ public:
 
     void setSize(int width, int height);
     void setPixelFormat(PixType pixelFormat);
+    void setStride(int stride) {this->stride = stride;};
     
     VCodecType getCodec() {return codec;};
     int getWidth() {return width;};
     int getHeight() {return height;};
     PixType getPixelFormat() {return pixelFormat;};
 
+    /**
+    * Gets the distance in bytes between the beginning of two consecutive lines
+    * @return line stride in bytes or 0 if lines are tightly packed
+    */
+    int getStride() {return stride;};
+
 protected:
     VCodecType codec;
     int width, height;
     PixType pixelFormat;
+    int stride;
 };
 
 class InterleavedVideoFrame : public VideoFrame {
@@ -66,14 +76,77 @@ public:
     void setLength(unsigned int length) {bufferLen = length;};
     bool isPlanar() {return false;};
 
+    /**
+    * Gets the reference counted buffer backing frame data, which is
+    * the buffer of another frame when this frame is a view
+    * @return shared buffer
+    */
+    std::shared_ptr<unsigned char> getSharedBuf() {return view ? view : buffer;};
+
+    /**
+    * Makes this frame a strided view of a shared buffer instead of copying it
+    * @param sharedBuf buffer kept alive while the view is in use
+    * @param data first byte of the view inside sharedBuf
+    * @param stride distance in bytes between two consecutive lines
+    */
+    void setView(std::shared_ptr<unsigned char> sharedBuf, unsigned char *data, int stride);
+
+    /**
+    * Drops the view, if any, and points the frame back to its own buffer
+    */
+    void releaseView();
+
+    bool isView() {return view != nullptr;};
+
+    /**
+    * Makes this frame a view of the planes of a shared buffer, which may be padded
+    * or aligned (e.g. decoder buffers)
+    * @param sharedBuf buffer kept alive while the view is in use
+    * @param planes first byte of each plane inside sharedBuf, as many as the pixel format planes
+    * @param strides distance in bytes between two consecutive lines of each plane
+    */
+    void setPlanarView(std::shared_ptr<unsigned char> sharedBuf, unsigned char **planes, int *strides);
+
+    bool isPlanarView() {return planarView;};
+
+    /**
+    * Gets the planes of a raw frame, either the ones of a planar view or the ones
+    * laid out in the frame buffer. Strided planar frames have their chroma lines
+    * padded in proportion to the luma stride
+    * @param planes (out) first byte of each plane, MAX_PLANES long
+    * @param strides (out) line stride in bytes of each plane, MAX_PLANES long
+    * @return number of planes or 0 if the pixel format is not supported
+    */
+    int getPlanes(unsigned char **planes, int *strides);
+
+    /**
+    * Gets the size of the picture data of each plane of a raw frame, without line padding
+    * @param rowBytes (out) picture bytes of each line of each plane, MAX_PLANES long
+    * @param rows (out) lines of each plane, MAX_PLANES long
+    * @return number of planes or 0 if the pixel format is not supported
+    */
+    int getPlaneSizes(int *rowBytes, int *rows);
+
+    /**
+    * Makes frame data writable. Releases the view, if any, and replaces its own
+    * buffer by a new one if views from other frames still reference it
+    */
+    void detachBuffer();
+
 protected:
     InterleavedVideoFrame(VCodecType codec, unsigned int maxLength);
     InterleavedVideoFrame(VCodecType codec, int width, int height, PixType pixelFormat);
 
 private:
+    std::shared_ptr<unsigned char> buffer;
+    std::shared_ptr<unsigned char> view;
     unsigned char *frameBuff;
     unsigned int bufferLen;
     unsigned int bufferMaxLen;
+
+    unsigned char *viewPlanes[MAX_PLANES];
+    int viewStrides[MAX_PLANES];
+    bool planarView;
 };
 
 class Slice {
@@ -117,6 +117,11 @@ void WorkersPool::stop()
         }
     }
     jobQueue.clear();
+
+    std::lock_guard<std::mutex> guard(mtx);
+    for (auto it : runnables){
+        it.second->setJobEnabler(NULL);
+    }
 }
 
 bool WorkersPool::addTask(Runnable* const task)
@@ -128,6 +133,7 @@ bool WorkersPool::addTask(Runnable* const task)
     std::unique_lock<std::mutex> guard(mtx);
     if (runnables.count(id) == 0){
         runnables[id] = task;
+        task->setJobEnabler(std::bind(&WorkersPool::enableJobs, this, std::placeholders::_1));
         jobQueue.push_back(task);
         jobQueue.sort(RunnableLess());
         guard.unlock();
@@ -144,6 +150,7 @@ bool WorkersPool::removeTask(const int id)
     if (runnables.count(id) > 0){
         runnable = runnables[id];
         runnables.erase(id);
+        runnable->setJobEnabler(NULL);
         runnable->removeFromGroup();
         removeFromQueue(id);
         while(runnable->isRunning()){
@@ -184,6 +191,21 @@ bool WorkersPool::addJob(const int id)
     return added;
 }
 
+void WorkersPool::enableJobs(std::vector<int> ids)
+{
+    bool added = false;
+    std::unique_lock<std::mutex> guard(mtx);
+
+    for (auto id : ids){
+        added |= addJob(id);
+    }
+
+    guard.unlock();
+    if (added){
+        qCheck.notify_one();
+    }
+}
+
 bool WorkersPool::addGroupJob(std::vector<int> group)
 {
     bool added = false;
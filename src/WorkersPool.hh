@@ -46,6 +46,7 @@ public:
     
 private:
     bool addJob(int id);
+    void enableJobs(std::vector<int> ids);
     bool addGroupJob(std::vector<int> group);
     bool removeFromQueue(int id);
 
@@ -25,6 +25,30 @@
 #include "../../Utils.hh"
 #include <functional>
 #include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+static int16_t ulawToLinear(uint8_t value)
+{
+    int magnitude;
+
+    value = ~value;
+    magnitude = (((value & 0x0F) << 3) + 0x84) << ((value & 0x70) >> 4);
+
+    return (value & 0x80) ? (0x84 - magnitude) : (magnitude - 0x84);
+}
+
+static std::array<int16_t, 256> buildUlawTable()
+{
+    std::array<int16_t, 256> table;
+
+    for (int i = 0; i < 256; i++) {
+        table[i] = ulawToLinear(i);
+    }
+
+    return table;
+}
 
 AVSampleFormat getAVSampleFormatFromtIntCode(int id)
 {
@@ -65,6 +89,7 @@ AudioDecoderLibav::AudioDecoderLibav()
     inSampleRate = 0;
     inFrame = av_frame_alloc();
     inLibavSampleFmt = AV_SAMPLE_FMT_NONE;
+    passthrough = false;
 
     initializeEventMap();
 
@@ -98,40 +123,55 @@ bool AudioDecoderLibav::doProcessFrame(Frame *org, Frame *dst)
         return false;
     }
 
-    pkt.size = org->getLength();
-    pkt.data = org->getDataBuf();
-
-    if (pkt.size <= 0) {
+    if (org->getLength() <= 0) {
         utils::errorMsg("Error decoding audio frame: pkt.size <= 0");
         return false;
     }   
 
-    while (pkt.size > 0) {
-        len = avcodec_decode_audio4(codecCtx, inFrame, &gotFrame, &pkt);
+    if (directPCM()) {
 
-        if(len < 0) {
-            utils::errorMsg("Error decoding audio frame");
+        if (!convertPCM(aCodedFrame, aDecodedFrame)) {
+            utils::errorMsg("Error converting PCM audio frame");
             return false;
         }
 
-        if (!gotFrame) {
+    } else {
+
+        pkt.size = org->getLength();
+        pkt.data = org->getDataBuf();
+
+        while (pkt.size > 0) {
+            len = avcodec_decode_audio4(codecCtx, inFrame, &gotFrame, &pkt);
 
-            if (pkt.data) {
-                pkt.size -= len;
-                pkt.data += len;
+            if(len < 0) {
+                utils::errorMsg("Error decoding audio frame");
+                return false;
             }
 
-            continue;
-        }
+            if (!gotFrame) {
 
-        checkSampleFormat(inFrame->format);
+                if (pkt.data) {
+                    pkt.size -= len;
+                    pkt.data += len;
+                }
 
-        if (!resample(inFrame, aDecodedFrame)) {
-            utils::errorMsg("Error resampling audio frame");
-            return false;
-        }
+                continue;
+            }
 
-        break;
+            checkSampleFormat(inFrame->format);
+
+            if (passthrough && !copyFrame(inFrame, aDecodedFrame)) {
+                utils::errorMsg("Error copying audio frame");
+                return false;
+            }
+
+            if (!passthrough && !resample(inFrame, aDecodedFrame)) {
+                utils::errorMsg("Error resampling audio frame");
+                return false;
+            }
+
+            break;
+        }
     }
 
     dst->setConsumed(true);
@@ -183,8 +223,24 @@ bool AudioDecoderLibav::configure0(SampleFmt sampleFormat, int channels, int sam
 
 }
 
+bool AudioDecoderLibav::negotiateFormat()
+{
+    passthrough = inLibavSampleFmt == outLibavSampleFmt && inChannels == outChannels && inSampleRate == outSampleRate;
+
+    //Decoded frames are copied as they are, so there is no resampler
+    if (passthrough) {
+        swr_free(&resampleCtx);
+    }
+
+    return passthrough;
+}
+
 bool AudioDecoderLibav::inputConfig()
 {
+    if (negotiateFormat()) {
+        return true;
+    }
+
     resampleCtx = swr_alloc_set_opts
                   (
                     resampleCtx,
@@ -219,6 +275,10 @@ bool AudioDecoderLibav::outputConfig()
         return true;
     }
 
+    if (negotiateFormat()) {
+        return true;
+    }
+
     resampleCtx = swr_alloc_set_opts
                   (
                     resampleCtx,
@@ -290,6 +350,76 @@ bool AudioDecoderLibav::resample(AVFrame* src, AudioFrame* dst)
     return true;
 }
 
+bool AudioDecoderLibav::copyFrame(AVFrame* src, AudioFrame* dst)
+{
+    unsigned samples;
+
+    samples = std::min((unsigned) src->nb_samples, dst->getMaxSamples());
+
+    if (samples < (unsigned) src->nb_samples) {
+        utils::warningMsg("Decoded frame exceeds the output frame size, discarding samples");
+    }
+
+    if (dst->isPlanar()) {
+        for (unsigned i = 0; i < outChannels; i++) {
+            memcpy(dst->getPlanarDataBuf()[i], src->data[i], samples*bytesPerSample);
+        }
+
+        dst->setLength(samples*bytesPerSample);
+
+    } else {
+        memcpy(dst->getDataBuf(), src->data[0], outChannels*samples*bytesPerSample);
+        dst->setLength(outChannels*samples*bytesPerSample);
+    }
+
+    dst->setSamples(samples);
+    return true;
+}
+
+bool AudioDecoderLibav::directPCM()
+{
+    return (fCodec == PCMU || fCodec == PCM) && inChannels == outChannels && 
+           inSampleRate == outSampleRate && (outSampleFmt == S16P || outSampleFmt == FLTP);
+}
+
+bool AudioDecoderLibav::convertPCM(AudioFrame* src, AudioFrame* dst)
+{
+    //Function-local static initialization is thread safe, decoders may run concurrently
+    static const std::array<int16_t, 256> ulawTable = buildUlawTable();
+    unsigned char *data = src->getDataBuf();
+    unsigned bytesPerInSample;
+    unsigned samples;
+    int16_t sample;
+
+    //PCM is S16BE, as sent by the encoder, and G.711 is one byte per sample
+    bytesPerInSample = fCodec == PCM ? 2 : 1;
+    samples = std::min(src->getLength()/(bytesPerInSample*inChannels), dst->getMaxSamples());
+
+    if (samples < src->getLength()/(bytesPerInSample*inChannels)) {
+        utils::warningMsg("PCM frame exceeds the output frame size, discarding samples");
+    }
+
+    for (unsigned c = 0; c < outChannels; c++) {
+        for (unsigned i = 0; i < samples; i++) {
+            if (fCodec == PCM) {
+                sample = (int16_t) ((data[(i*inChannels + c)*2] << 8) | data[(i*inChannels + c)*2 + 1]);
+            } else {
+                sample = ulawTable[data[i*inChannels + c]];
+            }
+
+            if (outSampleFmt == S16P) {
+                ((int16_t*) dst->getPlanarDataBuf()[c])[i] = sample;
+            } else {
+                ((float*) dst->getPlanarDataBuf()[c])[i] = sample/32768.0f;
+            }
+        }
+    }
+
+    dst->setLength(samples*bytesPerSample);
+    dst->setSamples(samples);
+    return true;
+}
+
 void AudioDecoderLibav::checkSampleFormat(int sampleFormatCode)
 {
     AVSampleFormat sampleFormat = getAVSampleFormatFromtIntCode(sampleFormatCode);
@@ -377,6 +507,7 @@ void AudioDecoderLibav::doGetState(Jzon::Object &filterNode)
     filterNode.Add("sampleRate", (int)outSampleRate);
     filterNode.Add("channels", (int)outChannels);
     filterNode.Add("sampleFormat", utils::getSampleFormatAsString(outSampleFmt));
+    filterNode.Add("passthrough", passthrough || directPCM());
 }
 
 bool AudioDecoderLibav::reconfigureDecoder(AudioFrame* frame)
@@ -396,10 +527,16 @@ bool AudioDecoderLibav::reconfigureDecoder(AudioFrame* frame)
     inChannels = frame->getChannels();
     inSampleRate = frame->getSampleRate();
 
+    //Output format is negotiated again with the next decoded frame
+    inLibavSampleFmt = AV_SAMPLE_FMT_NONE;
+
     switch(fCodec) {
         case PCMU:
             codecId = AV_CODEC_ID_PCM_MULAW;
             break;
+        case PCM:
+            codecId = AV_CODEC_ID_PCM_S16BE;
+            break;
         case OPUS:
             codecId = AV_CODEC_ID_OPUS;
             break;
@@ -33,6 +33,10 @@ extern "C" {
 #include "../../Filter.hh"
 
 
+/*! Audio decoder based on libavcodec. Decoded frames are only resampled when their
+    layout, rate or format differ from the configured output. Raw PCM and G.711 input
+    at the output rate and layout is converted without decoder nor resampler.
+*/
 class AudioDecoderLibav : public OneToOneFilter {
 
 public:
@@ -48,6 +52,10 @@ protected:
 private:
     void initializeEventMap();
     bool resample(AVFrame* src, AudioFrame* dst);
+    bool copyFrame(AVFrame* src, AudioFrame* dst);
+    bool directPCM();
+    bool convertPCM(AudioFrame* src, AudioFrame* dst);
+    bool negotiateFormat();
     void checkSampleFormat(int sampleFormat);
     bool inputConfig();
     bool outputConfig();
@@ -71,6 +79,7 @@ private:
     SwrContext          *resampleCtx;
     AVSampleFormat      inLibavSampleFmt;
     AVSampleFormat      outLibavSampleFmt;
+    bool                passthrough;
 
     ACodecType fCodec;
     SampleFmt inSampleFmt;
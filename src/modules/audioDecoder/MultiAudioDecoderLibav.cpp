@@ -0,0 +1,450 @@
+/*
+ *  MultiAudioDecoderLibav - A libav-based multiple stream audio decoder
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "MultiAudioDecoderLibav.hh"
+#include "../../AudioCircularBuffer.hh"
+#include "../../Utils.hh"
+
+#include <cstring>
+#include <algorithm>
+
+///////////////////////////////////////////////////
+//            AudioStreamDecoder Class           //
+///////////////////////////////////////////////////
+
+AudioStreamDecoder::AudioStreamDecoder() : codecCtx(NULL), resampleCtx(NULL), fCodec(AC_NONE),
+    inChannels(0), inSampleRate(0), inLibavSampleFmt(AV_SAMPLE_FMT_NONE),
+    negotiatedFmt(AV_SAMPLE_FMT_NONE), negotiatedChannels(0), negotiatedSampleRate(0)
+{
+    frame = av_frame_alloc();
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+}
+
+AudioStreamDecoder::~AudioStreamDecoder()
+{
+    if (codecCtx != NULL) {
+        avcodec_close(codecCtx);
+        av_free(codecCtx);
+    }
+
+    swr_free(&resampleCtx);
+    av_frame_free(&frame);
+}
+
+bool AudioStreamDecoder::decode(AudioFrame* org, AudioFrame* dst, AVSampleFormat outFmt, unsigned outChannels, unsigned outSampleRate)
+{
+    int len;
+    int gotFrame = 0;
+
+    if (!reconfigure(org)) {
+        return false;
+    }
+
+    pkt.data = org->getDataBuf();
+    pkt.size = org->getLength();
+
+    while (pkt.size > 0 && !gotFrame) {
+        len = avcodec_decode_audio4(codecCtx, frame, &gotFrame, &pkt);
+
+        if (len < 0) {
+            utils::errorMsg("[AudioStreamDecoder] Error decoding audio frame");
+            return false;
+        }
+
+        pkt.size -= len;
+        pkt.data += len;
+    }
+
+    if (!gotFrame) {
+        return false;
+    }
+
+    if (!negotiate(outFmt, outChannels, outSampleRate)) {
+        return false;
+    }
+
+    return output(dst, outChannels);
+}
+
+bool AudioStreamDecoder::reconfigure(AudioFrame* frame)
+{
+    AVCodecID codecId;
+    AVCodec *codec;
+
+    if (frame->getChannels() <= 0 || frame->getSampleRate() <= 0) {
+        utils::errorMsg("[AudioStreamDecoder] Input channels or sample rate values not valid");
+        return false;
+    }
+
+    if (frame->getCodec() == fCodec && frame->getChannels() == inChannels && frame->getSampleRate() == inSampleRate) {
+        return true;
+    }
+
+    fCodec = frame->getCodec();
+    inChannels = frame->getChannels();
+    inSampleRate = frame->getSampleRate();
+    inLibavSampleFmt = AV_SAMPLE_FMT_NONE;
+
+    switch(fCodec) {
+        case PCMU:
+            codecId = AV_CODEC_ID_PCM_MULAW;
+            break;
+        case PCM:
+            codecId = AV_CODEC_ID_PCM_S16BE;
+            break;
+        case OPUS:
+            codecId = AV_CODEC_ID_OPUS;
+            break;
+        case AAC:
+            codecId = AV_CODEC_ID_AAC;
+            break;
+        case MP3:
+            codecId = AV_CODEC_ID_MP3;
+            break;
+        default:
+            codecId = AV_CODEC_ID_NONE;
+            break;
+    }
+
+    if (codecId == AV_CODEC_ID_NONE) {
+        utils::errorMsg("[AudioStreamDecoder] Input codec not supported");
+        return false;
+    }
+
+    if (codecCtx != NULL) {
+        avcodec_close(codecCtx);
+        av_free(codecCtx);
+        codecCtx = NULL;
+    }
+
+    codec = avcodec_find_decoder(codecId);
+
+    if (codec == NULL) {
+        utils::errorMsg("[AudioStreamDecoder] Error finding codec");
+        return false;
+    }
+
+    codecCtx = avcodec_alloc_context3(codec);
+
+    if (codecCtx == NULL) {
+        utils::errorMsg("[AudioStreamDecoder] Error allocating context");
+        return false;
+    }
+
+    codecCtx->channels = inChannels;
+    codecCtx->channel_layout = av_get_default_channel_layout(inChannels);
+    codecCtx->sample_rate = inSampleRate;
+
+    if (avcodec_open2(codecCtx, codec, NULL) < 0) {
+        utils::errorMsg("[AudioStreamDecoder] Error opening context");
+        return false;
+    }
+
+    return true;
+}
+
+bool AudioStreamDecoder::negotiate(AVSampleFormat outFmt, unsigned outChannels, unsigned outSampleRate)
+{
+    if (frame->format == inLibavSampleFmt && outFmt == negotiatedFmt &&
+        outChannels == negotiatedChannels && outSampleRate == negotiatedSampleRate) {
+        return true;
+    }
+
+    inLibavSampleFmt = (AVSampleFormat) frame->format;
+    negotiatedFmt = outFmt;
+    negotiatedChannels = outChannels;
+    negotiatedSampleRate = outSampleRate;
+
+    //Decoded samples are copied as they are
+    if (inLibavSampleFmt == outFmt && inChannels == outChannels && inSampleRate == outSampleRate) {
+        swr_free(&resampleCtx);
+        return true;
+    }
+
+    resampleCtx = swr_alloc_set_opts
+                  (
+                    resampleCtx,
+                    av_get_default_channel_layout(outChannels),
+                    outFmt,
+                    outSampleRate,
+                    av_get_default_channel_layout(inChannels),
+                    inLibavSampleFmt,
+                    inSampleRate,
+                    0,
+                    NULL
+                  );
+
+    if (resampleCtx == NULL || swr_init(resampleCtx) < 0) {
+        utils::errorMsg("[AudioStreamDecoder] Error initializing resample context");
+        swr_free(&resampleCtx);
+        negotiatedFmt = AV_SAMPLE_FMT_NONE;
+        return false;
+    }
+
+    return true;
+}
+
+bool AudioStreamDecoder::output(AudioFrame* dst, unsigned outChannels)
+{
+    unsigned char *interleavedData;
+    unsigned bytesPerSample;
+    int maxSamples;
+    int samples;
+
+    bytesPerSample = av_get_bytes_per_sample(negotiatedFmt);
+    maxSamples = dst->getMaxSamples();
+
+    if (resampleCtx) {
+        //Samples that do not fit are kept by the resampler and returned with the next frame
+        samples = swr_get_out_samples(resampleCtx, frame->nb_samples);
+
+        if (samples > maxSamples) {
+            utils::warningMsg("[AudioStreamDecoder] Decoded frame exceeds the output frame size, delaying " +
+                              std::to_string(samples - maxSamples) + " samples");
+        }
+
+        if (dst->isPlanar()) {
+            samples = swr_convert(resampleCtx, dst->getPlanarDataBuf(), maxSamples,
+                                  (const uint8_t**) frame->data, frame->nb_samples);
+        } else {
+            interleavedData = dst->getDataBuf();
+            samples = swr_convert(resampleCtx, &interleavedData, maxSamples,
+                                  (const uint8_t**) frame->data, frame->nb_samples);
+        }
+
+        if (samples < 0) {
+            return false;
+        }
+
+    } else {
+        samples = std::min(frame->nb_samples, maxSamples);
+
+        if (frame->nb_samples > maxSamples) {
+            utils::warningMsg("[AudioStreamDecoder] Decoded frame exceeds the output frame size, dropping " +
+                              std::to_string(frame->nb_samples - maxSamples) + " samples");
+        }
+
+        if (dst->isPlanar()) {
+            for (unsigned i = 0; i < outChannels; i++) {
+                memcpy(dst->getPlanarDataBuf()[i], frame->data[i], samples*bytesPerSample);
+            }
+        } else {
+            memcpy(dst->getDataBuf(), frame->data[0], outChannels*samples*bytesPerSample);
+        }
+    }
+
+    if (dst->isPlanar()) {
+        dst->setLength(samples*bytesPerSample);
+    } else {
+        dst->setLength(outChannels*samples*bytesPerSample);
+    }
+
+    dst->setSamples(samples);
+    return samples > 0;
+}
+
+///////////////////////////////////////////////////
+//          MultiAudioDecoderLibav Class         //
+///////////////////////////////////////////////////
+
+MultiAudioDecoderLibav::MultiAudioDecoderLibav(unsigned maxStreams) :
+    ManyToManyFilter(maxStreams, maxStreams), outSampleFmt(S_NONE),
+    outLibavSampleFmt(AV_SAMPLE_FMT_NONE), outChannels(0), outSampleRate(0)
+{
+    avcodec_register_all();
+
+    fType = MULTI_AUDIO_DECODER;
+
+    initializeEventMap();
+
+    configure0(FLTP, DEFAULT_CHANNELS, DEFAULT_SAMPLE_RATE);
+}
+
+MultiAudioDecoderLibav::~MultiAudioDecoderLibav()
+{
+    for (auto it : decoders) {
+        delete it.second;
+    }
+
+    decoders.clear();
+}
+
+FrameQueue* MultiAudioDecoderLibav::allocQueue(ConnectionData cData)
+{
+    return AudioCircularBuffer::createNew(cData, outChannels, outSampleRate, DEFAULT_BUFFER_SIZE,
+                                            outSampleFmt, std::chrono::milliseconds(0));
+}
+
+bool MultiAudioDecoderLibav::doProcessFrame(std::map<int, Frame*> &orgFrames, std::map<int, Frame*> &dstFrames, std::vector<int> newFrames)
+{
+    AudioFrame* codedFrame;
+    AudioFrame* decodedFrame;
+    bool decoded = false;
+
+    for (auto id : newFrames) {
+        if (dstFrames.count(id) <= 0 || decoders.count(id) <= 0) {
+            continue;
+        }
+
+        codedFrame = dynamic_cast<AudioFrame*>(orgFrames[id]);
+        decodedFrame = dynamic_cast<AudioFrame*>(dstFrames[id]);
+
+        if (!codedFrame || !decodedFrame) {
+            continue;
+        }
+
+        if (!decoders[id]->decode(codedFrame, decodedFrame, outLibavSampleFmt, outChannels, outSampleRate)) {
+            utils::warningMsg("[MultiAudioDecoderLibav] Error decoding stream " + std::to_string(id));
+            continue;
+        }
+
+        decodedFrame->setConsumed(true);
+        decodedFrame->setPresentationTime(codedFrame->getPresentationTime());
+        decoded = true;
+    }
+
+    return decoded;
+}
+
+bool MultiAudioDecoderLibav::configure0(SampleFmt sampleFormat, int channels, int sampleRate)
+{
+    AVSampleFormat libavSampleFmt;
+
+    if (!decoders.empty()) {
+        utils::errorMsg("[MultiAudioDecoderLibav] Output can only be configured before connecting streams");
+        return false;
+    }
+
+    switch(sampleFormat) {
+        case U8P:
+            libavSampleFmt = AV_SAMPLE_FMT_U8P;
+            break;
+        case S16P:
+            libavSampleFmt = AV_SAMPLE_FMT_S16P;
+            break;
+        case FLTP:
+            libavSampleFmt = AV_SAMPLE_FMT_FLTP;
+            break;
+        default:
+            libavSampleFmt = AV_SAMPLE_FMT_NONE;
+            break;
+    }
+
+    if (libavSampleFmt == AV_SAMPLE_FMT_NONE || channels <= 0 || channels > MAX_CHANNELS || sampleRate <= 0) {
+        utils::errorMsg("[MultiAudioDecoderLibav] Error configuring. Only planar formats are supported");
+        return false;
+    }
+
+    outSampleFmt = sampleFormat;
+    outLibavSampleFmt = libavSampleFmt;
+    outChannels = channels;
+    outSampleRate = sampleRate;
+
+    return true;
+}
+
+bool MultiAudioDecoderLibav::specificReaderConfig(int readerID, FrameQueue* /*queue*/)
+{
+    if (decoders.count(readerID) > 0) {
+        utils::errorMsg("[MultiAudioDecoderLibav] Stream " + std::to_string(readerID) + " already exists");
+        return false;
+    }
+
+    decoders[readerID] = new AudioStreamDecoder();
+    return true;
+}
+
+bool MultiAudioDecoderLibav::specificReaderDelete(int readerID)
+{
+    if (decoders.count(readerID) <= 0) {
+        return false;
+    }
+
+    delete decoders[readerID];
+    decoders.erase(readerID);
+    return true;
+}
+
+bool MultiAudioDecoderLibav::configure(SampleFmt sampleFormat, int channels, int sampleRate)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("sampleFormat", utils::getSampleFormatAsString(sampleFormat));
+    params.Add("channels", channels);
+    params.Add("sampleRate", sampleRate);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+void MultiAudioDecoderLibav::initializeEventMap()
+{
+    eventMap["configure"] = std::bind(&MultiAudioDecoderLibav::configEvent, this, std::placeholders::_1);
+}
+
+bool MultiAudioDecoderLibav::configEvent(Jzon::Node* params)
+{
+    SampleFmt newSampleFmt = outSampleFmt;
+    int newChannels = outChannels;
+    int newSampleRate = outSampleRate;
+
+    if (!params) {
+        return false;
+    }
+
+    if (params->Has("sampleRate")) {
+        newSampleRate = params->Get("sampleRate").ToInt();
+    }
+
+    if (params->Has("channels")) {
+        newChannels = params->Get("channels").ToInt();
+    }
+
+    if (params->Has("sampleFormat")) {
+        newSampleFmt = utils::getSampleFormatFromString(params->Get("sampleFormat").ToString());
+    }
+
+    return configure0(newSampleFmt, newChannels, newSampleRate);
+}
+
+void MultiAudioDecoderLibav::doGetState(Jzon::Object &filterNode)
+{
+    Jzon::Array jsonStreams;
+
+    filterNode.Add("sampleRate", (int)outSampleRate);
+    filterNode.Add("channels", (int)outChannels);
+    filterNode.Add("sampleFormat", utils::getSampleFormatAsString(outSampleFmt));
+
+    for (auto it : decoders) {
+        Jzon::Object stream;
+        stream.Add("id", it.first);
+        stream.Add("codec", utils::getAudioCodecAsString(it.second->getCodec()));
+        stream.Add("resampling", it.second->isResampling());
+        jsonStreams.Add(stream);
+    }
+
+    filterNode.Add("streams", jsonStreams);
+}
@@ -0,0 +1,130 @@
+/*
+ *  MultiAudioDecoderLibav - A libav-based multiple stream audio decoder
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _MULTI_AUDIO_DECODER_LIBAV_HH
+#define _MULTI_AUDIO_DECODER_LIBAV_HH
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libswresample/swresample.h>
+}
+
+#include "../../AudioFrame.hh"
+#include "../../FrameQueue.hh"
+#include "../../Filter.hh"
+
+#define MAX_DECODING_STREAMS 512
+
+/*! Decoding state of one stream. Decoded samples are only resampled when their layout,
+    rate or format differ from the output ones
+*/
+class AudioStreamDecoder {
+
+public:
+    AudioStreamDecoder();
+    ~AudioStreamDecoder();
+
+    /**
+    * Decodes a coded frame
+    * @param org coded frame
+    * @param dst decoded frame, in the output format
+    * @param outFmt output sample format
+    * @param outChannels output channels
+    * @param outSampleRate output sample rate
+    * @return true if a decoded frame has been written to dst
+    */
+    bool decode(AudioFrame* org, AudioFrame* dst, AVSampleFormat outFmt, unsigned outChannels, unsigned outSampleRate);
+
+    ACodecType getCodec() {return fCodec;};
+    bool isResampling() {return resampleCtx != NULL;};
+
+private:
+    bool reconfigure(AudioFrame* frame);
+    bool negotiate(AVSampleFormat outFmt, unsigned outChannels, unsigned outSampleRate);
+    bool output(AudioFrame* dst, unsigned outChannels);
+
+    AVCodecContext      *codecCtx;
+    AVFrame             *frame;
+    AVPacket            pkt;
+    SwrContext          *resampleCtx;
+
+    ACodecType          fCodec;
+    unsigned            inChannels;
+    unsigned            inSampleRate;
+    AVSampleFormat      inLibavSampleFmt;
+
+    AVSampleFormat      negotiatedFmt;
+    unsigned            negotiatedChannels;
+    unsigned            negotiatedSampleRate;
+};
+
+/*! Decodes many audio streams in a single filter, so that they are all processed in one
+    pass instead of one runnable per stream. The stream read by each reader is decoded
+    to the writer with the same id.
+*/
+class MultiAudioDecoderLibav : public ManyToManyFilter {
+
+public:
+    /**
+    * Class constructor
+    * @param maxStreams maximum number of decoded streams
+    */
+    MultiAudioDecoderLibav(unsigned maxStreams = MAX_DECODING_STREAMS);
+
+    /**
+    * Class destructor
+    */
+    ~MultiAudioDecoderLibav();
+
+    /**
+    * Configures the output of all the streams
+    * @param sampleFormat output sample format (planar)
+    * @param channels output channels
+    * @param sampleRate output sample rate
+    */
+    bool configure(SampleFmt sampleFormat, int channels, int sampleRate);
+
+protected:
+    FrameQueue* allocQueue(ConnectionData cData);
+    bool doProcessFrame(std::map<int, Frame*> &orgFrames, std::map<int, Frame*> &dstFrames, std::vector<int> newFrames);
+    bool configure0(SampleFmt sampleFormat, int channels, int sampleRate);
+    bool specificReaderConfig(int readerID, FrameQueue* queue);
+    bool specificReaderDelete(int readerID);
+
+private:
+    void initializeEventMap();
+    bool configEvent(Jzon::Node* params);
+    void doGetState(Jzon::Object &filterNode);
+
+    //NOTE: Writers are paired with readers by id, so there is no specific writer configuration
+    bool specificWriterConfig(int /*writerID*/) {return true;};
+    bool specificWriterDelete(int /*writerID*/) {return true;};
+
+    std::map<int, AudioStreamDecoder*> decoders;
+
+    SampleFmt           outSampleFmt;
+    AVSampleFormat      outLibavSampleFmt;
+    unsigned            outChannels;
+    unsigned            outSampleRate;
+};
+
+#endif
@@ -39,6 +39,10 @@ AudioEncoderLibav::AudioEncoderLibav() : OneToOneFilter(),
     codec = NULL;
     codecCtx = NULL;
     resampleCtx = NULL;
+    fifo = NULL;
+    resampledData = NULL;
+    resampledMaxSamples = 0;
+    needsResampling = true;
     libavFrame = av_frame_alloc();
     av_init_packet(&pkt);
     pkt.data = NULL;
@@ -54,6 +58,9 @@ AudioEncoderLibav::AudioEncoderLibav() : OneToOneFilter(),
     framerateMod = 1;
 
     currentTime = std::chrono::microseconds(0);
+    syncTs = std::chrono::microseconds(0);
+    fifoFirstSample = 0;
+    synchronized = false;
 
     initializeEventMap();
 }
@@ -63,6 +70,16 @@ AudioEncoderLibav::~AudioEncoderLibav()
     avcodec_close(codecCtx);
     av_free(codecCtx);
     swr_free(&resampleCtx);
+
+    if (fifo) {
+        av_audio_fifo_free(fifo);
+    }
+
+    if (resampledData) {
+        av_freep(&resampledData[0]);
+    }
+
+    av_freep(&resampledData);
     av_free(libavFrame);
     av_free_packet(&pkt);
 }
@@ -74,7 +91,8 @@ FrameQueue* AudioEncoderLibav::allocQueue(ConnectionData cData)
 
 bool AudioEncoderLibav::doProcessFrame(Frame *org, Frame *dst)
 {     
-    int ret, gotFrame, samples;
+    int ret, gotFrame;
+    int64_t pts;
     AudioFrame* rawFrame;
     AudioFrame* codedFrame;
 
@@ -91,18 +109,34 @@ bool AudioEncoderLibav::doProcessFrame(Frame *org, Frame *dst)
         return false;
     }
 
-    //set up buffer and buffer length pointers
-    pkt.data = codedFrame->getDataBuf();
-    pkt.size = codedFrame->getMaxLength();
+    if (!pushSamples(rawFrame)) {
+        utils::errorMsg("Error encoding audio frame: resampling error");
+        return false;
+    }
 
-    //resample in order to adapt to encoder constraints
-    samples = resample(rawFrame, libavFrame);
+    //Only whole codec frames are encoded, remaining samples wait for the next input frame
+    if (av_audio_fifo_size(fifo) < (int) samplesPerFrame) {
+        return false;
+    }
 
-    if (samples <= 0) {
-        utils::errorMsg("Error encoding audio frame: resampling error");
+    //The encoder may still reference the previous frame buffers
+    if (av_frame_make_writable(libavFrame) < 0) {
+        utils::errorMsg("Error encoding audio frame: could not make the frame writable");
+        return false;
+    }
+
+    if (av_audio_fifo_read(fifo, (void**) libavFrame->data, samplesPerFrame) < (int) samplesPerFrame) {
+        utils::errorMsg("Error encoding audio frame: could not read from the sample FIFO");
         return false;
     }
 
+    libavFrame->pts = fifoFirstSample;
+    fifoFirstSample += samplesPerFrame;
+
+    //The packet is written straight into the destination frame buffer
+    pkt.data = codedFrame->getDataBuf();
+    pkt.size = codedFrame->getMaxLength();
+
     ret = avcodec_encode_audio2(codecCtx, &pkt, libavFrame, &gotFrame);
 
     if (ret < 0) {
@@ -114,11 +148,14 @@ bool AudioEncoderLibav::doProcessFrame(Frame *org, Frame *dst)
         return false;
     }
 
+    //Packet timestamps include the encoder delay, if any
+    pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : libavFrame->pts;
+
     codedFrame->setLength(pkt.size);
-    codedFrame->setSamples(samples);
+    codedFrame->setSamples(samplesPerFrame);
 
     dst->setConsumed(true);
-    dst->setPresentationTime(org->getPresentationTime());
+    dst->setPresentationTime(syncTs + std::chrono::microseconds(pts*std::micro::den/outputStreamInfo->audio.sampleRate));
     dst->setOriginTime(org->getOriginTime());
     dst->setSequenceNumber(org->getSequenceNumber());
     
@@ -142,7 +179,8 @@ bool AudioEncoderLibav::specificReaderConfig(int /*readerID*/, FrameQueue* queue
         return false;
     }
 
-    b->setOutputFrameSamples(samplesPerFrame);
+    //Input frames are at most one codec frame long once resampled, so the FIFO does not grow
+    b->setOutputFrameSamples(samplesPerFrame*b->getSampleRate()/outputStreamInfo->audio.sampleRate);
 
     return true;
 }
@@ -232,6 +270,8 @@ bool AudioEncoderLibav::codingConfig(AVCodecID codecId)
     codecCtx->sample_rate = outputStreamInfo->audio.sampleRate;
     codecCtx->sample_fmt = internalLibavSampleFmt;
     codecCtx->bit_rate = outputBitrate;
+    codecCtx->time_base.num = 1;
+    codecCtx->time_base.den = outputStreamInfo->audio.sampleRate;
 
     if (avcodec_open2(codecCtx, codec, NULL) < 0) {
         utils::errorMsg("Could not open codec context");
@@ -255,11 +295,33 @@ bool AudioEncoderLibav::codingConfig(AVCodecID codecId)
         return false;
     }
 
+    //The channels or the sample format may have changed, so the FIFO is freed and allocated again
+    if (fifo) {
+        av_audio_fifo_free(fifo);
+    }
+
+    fifo = av_audio_fifo_alloc(internalLibavSampleFmt, outputStreamInfo->audio.channels, 2*samplesPerFrame);
+
+    if (!fifo) {
+        utils::errorMsg("Could not allocate the sample FIFO");
+        return false;
+    }
+
     return true;
 }
 
 bool AudioEncoderLibav::resamplingConfig()
 {
+    needsResampling = inputLibavSampleFmt != internalLibavSampleFmt || 
+                      inputChannels != outputStreamInfo->audio.channels ||
+                      inputSampleRate != outputStreamInfo->audio.sampleRate;
+
+    //Samples are written to the FIFO as they are
+    if (!needsResampling) {
+        swr_free(&resampleCtx);
+        return true;
+    }
+
     resampleCtx = swr_alloc_set_opts
                   (
                     resampleCtx,
@@ -328,34 +390,81 @@ bool AudioEncoderLibav::reconfigure(AudioFrame* frame)
     return true;
 }
 
-int AudioEncoderLibav::resample(AudioFrame* src, AVFrame* dst)
+bool AudioEncoderLibav::pushSamples(AudioFrame* src)
 {
+    uint8_t **data;
+    unsigned char *interleavedData;
+    int64_t delay = 0;
     int samples;
-    unsigned char *auxBuff;
 
     if (src->isPlanar()) {
-        samples = swr_convert(
-                    resampleCtx,
-                    dst->data,
-                    dst->nb_samples,
-                    (const uint8_t**)src->getPlanarDataBuf(),
-                    src->getSamples()
-                  );
-
+        data = src->getPlanarDataBuf();
     } else {
-        auxBuff = src->getDataBuf();
+        interleavedData = src->getDataBuf();
+        data = &interleavedData;
+    }
 
-        samples = swr_convert(
-                    resampleCtx,
-                    dst->data,
-                    dst->nb_samples,
-                    (const uint8_t**)auxBuff,
-                    src->getSamples()
-                  );
+    if (needsResampling) {
+        delay = swr_get_delay(resampleCtx, outputStreamInfo->audio.sampleRate);
+    }
 
+    syncTimestamps(src, av_audio_fifo_size(fifo) + delay);
+
+    if (!needsResampling) {
+        return av_audio_fifo_write(fifo, (void**) data, src->getSamples()) == (int) src->getSamples();
+    }
+
+    samples = av_rescale_rnd(swr_get_delay(resampleCtx, inputSampleRate) + src->getSamples(),
+                             outputStreamInfo->audio.sampleRate, inputSampleRate, AV_ROUND_UP);
+
+    if (samples > resampledMaxSamples && !allocResampledData(samples)) {
+        return false;
+    }
+
+    samples = swr_convert(resampleCtx, resampledData, resampledMaxSamples, (const uint8_t**) data, src->getSamples());
+
+    if (samples < 0) {
+        return false;
     }
 
-    return samples;
+    return av_audio_fifo_write(fifo, (void**) resampledData, samples) == samples;
+}
+
+void AudioEncoderLibav::syncTimestamps(AudioFrame* src, int64_t pendingSamples)
+{
+    std::chrono::microseconds pendingTime;
+    std::chrono::microseconds deviation;
+    std::chrono::microseconds maxDeviation;
+
+    //Time from syncTs to the first sample of this frame, according to the sample count
+    pendingTime = std::chrono::microseconds((fifoFirstSample + pendingSamples)*std::micro::den/outputStreamInfo->audio.sampleRate);
+    deviation = src->getPresentationTime() - (syncTs + pendingTime);
+    maxDeviation = std::chrono::microseconds(samplesPerFrame*std::micro::den/outputStreamInfo->audio.sampleRate);
+
+    //The sample count keeps going, so that encoder timestamps are monotonic
+    if (!synchronized || deviation > maxDeviation || deviation < -maxDeviation) {
+        syncTs = src->getPresentationTime() - pendingTime;
+        synchronized = true;
+    }
+}
+
+bool AudioEncoderLibav::allocResampledData(int samples)
+{
+    if (resampledData) {
+        av_freep(&resampledData[0]);
+    }
+
+    av_freep(&resampledData);
+    resampledMaxSamples = 0;
+
+    if (av_samples_alloc_array_and_samples(&resampledData, NULL, outputStreamInfo->audio.channels, 
+                                           samples, internalLibavSampleFmt, 0) < 0) {
+        utils::errorMsg("Could not allocate the resampling buffer");
+        return false;
+    }
+
+    resampledMaxSamples = samples;
+    return true;
 }
 
 void AudioEncoderLibav::doGetState(Jzon::Object &filterNode)
@@ -363,6 +472,7 @@ void AudioEncoderLibav::doGetState(Jzon::Object &filterNode)
     filterNode.Add("codec", utils::getAudioCodecAsString(getCodec()));
     filterNode.Add("sampleRate", (int)outputStreamInfo->audio.sampleRate);
     filterNode.Add("channels", (int)outputStreamInfo->audio.channels);
+    filterNode.Add("frameSize", (int)samplesPerFrame);
 }
 
 bool checkSampleFormat(AVCodec *codec, enum AVSampleFormat sampleFmt)
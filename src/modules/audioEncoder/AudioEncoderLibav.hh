@@ -28,6 +28,7 @@
 extern "C" {
     #include <libavcodec/avcodec.h>
     #include <libswresample/swresample.h>
+    #include <libavutil/audio_fifo.h>
 }
 
 #include "../../AudioFrame.hh"
@@ -36,6 +37,11 @@ extern "C" {
 #include "../../Utils.hh"
 #include "../../StreamInfo.hh"
 
+/*! Audio encoder based on libavcodec. Input samples are converted (only if needed) into a
+    sample FIFO, from which exactly one codec frame is encoded at a time. Presentation times
+    are derived from the FIFO sample count, so they stay sample accurate whatever the input
+    and codec frame sizes are
+*/
 class AudioEncoderLibav : public OneToOneFilter {
 
 public:
@@ -55,7 +61,9 @@ protected:
 private:
     bool configure0(ACodecType codec, int codedAudioChannels, int codedAudioSampleRate, int bitrate);
     void initializeEventMap();
-    int resample(AudioFrame* src, AVFrame* dst);
+    bool pushSamples(AudioFrame* src);
+    void syncTimestamps(AudioFrame* src, int64_t pendingSamples);
+    bool allocResampledData(int samples);
     bool reconfigure(AudioFrame* frame);
     bool resamplingConfig();
     bool codingConfig(AVCodecID codecId); 
@@ -74,6 +82,10 @@ private:
     AVFrame             *libavFrame;
     AVPacket            pkt;
     SwrContext          *resampleCtx;
+    AVAudioFifo         *fifo;
+    uint8_t             **resampledData;
+    int                 resampledMaxSamples;
+    bool                needsResampling;
     int                 gotFrame;
 
     unsigned            samplesPerFrame;
@@ -91,6 +103,11 @@ private:
     std::chrono::microseconds diffTime;
     std::chrono::microseconds lastDiffTime;
 
+    //Timestamps are computed from syncTs and the output sample count of the first FIFO sample
+    std::chrono::microseconds syncTs;
+    int64_t fifoFirstSample;
+    bool synchronized;
+
     float framerateMod;
 };
 
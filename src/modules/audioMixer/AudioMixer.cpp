@@ -29,12 +29,17 @@
 #include <utility>
 #include <cmath>
 #include <string.h>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 AudioMixer::AudioMixer(int inputChannels) : 
-ManyToOneFilter(inputChannels), channels(DEFAULT_CHANNELS),
+ManyToManyFilter(inputChannels, inputChannels + 1), channels(DEFAULT_CHANNELS),
 sampleRate(DEFAULT_SAMPLE_RATE), sampleFormat(FLTP), maxMixingChannels(inputChannels),
-front(0), rear(0), masterGain(DEFAULT_MASTER_GAIN), th(COMPRESSION_THRESHOLD),
-syncTs(std::chrono::microseconds(-1))
+front(0), rear(0), masterGain(DEFAULT_MASTER_GAIN), th(LIMITER_THRESHOLD),
+activitySeq(0), syncTs(std::chrono::microseconds(-1)), adaptiveBuffering(false), skipSilent(false)
 {
     fType = AUDIO_MIXER;
     inputFrameSamples = AudioFrame::getDefaultSamples(sampleRate);
@@ -46,13 +51,25 @@ syncTs(std::chrono::microseconds(-1))
         mixBuffers[i] = new float[mixBufferMaxSamples]();
     }
 
+    convBuffer = new float[channels*mixBufferMaxSamples]();
+
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        busBuffers[i] = new float[outputSamples + LIMITER_LOOKAHEAD*sampleRate/std::milli::den]();
+    }
+
     initializeEventMap();
 }
 
 AudioMixer::~AudioMixer() 
 {
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        delete mixBuffers[i];
+        delete[] mixBuffers[i];
+    }
+
+    delete[] convBuffer;
+
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        delete[] busBuffers[i];
     }
 }
 
@@ -62,10 +79,9 @@ FrameQueue *AudioMixer::allocQueue(ConnectionData cData)
                                             sampleFormat, std::chrono::milliseconds(0));
 }
 
-bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, std::vector<int> newFrames) 
+bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, std::map<int, Frame*> &dstFrames, std::vector<int> newFrames) 
 {
     AudioFrame* aFrame;
-    AudioFrame* aDstFrame;
 
     for (auto id : newFrames) {
         aFrame = dynamic_cast<AudioFrame*>(orgFrames[id]);
@@ -82,38 +98,39 @@ bool AudioMixer::doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, st
         }
     }
 
-    aDstFrame = dynamic_cast<AudioFrame*>(dst);
-
-    if (!aDstFrame) {
-        utils::errorMsg("[AudioMixer] Output frame must be an AudioFrame");
-        return false;
-    }
-
-    if (!extractMixedFrame(aDstFrame)) {
-        return false;
-    }
-
-    dst->setConsumed(true);
-
-    return true;
+    return extractMixedFrames(dstFrames);
 }
 
 bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame) 
 {
     unsigned char* b;
-    float* mixBuff;
-    float fSample;
+    float const* samples;
     SampleFmt fmt;
     unsigned nOfSamples;
-    int bytesPerSample;
     unsigned absolutePosition;
     unsigned bufferIdx;
+    unsigned firstSpan;
     unsigned freeSpaceInMixBuffer;
+    float* contribution;
+    float gain;
+    float sumSq, peak;
+    float planeSumSq, planePeak;
+    float power;
+    float const* planes[MAX_CHANNELS];
+    bool mix;
 
-    bytesPerSample = utils::getBytesPerSampleFromFormat(sampleFormat);
     fmt = frame->getSampleFmt();
     nOfSamples = frame->getSamples();
 
+    if (nOfSamples == 0) {
+        return true;
+    }
+
+    if (fmt != S16P && fmt != FLTP) {
+        utils::errorMsg("[AudioMixer] Only S16P and FLTP sample formats are supported");
+        return false;
+    }
+
     freeSpaceInMixBuffer = mixBufferMaxSamples - (rear - front);
 
     if (freeSpaceInMixBuffer < nOfSamples) {
@@ -140,21 +157,48 @@ bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame)
         absolutePosition = front;
     }
 
+    gain = gains[mixChId]*masterGain;
+
+    //The frame is mixed in at most two contiguous spans, before and after the ring wraparound
+    bufferIdx = absolutePosition % mixBufferMaxSamples;
+    firstSpan = std::min(nOfSamples, mixBufferMaxSamples - bufferIdx);
+
+    sumSq = 0;
+    peak = 0;
+
     for (int i = 0; i < channels; i++) {
 
         b = frame->getPlanarDataBuf()[i];
-        bufferIdx = absolutePosition % mixBufferMaxSamples;
-        mixBuff = mixBuffers[i];
 
-        for (unsigned j = 0; j < nOfSamples; j++) {
+        if (fmt == FLTP) {
+            planes[i] = reinterpret_cast<float const*>(b);
+        } else {
+            bytesToFloat(b, convBuffer + i*mixBufferMaxSamples, nOfSamples, fmt);
+            planes[i] = convBuffer + i*mixBufferMaxSamples;
+        }
 
-            if (!bytesToFloat(b + j*bytesPerSample, fSample, fmt)) {
-                utils::errorMsg("[AudioMixer] Error converting samples from bytes to float");
-                return false;
-            }
+        //Samples are measured while they are still in cache for mixing them
+        measureSamples(planes[i], nOfSamples, planeSumSq, planePeak);
+        sumSq += planeSumSq;
+        peak = std::max(peak, planePeak);
+    }
+
+    power = sumSq/(nOfSamples*channels);
+
+    //Inactive channels under the voice threshold do not change the mix noticeably, all their planes are left out
+    mix = !skipSilent || meters[mixChId].active || isVoiced(meters[mixChId], power);
+
+    for (int i = 0; i < channels && mix; i++) {
+        samples = planes[i];
 
-            mixSample(fSample, mixBuff, bufferIdx, gains[mixChId]);
-            bufferIdx = (bufferIdx + 1) % mixBufferMaxSamples;
+        mixSamples(samples, mixBuffers[i] + bufferIdx, firstSpan, gain);
+        mixSamples(samples + firstSpan, mixBuffers[i], nOfSamples - firstSpan, gain);
+
+        //Channels excluded from any bus also keep their own contribution, to be subtracted later
+        if (contributions.count(mixChId) > 0) {
+            contribution = contributions[mixChId].data() + i*mixBufferMaxSamples;
+            mixSamples(samples, contribution + bufferIdx, firstSpan, gain);
+            mixSamples(samples + firstSpan, contribution, nOfSamples - firstSpan, gain);
         }
     }
 
@@ -162,33 +206,240 @@ bool AudioMixer::pushToBuffer(int mixChId, AudioFrame* frame)
         rear = absolutePosition + nOfSamples;
     }
 
+    updateMeter(mixChId, power, peak, nOfSamples, frame->getPresentationTime());
+
     return true;
 }
 
-void AudioMixer::mixSample(float sample, float* mixBuff, int bufferIdx, float gain)
+void AudioMixer::measureSamples(float const* samples, unsigned nOfSamples, float &sumSq, float &peak)
+{
+    unsigned j = 0;
+
+    sumSq = 0;
+    peak = 0;
+
+#ifdef __SSE2__
+    __m128 const vSign = _mm_set1_ps(-0.0f);
+    __m128 vSum = _mm_setzero_ps();
+    __m128 vPeak = _mm_setzero_ps();
+    __m128 vX;
+    float lanes[4];
+
+    for (; j + 4 <= nOfSamples; j += 4) {
+        vX = _mm_loadu_ps(samples + j);
+        vSum = _mm_add_ps(vSum, _mm_mul_ps(vX, vX));
+        vPeak = _mm_max_ps(vPeak, _mm_andnot_ps(vSign, vX));
+    }
+
+    _mm_storeu_ps(lanes, vSum);
+    sumSq = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, vPeak);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+    for (; j < nOfSamples; j++) {
+        sumSq += samples[j]*samples[j];
+        peak = std::max(peak, std::fabs(samples[j]));
+    }
+}
+
+static float toDecibels(float power)
+{
+    if (power <= 0) {
+        return METER_FLOOR;
+    }
+
+    return std::max(10*std::log10(power), (float) METER_FLOOR);
+}
+
+bool AudioMixer::isVoiced(ChannelMeter const& meter, float power)
+{
+    float level = toDecibels(power);
+    return level > VAD_MIN_LEVEL && level > meter.noiseFloor + VAD_NOISE_MARGIN;
+}
+
+void AudioMixer::updateMeter(int mixChId, float power, float peak, unsigned nOfSamples, std::chrono::microseconds ts)
+{
+    ChannelMeter &meter = meters[mixChId];
+    std::chrono::microseconds duration;
+    ActivityEvent event;
+    float level;
+    bool active;
+
+    duration = std::chrono::microseconds(nOfSamples*std::micro::den/sampleRate);
+    level = toDecibels(power);
+
+    meter.rms = level;
+    meter.peak = toDecibels(peak*peak);
+
+    //The noise floor starts at the first measured level, instead of rising slowly from digital silence
+    if (!meter.measured) {
+        meter.noiseFloor = level;
+        meter.measured = true;
+    }
+
+    if (isVoiced(meter, power)) {
+        meter.hangover = std::chrono::milliseconds(VAD_HANGOVER);
+        active = true;
+    } else {
+        meter.hangover = std::max(meter.hangover - duration, std::chrono::microseconds(0));
+        active = meter.hangover.count() > 0;
+    }
+
+    //The noise floor follows level drops at once and rises slowly, so that speech does not raise it
+    if (level < meter.noiseFloor) {
+        meter.noiseFloor = level;
+    } else {
+        meter.noiseFloor = std::min(level, meter.noiseFloor + (float) (NOISE_FLOOR_RISE*duration.count()/std::micro::den));
+    }
+
+    if (active == meter.active) {
+        return;
+    }
+
+    meter.active = active;
+
+    event.seq = activitySeq++;
+    event.id = mixChId;
+    event.active = active;
+    event.ts = ts;
+    activityEvents.push_back(event);
+
+    if (activityEvents.size() > MAX_ACTIVITY_EVENTS) {
+        activityEvents.pop_front();
+    }
+}
+
+void AudioMixer::mixSamples(float const* samples, float* mixBuff, unsigned nOfSamples, float gain)
+{
+    unsigned j = 0;
+
+#ifdef __SSE2__
+    __m128 const vGain = _mm_set1_ps(gain);
+
+    for (; j + 4 <= nOfSamples; j += 4) {
+        _mm_storeu_ps(mixBuff + j, _mm_add_ps(_mm_loadu_ps(mixBuff + j), _mm_mul_ps(_mm_loadu_ps(samples + j), vGain)));
+    }
+#endif
+
+    for (; j < nOfSamples; j++) {
+        mixBuff[j] += samples[j]*gain;
+    }
+}
+
+LookaheadLimiter::LookaheadLimiter() : lookahead(1), threshold(1), attackStep(1), release(1), gain(1)
 {
-    mixBuff[bufferIdx] += sample*gain*masterGain;
+}
 
-    if (mixBuff[bufferIdx] > th) {
-        mixBuff[bufferIdx] = ((1-th)/(2-th))*mixBuff[bufferIdx] + th/(2-th);
-    } else if (mixBuff[bufferIdx] < -th) {
-        mixBuff[bufferIdx] = ((1-th)/(2-th))*mixBuff[bufferIdx] - th/(2-th);
-    } 
+void LookaheadLimiter::config(unsigned sampleRate, float threshold_)
+{
+    lookahead = std::max((unsigned) (LIMITER_LOOKAHEAD*sampleRate/std::milli::den), 1U);
+    threshold = threshold_;
+    //Gains are within (0, 1], so the attack ramp of any peak fits in the look-ahead
+    attackStep = 1.0f/lookahead;
+    release = 1 - std::exp(-1.0f*std::milli::den/(LIMITER_RELEASE*sampleRate));
+    gain = 1;
 }
 
-bool AudioMixer::extractMixedFrame(AudioFrame* frame)
+void LookaheadLimiter::process(float* const* planes, unsigned channels, unsigned nOfSamples, unsigned ahead)
+{
+    unsigned length = nOfSamples + std::min(ahead, lookahead);
+    float peak;
+
+    if (length == 0) {
+        return;
+    }
+
+    envelope.resize(length);
+
+    //Gain needed by each sample, set by the loudest channel so that it does not depend on their order
+    for (unsigned j = 0; j < length; j++) {
+        peak = 0;
+
+        for (unsigned c = 0; c < channels; c++) {
+            peak = std::max(peak, std::fabs(planes[c][j]));
+        }
+
+        envelope[j] = peak > threshold ? threshold/peak : 1.0f;
+    }
+
+    //Going backwards, each gain reduction is preceded by a ramp of at most attackStep per sample
+    for (unsigned j = length - 1; j > 0; j--) {
+        envelope[j - 1] = std::min(envelope[j - 1], envelope[j] + attackStep);
+    }
+
+    for (unsigned j = 0; j < nOfSamples; j++) {
+        gain = std::min(envelope[j], gain + (1 - gain)*release);
+
+        for (unsigned c = 0; c < channels; c++) {
+            planes[c][j] *= gain;
+        }
+    }
+}
+
+bool AudioMixer::extractMixedFrames(std::map<int, Frame*> &dstFrames)
 {
     unsigned mixedElements = rear - front;
     unsigned pos;
-    unsigned char* b;
+    unsigned firstSpan;
+    unsigned ahead;
     float *mixB;
-    std::chrono::microseconds ts;
-    unsigned bytesPerSample;
+    AudioFrame* aDstFrame;
+    bool extracted = false;
 
     if (mixedElements < mixingThreshold) {
         return false;
     }
 
+    pos = front % mixBufferMaxSamples;
+    firstSpan = std::min(outputSamples, mixBufferMaxSamples - pos);
+
+    //Mixed samples after the frame are the limiter look-ahead. They are already buffered
+    //by the mixing threshold, so the limiter adds no latency
+    ahead = std::min(mixedElements - outputSamples, (unsigned) (LIMITER_LOOKAHEAD*sampleRate/std::milli::den));
+
+    for (auto it : dstFrames) {
+        aDstFrame = dynamic_cast<AudioFrame*>(it.second);
+
+        if (!aDstFrame) {
+            utils::errorMsg("[AudioMixer] Output frame must be an AudioFrame");
+            continue;
+        }
+
+        if (!fillBusFrame(aDstFrame, it.first, pos, ahead)) {
+            continue;
+        }
+
+        aDstFrame->setConsumed(true);
+        extracted = true;
+    }
+
+    for (int i = 0; i < channels; i++) {
+        mixB = mixBuffers[i];
+        std::fill(mixB + pos, mixB + pos + firstSpan, 0.0f);
+        std::fill(mixB, mixB + outputSamples - firstSpan, 0.0f);
+
+        for (auto &c : contributions) {
+            mixB = c.second.data() + i*mixBufferMaxSamples;
+            std::fill(mixB + pos, mixB + pos + firstSpan, 0.0f);
+            std::fill(mixB, mixB + outputSamples - firstSpan, 0.0f);
+        }
+    }
+
+    front += outputSamples;
+    return extracted;
+}
+
+bool AudioMixer::fillBusFrame(AudioFrame* frame, int busId, unsigned pos, unsigned ahead)
+{
+    float const* mixB;
+    float const* contribution;
+    std::chrono::microseconds ts;
+    unsigned bytesPerSample;
+    unsigned length;
+    unsigned idx;
+    int excludedChannel;
+
     bytesPerSample = utils::getBytesPerSampleFromFormat(sampleFormat);
 
     if (bytesPerSample <= 0) {
@@ -196,20 +447,37 @@ bool AudioMixer::extractMixedFrame(AudioFrame* frame)
         return false;
     }
 
-    for (int i = 0; i < channels; i++) {
+    excludedChannel = buses.count(busId) > 0 ? buses[busId] : NO_EXCLUDED_CHANNEL;
+    length = outputSamples + ahead;
 
-        b = frame->getPlanarDataBuf()[i];
-        pos = front % mixBufferMaxSamples;
+    //The common mix is shared by all the buses, so each one is built in its own buffers
+    for (int i = 0; i < channels; i++) {
         mixB = mixBuffers[i];
 
-        for (unsigned j = 0; j < outputSamples; j++) {
-
-            if (!floatToBytes(b + j*bytesPerSample, mixB[(pos+j)%mixBufferMaxSamples], sampleFormat)) {
-                utils::errorMsg("[AudioMixer] Error converting samples from bytes to float");
-                return false;
+        if (excludedChannel != NO_EXCLUDED_CHANNEL && contributions.count(excludedChannel) > 0) {
+            contribution = contributions[excludedChannel].data() + i*mixBufferMaxSamples;
+            for (unsigned j = 0; j < length; j++) {
+                idx = (pos + j) % mixBufferMaxSamples;
+                busBuffers[i][j] = mixB[idx] - contribution[idx];
+            }
+        } else {
+            for (unsigned j = 0; j < length; j++) {
+                busBuffers[i][j] = mixB[(pos + j) % mixBufferMaxSamples];
             }
+        }
+    }
 
-            mixB[(pos+j)%mixBufferMaxSamples] = 0;
+    //Channels are fully accumulated at this point, so the mix is limited once
+    if (limiters.count(busId) == 0) {
+        limiters[busId].config(sampleRate, th);
+    }
+
+    limiters[busId].process(busBuffers, channels, outputSamples, ahead);
+
+    for (int i = 0; i < channels; i++) {
+        if (!floatToBytes(frame->getPlanarDataBuf()[i], busBuffers[i], outputSamples, sampleFormat)) {
+            utils::errorMsg("[AudioMixer] Error converting samples from float to bytes");
+            return false;
         }
     }
 
@@ -220,10 +488,29 @@ bool AudioMixer::extractMixedFrame(AudioFrame* frame)
     frame->setChannels(channels);
     frame->setSampleRate(sampleRate);
 
-    front += outputSamples;
     return true;
 }
 
+void AudioMixer::updateContributions()
+{
+    std::map<int, std::vector<float>> excluded;
+
+    for (auto it : buses) {
+        if (it.second == NO_EXCLUDED_CHANNEL || gains.count(it.second) <= 0 ||
+            excluded.count(it.second) > 0) {
+            continue;
+        }
+
+        if (contributions.count(it.second) > 0) {
+            excluded[it.second].swap(contributions[it.second]);
+        } else {
+            excluded[it.second].assign(channels*mixBufferMaxSamples, 0.0f);
+        }
+    }
+
+    contributions.swap(excluded);
+}
+
 bool AudioMixer::bytesToFloat(unsigned char const* origin, float &dst, SampleFmt fmt) 
 {
     short value;
@@ -263,6 +550,49 @@ bool AudioMixer::floatToBytes(unsigned char* dst, float const origin, SampleFmt
     return true;
 }
 
+bool AudioMixer::bytesToFloat(unsigned char const* origin, float* dst, unsigned nOfSamples, SampleFmt fmt)
+{
+    short value;
+
+    switch(fmt) {
+        case S16P:
+            for (unsigned i = 0; i < nOfSamples; i++) {
+                value = (short)(origin[2*i] | origin[2*i + 1] << 8);
+                dst[i] = value * (1.0f/32768.0f);
+            }
+            break;
+        case FLTP:
+            memcpy(dst, origin, nOfSamples*sizeof(float));
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+bool AudioMixer::floatToBytes(unsigned char* dst, float const* origin, unsigned nOfSamples, SampleFmt fmt)
+{
+    short value;
+
+    switch(fmt) {
+        case S16P:
+            for (unsigned i = 0; i < nOfSamples; i++) {
+                value = std::min(std::max(origin[i], -1.0f), 32767.0f/32768.0f) * 32768.0f;
+                dst[2*i] = value & 0xFF;
+                dst[2*i + 1] = (value >> 8) & 0xFF;
+            }
+            break;
+        case FLTP:
+            memcpy(dst, origin, nOfSamples*sizeof(float));
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
 bool AudioMixer::specificReaderConfig(int readerID, FrameQueue* queue)
 {
     AudioCircularBuffer* inBuffer;
@@ -275,21 +605,68 @@ bool AudioMixer::specificReaderConfig(int readerID, FrameQueue* queue)
     }
 
     inBuffer->setOutputFrameSamples(inputFrameSamples);
+    inBuffer->setAdaptiveBuffering(adaptiveBuffering);
+    inputBuffers[readerID] = inBuffer;
 
     gains[readerID] = DEFAULT_CHANNEL_GAIN;
 
+    meters[readerID].rms = METER_FLOOR;
+    meters[readerID].peak = METER_FLOOR;
+    meters[readerID].noiseFloor = METER_FLOOR;
+    meters[readerID].active = false;
+    meters[readerID].measured = false;
+    meters[readerID].hangover = std::chrono::microseconds(0);
+
     return true;
 }
 
 bool AudioMixer::specificReaderDelete(int readerID)
 {
+    inputBuffers.erase(readerID);
+    meters.erase(readerID);
+
     if (gains.count(readerID) > 0){
         gains.erase(readerID);
+        updateContributions();
         return true;
     }
     return false;
 }
 
+bool AudioMixer::specificWriterConfig(int writerID)
+{
+    buses[writerID] = NO_EXCLUDED_CHANNEL;
+    return true;
+}
+
+bool AudioMixer::specificWriterDelete(int writerID)
+{
+    if (buses.count(writerID) > 0){
+        buses.erase(writerID);
+        limiters.erase(writerID);
+        updateContributions();
+        return true;
+    }
+    return false;
+}
+
+bool AudioMixer::setBusExclusion(int id, int excludedChannel)
+{
+    if (buses.count(id) <= 0) {
+        utils::errorMsg("[AudioMixer] Error configuring bus. Incorrect Id " + std::to_string(id));
+        return false;
+    }
+
+    if (excludedChannel != NO_EXCLUDED_CHANNEL && gains.count(excludedChannel) <= 0) {
+        utils::errorMsg("[AudioMixer] Error configuring bus. Incorrect channel Id " + std::to_string(excludedChannel));
+        return false;
+    }
+
+    buses[id] = excludedChannel;
+    updateContributions();
+    return true;
+}
+
 bool AudioMixer::setChannelGain(int id, float value)
 {
     if (gains.count(id) <= 0) {
@@ -394,6 +771,68 @@ bool AudioMixer::muteMasterEvent(Jzon::Node* params)
     return true;
 }
 
+bool AudioMixer::configBusEvent(Jzon::Node* params)
+{
+    int excludedChannel = NO_EXCLUDED_CHANNEL;
+
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("id")) {
+        return false;
+    }
+
+    if (params->Has("exclude")) {
+        excludedChannel = params->Get("exclude").ToInt();
+    }
+
+    return setBusExclusion(params->Get("id").ToInt(), excludedChannel);
+}
+
+bool AudioMixer::configBufferingEvent(Jzon::Node* params)
+{
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("adaptive")) {
+        return false;
+    }
+
+    return setAdaptiveBuffering(params->Get("adaptive").ToBool());
+}
+
+bool AudioMixer::configMeteringEvent(Jzon::Node* params)
+{
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("skipSilent")) {
+        return false;
+    }
+
+    return setSkipSilent(params->Get("skipSilent").ToBool());
+}
+
+bool AudioMixer::setSkipSilent(bool enable)
+{
+    skipSilent = enable;
+    return true;
+}
+
+bool AudioMixer::setAdaptiveBuffering(bool enable)
+{
+    adaptiveBuffering = enable;
+
+    for (auto it : inputBuffers) {
+        it.second->setAdaptiveBuffering(enable);
+    }
+
+    return true;
+}
+
 bool AudioMixer::changeChannelGain(int id, float value)
 {
     Jzon::Object root, params;
@@ -443,6 +882,43 @@ bool AudioMixer::changeMasterGain(float value)
     return true;
 }
 
+bool AudioMixer::configBus(int id, int excludedChannel)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configBus");
+    params.Add("id", id);
+    params.Add("exclude", excludedChannel);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool AudioMixer::configBuffering(bool adaptive)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configBuffering");
+    params.Add("adaptive", adaptive);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool AudioMixer::configMetering(bool skipSilent)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configMetering");
+    params.Add("skipSilent", skipSilent);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
 bool AudioMixer::muteMaster()
 {
     Jzon::Object root;
@@ -469,24 +945,70 @@ void AudioMixer::initializeEventMap()
 
     eventMap["muteMaster"] = std::bind(&AudioMixer::muteMasterEvent, this,
                                         std::placeholders::_1);
+
+    eventMap["configBus"] = std::bind(&AudioMixer::configBusEvent, this,
+                                        std::placeholders::_1);
+
+    eventMap["configBuffering"] = std::bind(&AudioMixer::configBufferingEvent, this,
+                                        std::placeholders::_1);
+
+    eventMap["configMetering"] = std::bind(&AudioMixer::configMeteringEvent, this,
+                                        std::placeholders::_1);
 }
 
 void AudioMixer::doGetState(Jzon::Object &filterNode)
 {
     Jzon::Array jsonGains;
+    Jzon::Array jsonBuses;
+    Jzon::Array jsonActivity;
 
     filterNode.Add("channels", channels);
     filterNode.Add("sampleRate", sampleRate);
     filterNode.Add("sampleFormat", utils::getSampleFormatAsString(sampleFormat));
     filterNode.Add("maxChannels", maxMixingChannels);
     filterNode.Add("masterGain", masterGain);
+    filterNode.Add("adaptiveBuffering", adaptiveBuffering);
+    filterNode.Add("skipSilent", skipSilent);
 
     for (auto it : gains) {
         Jzon::Object gain;
         gain.Add("id", it.first);
         gain.Add("gain", it.second);
+
+        if (inputBuffers.count(it.first) > 0) {
+            gain.Add("jitter", (int) inputBuffers[it.first]->getJitter().count());
+            gain.Add("bufferDepth", (int) inputBuffers[it.first]->getTargetDepth().count());
+        }
+
+        if (meters.count(it.first) > 0) {
+            gain.Add("rms", meters[it.first].rms);
+            gain.Add("peak", meters[it.first].peak);
+            gain.Add("active", meters[it.first].active);
+        }
+
         jsonGains.Add(gain);
     }
 
     filterNode.Add("gains", jsonGains);
+
+    for (auto it : buses) {
+        Jzon::Object bus;
+        bus.Add("id", it.first);
+        bus.Add("exclude", it.second);
+        jsonBuses.Add(bus);
+    }
+
+    filterNode.Add("buses", jsonBuses);
+
+    for (auto it : activityEvents) {
+        Jzon::Object activity;
+        activity.Add("seq", (int) it.seq);
+        activity.Add("id", it.id);
+        activity.Add("active", it.active);
+        //Epoch based timestamps do not fit in an int, so they are reported as a string
+        activity.Add("ts", std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(it.ts).count()));
+        jsonActivity.Add(activity);
+    }
+
+    filterNode.Add("activity", jsonActivity);
 }
\ No newline at end of file
@@ -26,17 +26,96 @@
 #include "../../Frame.hh"
 #include "../../Filter.hh"
 #include "../../AudioFrame.hh"
+#include "../../AudioCircularBuffer.hh"
 
-#define COMPRESSION_THRESHOLD 0.6
+#include <vector>
+#include <deque>
+
+#define LIMITER_THRESHOLD 0.9 //peak level kept by the output limiter
+#define LIMITER_LOOKAHEAD 2 //ms
+#define LIMITER_RELEASE 50 //ms, gain recovery time constant
 #define DEFAULT_MASTER_GAIN 0.6
 #define DEFAULT_CHANNEL_GAIN 1.0
 #define AMIXER_MAX_CHANNELS 16
+#define NO_EXCLUDED_CHANNEL -1
+#define METER_FLOOR -100.0 //dBFS, reported for digital silence
+#define VAD_MIN_LEVEL -50.0 //dBFS
+#define VAD_NOISE_MARGIN 9.0 //dB over the noise floor
+#define VAD_HANGOVER 300 //ms
+#define NOISE_FLOOR_RISE 3.0 //dB per second
+#define MAX_ACTIVITY_EVENTS 32
+
+/*! Input level of a mixing channel, measured before applying its gain. Voice
+    activity is detected when the level exceeds the tracked noise floor by
+    VAD_NOISE_MARGIN, and it is held for VAD_HANGOVER after the last voiced frame
+*/
+struct ChannelMeter {
+    float rms;          //dBFS
+    float peak;         //dBFS
+    float noiseFloor;   //dBFS
+    bool active;
+    bool measured;
+    std::chrono::microseconds hangover;
+};
+
+/*! Look-ahead peak limiter. The gain needed by the loudest channel is known LIMITER_LOOKAHEAD
+    in advance, so that the gain ramps down (attack) before a peak is output instead of clipping
+    it, and it recovers exponentially (release) afterwards. All the channels share the same gain
+*/
+class LookaheadLimiter {
+
+public:
+    LookaheadLimiter();
+
+    /**
+    * Configures the limiter and resets its gain
+    * @param sampleRate sample rate in Hz
+    * @param threshold maximum output peak level
+    */
+    void config(unsigned sampleRate, float threshold);
+
+    /**
+    * Limits a block of planar samples in place
+    * @param planes channel planes, holding nOfSamples followed by the look-ahead samples
+    * @param channels number of planes
+    * @param nOfSamples samples to limit
+    * @param ahead samples available after nOfSamples, only getLookahead() of them are used
+    */
+    void process(float* const* planes, unsigned channels, unsigned nOfSamples, unsigned ahead);
+
+    unsigned getLookahead() {return lookahead;};
+    float getGain() {return gain;};
+
+private:
+    unsigned lookahead;
+    float threshold;
+    float attackStep;
+    float release;
+    float gain;
+    std::vector<float> envelope;
+};
+
+/*! Voice activity change of a mixing channel. Changes are numbered, so that
+    state pollers can follow them without missing or repeating any. The state reports
+    their timestamps in ms, as strings
+*/
+struct ActivityEvent {
+    size_t seq;
+    int id;
+    bool active;
+    std::chrono::microseconds ts;
+};
 
 /*! Filter that mixes different audio frames in one frame. Each mixing channel is 
 *   identified by and Id which coincides with the reader associated to it. 
+*   Each output (bus) is identified by its writer Id. By default a bus outputs the 
+*   whole mix, but it can be configured as a mix-minus of one channel, which is 
+*   obtained by subtracting the channel contribution from the common mix.
+*   Input levels and voice activity are measured while mixing, and channels
+*   without voice activity can optionally be left out of the mix.
 */
 
-class AudioMixer : public ManyToOneFilter {
+class AudioMixer : public ManyToManyFilter {
 
 public:
     /**
@@ -68,6 +147,26 @@ public:
     */ 
     static bool floatToBytes(unsigned char* dst, float const origin, SampleFmt fmt);
 
+    /**
+    * It converts a block of samples from its bytes representation to its float representation
+    * @param origin (in) Pointer to the first sample bytes
+    * @param dst (out) Float buffer, at least nOfSamples long
+    * @param nOfSamples (in) Number of samples to convert
+    * @param fmt (in) Sample format (only S16P and FLTP are supported)
+    * @return true on success and false if not
+    */
+    static bool bytesToFloat(unsigned char const* origin, float* dst, unsigned nOfSamples, SampleFmt fmt);
+
+    /**
+    * It converts a block of samples from its float representation to its bytes representation
+    * @param dst (out) Pointer to the sample buffer
+    * @param origin (in) Float samples
+    * @param nOfSamples (in) Number of samples to convert
+    * @param fmt (in) Sample format (only S16P and FLTP are supported)
+    * @return true on success and false if not
+    */
+    static bool floatToBytes(unsigned char* dst, float const* origin, unsigned nOfSamples, SampleFmt fmt);
+
     /**
     * @return mixing buffering in samples
     */ 
@@ -113,18 +212,48 @@ public:
     */ 
     bool muteMaster();
 
+    /**
+    * Configures an output bus as a mix-minus
+    * @param id bus id (writer id)
+    * @param excludedChannel channel id removed from this bus mix, NO_EXCLUDED_CHANNEL for the whole mix
+    * @return always true
+    */ 
+    bool configBus(int id, int excludedChannel = NO_EXCLUDED_CHANNEL);
+
+    /**
+    * Configures the input buffering of all the mixing channels
+    * @param adaptive true to adapt each channel buffering to its jitter and compensate its clock drift
+    * @return always true
+    */ 
+    bool configBuffering(bool adaptive);
+
+    /**
+    * Configures the mixing of silent channels
+    * @param skipSilent true to leave channels without voice activity out of the mix
+    * @return always true
+    */ 
+    bool configMetering(bool skipSilent);
+
 protected:
     
     void doGetState(Jzon::Object &filterNode);
     FrameQueue *allocQueue(ConnectionData cData);
-    bool doProcessFrame(std::map<int, Frame*> &orgFrames, Frame *dst, std::vector<int> newFrames);
+    bool doProcessFrame(std::map<int, Frame*> &orgFrames, std::map<int, Frame*> &dstFrames, std::vector<int> newFrames);
+    bool setBusExclusion(int id, int excludedChannel);
+    bool setAdaptiveBuffering(bool enable);
+    bool setSkipSilent(bool enable);
 
 private:
     void initializeEventMap();
     bool pushToBuffer(int mixChId, AudioFrame* frame);
     bool fillChannel(std::queue<float> &buffer, int nOfSamples, unsigned char* data, SampleFmt fmt); 
-    bool extractMixedFrame(AudioFrame* frame);
-    void mixSample(float sample, float* mixBuff, int bufferIdx, float gain);
+    bool extractMixedFrames(std::map<int, Frame*> &dstFrames);
+    bool fillBusFrame(AudioFrame* frame, int busId, unsigned pos, unsigned ahead);
+    void updateContributions();
+    void mixSamples(float const* samples, float* mixBuff, unsigned nOfSamples, float gain);
+    void measureSamples(float const* samples, unsigned nOfSamples, float &sumSq, float &peak);
+    bool isVoiced(ChannelMeter const& meter, float power);
+    void updateMeter(int mixChId, float power, float peak, unsigned nOfSamples, std::chrono::microseconds ts);
     bool setChannelGain(int id, float value);
     
     bool specificReaderConfig(int readerID, FrameQueue* queue);
@@ -135,10 +264,12 @@ private:
     bool soloChannelEvent(Jzon::Node* params);
     bool changeMasterVolumeEvent(Jzon::Node* params);
     bool muteMasterEvent(Jzon::Node* params);
+    bool configBusEvent(Jzon::Node* params);
+    bool configBufferingEvent(Jzon::Node* params);
+    bool configMeteringEvent(Jzon::Node* params);
     
-    //NOTE: There is no need of specific writer configuration
-    bool specificWriterConfig(int /*writerID*/) {return true;};
-    bool specificWriterDelete(int /*writerID*/) {return true;};
+    bool specificWriterConfig(int writerID);
+    bool specificWriterDelete(int writerID);
 
     int channels;
     int sampleRate;
@@ -149,16 +280,28 @@ private:
     unsigned rear;
 
     float masterGain;
-    float th;  //Dynamic Range Compression algorithm threshold
+    float th;  //Output limiter threshold
 
     std::map<int, float> gains;
+    std::map<int, AudioCircularBuffer*> inputBuffers;
+    std::map<int, ChannelMeter> meters;
+    std::deque<ActivityEvent> activityEvents;
+    size_t activitySeq;
+    std::map<int, int> buses;
+    std::map<int, LookaheadLimiter> limiters;
+    //Gained samples of the excluded channels, planes of mixBufferMaxSamples samples
+    std::map<int, std::vector<float>> contributions;
     std::chrono::microseconds syncTs;
     float* mixBuffers[MAX_CHANNELS];
+    float* convBuffer;
+    //Bus planes of outputSamples plus the limiter look-ahead
+    float* busBuffers[MAX_CHANNELS];
 
     unsigned mixBufferMaxSamples;
     unsigned outputSamples;
     unsigned mixingThreshold;
-
+    bool adaptiveBuffering;
+    bool skipSilent;
 
 };
 
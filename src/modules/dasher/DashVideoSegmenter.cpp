@@ -129,6 +129,7 @@ bool DashVideoSegmenter::appendFrameToDashSegment(DashSegment* segment, Frame* f
 {
     size_t addSampleReturn;
     size_t timeBasePts;
+    size_t timeBaseDts;
 
     if (!frame || !frame->getDataBuf() || frame->getLength() <= 0 || !dashContext) {
         utils::errorMsg("Error appeding frame to segment: frame not valid");
@@ -140,9 +141,10 @@ bool DashVideoSegmenter::appendFrameToDashSegment(DashSegment* segment, Frame* f
     }
 
     timeBasePts = microsToTimeBase(frame->getPresentationTime());
+    timeBaseDts = microsToTimeBase(frame->getDecodeTime());
 
     addSampleReturn = add_video_sample(frame->getDataBuf(), frame->getLength(), timeBasePts, 
-                                        timeBasePts, sequenceNumber, isPreviousFrameIntra(), &dashContext);
+                                        timeBaseDts, sequenceNumber, isPreviousFrameIntra(), &dashContext);
 
     if (addSampleReturn != I2OK) {
         utils::errorMsg("Error adding video sample. Code error: " + std::to_string(addSampleReturn));
@@ -153,8 +155,14 @@ bool DashVideoSegmenter::appendFrameToDashSegment(DashSegment* segment, Frame* f
 }
 
 bool DashVideoSegmenter::appendNalToFrame(VideoFrame* frame, unsigned char* nalData, unsigned nalDataLength, 
-                                           unsigned nalWidth, unsigned nalHeight, std::chrono::microseconds ts)
+                                           unsigned nalWidth, unsigned nalHeight, std::chrono::microseconds ts, 
+                                           std::chrono::microseconds dts)
 {
+    if (dts != ts) {
+        utils::errorMsg("[DashVideoSegmenter::appendNalToFrame] Reordered frames are not supported, encode without B-frames");
+        return false;
+    }
+
     if (frame->getLength() + nalDataLength + AVCC_HEADER_BYTES_MINUS_ONE + 1 > frame->getMaxLength()) {
         utils::errorMsg("[DashVideoSegmenter::appendNalToFrame] Nal exceeds frame max length");
         return false;
@@ -171,6 +179,7 @@ bool DashVideoSegmenter::appendNalToFrame(VideoFrame* frame, unsigned char* nalD
     
     frame->setSize(nalWidth, nalHeight);
     frame->setPresentationTime(ts);
+    frame->setDecodeTime(dts);
     return true;
 }
 
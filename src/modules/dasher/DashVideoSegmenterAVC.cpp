@@ -116,7 +116,8 @@ VideoFrame* DashVideoSegmenterAVC::parseNal(VideoFrame* nal)
     }
 
     if ((nalType == IDR || nalType == NON_IDR) &&
-        !appendNalToFrame(tmpFrame, nalData, nalDataLength, nal->getWidth(), nal->getHeight(), nal->getPresentationTime())) { 
+        !appendNalToFrame(tmpFrame, nalData, nalDataLength, nal->getWidth(), nal->getHeight(), 
+                          nal->getPresentationTime(), nal->getDecodeTime())) { 
         utils::errorMsg("[DashVideoSegmenterHEVC::parseNal] Error appending NAL to frame");
     }
 
@@ -127,7 +127,8 @@ VideoFrame* DashVideoSegmenterHEVC::parseNal(VideoFrame* nal)
 
     if ((nalType == IDR1 || nalType == IDR2 || nalType == CRA 
         || nalType == NON_TSA_STSA_0 || nalType == NON_TSA_STSA_1) && 
-        !appendNalToFrame(tmpFrame, nalData, nalDataLength, nal->getWidth(), nal->getHeight(), nal->getPresentationTime())) {
+        !appendNalToFrame(tmpFrame, nalData, nalDataLength, nal->getWidth(), nal->getHeight(), 
+                          nal->getPresentationTime(), nal->getDecodeTime())) {
         utils::errorMsg("[DashVideoSegmenterHEVC::parseNal] Error appending NAL to frame");
     }
 
@@ -0,0 +1,384 @@
+/*
+ *  FrameRateConverter - Video frame rate converter
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "FrameRateConverter.hh"
+#include "../../AVFramedQueue.hh"
+#include "../../Utils.hh"
+
+#include <cstring>
+
+FrameRateMode getFrameRateModeFromString(std::string mode)
+{
+    if (mode.compare("drop") == 0) {
+        return DROP;
+    } else if (mode.compare("blend") == 0) {
+        return BLEND;
+    }
+
+    return FRM_NONE;
+}
+
+std::string getFrameRateModeAsString(FrameRateMode mode)
+{
+    switch (mode) {
+        case DROP:
+            return "drop";
+        case BLEND:
+            return "blend";
+        default:
+            return "";
+    }
+}
+
+FrameRateConverter* FrameRateConverter::createNew(unsigned fps, FrameRateMode mode)
+{
+    if (fps == 0 || fps > MAX_FPS || mode == FRM_NONE) {
+        utils::errorMsg("[FrameRateConverter] Error creating FrameRateConverter, invalid frame rate or mode");
+        return NULL;
+    }
+
+    return new FrameRateConverter(fps, mode);
+}
+
+FrameRateConverter::FrameRateConverter(unsigned fps, FrameRateMode mode) : OneToOneFilter()
+{
+    fType = FRAME_RATE_CONVERTER;
+
+    this->fps = fps;
+    this->mode = mode;
+
+    baseTs = std::chrono::microseconds(0);
+    lastTs = std::chrono::microseconds(0);
+    nextSlot = 0;
+    synced = false;
+
+    prevWidth = 0;
+    prevHeight = 0;
+    prevPixFmt = P_NONE;
+
+    seqNum = 0;
+    dropped = 0;
+    repeated = 0;
+
+    outputStreamInfo = new StreamInfo(VIDEO);
+    outputStreamInfo->video.codec = RAW;
+    outputStreamInfo->video.pixelFormat = YUV420P;
+
+    initializeEventMap();
+}
+
+FrameRateConverter::~FrameRateConverter()
+{
+    delete outputStreamInfo;
+}
+
+bool FrameRateConverter::configure(unsigned fps, FrameRateMode mode)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("fps", (int) fps);
+    params.Add("mode", getFrameRateModeAsString(mode));
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+FrameQueue* FrameRateConverter::allocQueue(ConnectionData cData)
+{
+    return VideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_RAW_VIDEO_FRAMES);
+}
+
+bool FrameRateConverter::specificReaderConfig(int /*readerID*/, FrameQueue* queue)
+{
+    const StreamInfo *si = queue->getStreamInfo();
+
+    if (!si || si->type != VIDEO || si->video.codec != RAW) {
+        utils::errorMsg("[FrameRateConverter] Input stream must be raw video");
+        return false;
+    }
+
+    //Frames are not transformed, so the output describes the input stream
+    outputStreamInfo->video.pixelFormat = si->video.pixelFormat;
+    outputStreamInfo->video.width = si->video.width;
+    outputStreamInfo->video.height = si->video.height;
+    return true;
+}
+
+std::chrono::microseconds FrameRateConverter::slotTime(size_t slot)
+{
+    //Computed from the cadence origin so that rounding errors are not accumulated
+    return baseTs + std::chrono::microseconds((slot * std::micro::den) / fps);
+}
+
+bool FrameRateConverter::doProcessFrame(Frame *oFrame, Frame *dFrame)
+{
+    std::vector<std::chrono::microseconds> slots;
+    std::chrono::microseconds ts, limit;
+    InterleavedVideoFrame *org;
+    InterleavedVideoFrame *dst;
+    bool filled;
+
+    if (!oFrame->getConsumed()) {
+        return false;
+    }
+
+    org = dynamic_cast<InterleavedVideoFrame*>(oFrame);
+    dst = dynamic_cast<InterleavedVideoFrame*>(dFrame);
+
+    if (!org || !dst) {
+        utils::errorMsg("[FrameRateConverter] Only raw interleaved video frames are supported");
+        return false;
+    }
+
+    ts = org->getPresentationTime();
+
+    //Start (or restart after a discontinuity) the output cadence at this frame
+    if (!synced || ts < lastTs ||
+        ts > slotTime(nextSlot + MAX_REPEATED_FRAMES)) {
+        baseTs = ts;
+        lastTs = ts;
+        nextSlot = 0;
+        synced = true;
+    }
+
+    if (mode == BLEND) {
+        //Slots are interpolated, so they can only be produced up to this frame
+        limit = ts;
+    } else {
+        //Each slot takes the nearest frame, assuming the next one comes after the same period
+        limit = ts + (ts - lastTs) / 2;
+    }
+
+    //Ties go to the next frame
+    while (slotTime(nextSlot) <= ts || slotTime(nextSlot) < limit) {
+        slots.push_back(slotTime(nextSlot));
+        nextSlot++;
+    }
+
+    if (slots.empty()) {
+        dropped++;
+    } else {
+        repeated += slots.size() - 1;
+    }
+
+    for (size_t i = 0; i < slots.size(); i++) {
+        //Each repeated frame is written to a new destination frame, the last one is added by the base filter
+        if (i > 0 && (dst = dynamic_cast<InterleavedVideoFrame*>(nextDestinationFrame())) == NULL) {
+            break;
+        }
+
+        if (mode == BLEND) {
+            filled = blendFrame(org, dst, slots[i]);
+        } else {
+            filled = fillFrame(org, dst, slots[i]);
+        }
+
+        dst->setConsumed(filled);
+
+        if (!filled) {
+            break;
+        }
+
+        dst->setOriginTime(org->getOriginTime());
+        dst->setSequenceNumber(seqNum++);
+    }
+
+    if (mode == BLEND) {
+        keepPrevious(org);
+    }
+
+    lastTs = ts;
+
+    return !slots.empty();
+}
+
+bool FrameRateConverter::fillFrame(InterleavedVideoFrame *org, InterleavedVideoFrame *dst, std::chrono::microseconds ts)
+{
+    unsigned char *planes[MAX_PLANES];
+    int strides[MAX_PLANES];
+
+    //Frames are published as views of the origin buffer, so dropping or repeating them costs no copy
+    if (org->isPlanarView()) {
+        org->getPlanes(planes, strides);
+        dst->setPlanarView(org->getSharedBuf(), planes, strides);
+    } else {
+        dst->setView(org->getSharedBuf(), org->getDataBuf(), org->getStride());
+    }
+
+    dst->setLength(org->getLength());
+    dst->setSize(org->getWidth(), org->getHeight());
+    dst->setPixelFormat(org->getPixelFormat());
+    dst->setPresentationTime(ts);
+    return true;
+}
+
+bool FrameRateConverter::blendFrame(InterleavedVideoFrame *org, InterleavedVideoFrame *dst, std::chrono::microseconds ts)
+{
+    std::chrono::microseconds prevTs;
+    unsigned char *orgPlanes[MAX_PLANES], *dstPlanes[MAX_PLANES];
+    int orgStrides[MAX_PLANES], dstStrides[MAX_PLANES];
+    int rowBytes[MAX_PLANES], rows[MAX_PLANES];
+    unsigned char *orgBuff, *prevBuff, *dstBuff;
+    unsigned weight;
+    size_t length;
+    int nPlanes;
+
+    prevTs = lastTs;
+    nPlanes = org->getPlaneSizes(rowBytes, rows);
+    length = planesLength(rowBytes, rows, nPlanes);
+
+    if (ts >= org->getPresentationTime() || ts <= prevTs || prevFrame.empty() ||
+        prevWidth != org->getWidth() || prevHeight != org->getHeight() ||
+        prevPixFmt != org->getPixelFormat() || prevFrame.size() != length ||
+        org->getPlanes(orgPlanes, orgStrides) != nPlanes) {
+        return fillFrame(org, dst, ts);
+    }
+
+    if (dst->getMaxLength() < length) {
+        utils::errorMsg("[FrameRateConverter] Destination frame too small to blend");
+        return false;
+    }
+
+    //The destination may still be a view published by a previous call. Its planes are packed
+    dst->detachBuffer();
+    dst->setStride(0);
+    dst->setSize(org->getWidth(), org->getHeight());
+    dst->setPixelFormat(org->getPixelFormat());
+    dst->getPlanes(dstPlanes, dstStrides);
+
+    //Weight of the current frame, in 1/256 units
+    weight = ((ts - prevTs).count() * 256) / (org->getPresentationTime() - prevTs).count();
+
+    //Planes may have their own strides (e.g. planar views of decoder buffers)
+    prevBuff = prevFrame.data();
+    for (int p = 0; p < nPlanes; p++) {
+        for (int y = 0; y < rows[p]; y++) {
+            orgBuff = orgPlanes[p] + y * orgStrides[p];
+            dstBuff = dstPlanes[p] + y * dstStrides[p];
+            for (int x = 0; x < rowBytes[p]; x++) {
+                dstBuff[x] = (prevBuff[x] * (256 - weight) + orgBuff[x] * weight) >> 8;
+            }
+            prevBuff += rowBytes[p];
+        }
+    }
+
+    dst->setLength(length);
+    dst->setPresentationTime(ts);
+    return true;
+}
+
+void FrameRateConverter::keepPrevious(InterleavedVideoFrame *org)
+{
+    unsigned char *planes[MAX_PLANES];
+    int strides[MAX_PLANES];
+    int rowBytes[MAX_PLANES], rows[MAX_PLANES];
+    unsigned char *prevBuff;
+    int nPlanes;
+
+    nPlanes = org->getPlaneSizes(rowBytes, rows);
+
+    //Frames that cannot be blended are filled instead
+    if (nPlanes <= 0 || org->getPlanes(planes, strides) != nPlanes) {
+        prevFrame.clear();
+        return;
+    }
+
+    prevFrame.resize(planesLength(rowBytes, rows, nPlanes));
+    prevWidth = org->getWidth();
+    prevHeight = org->getHeight();
+    prevPixFmt = org->getPixelFormat();
+
+    //Kept packed, plane after plane
+    prevBuff = prevFrame.data();
+    for (int p = 0; p < nPlanes; p++) {
+        for (int y = 0; y < rows[p]; y++) {
+            memcpy(prevBuff, planes[p] + y * strides[p], rowBytes[p]);
+            prevBuff += rowBytes[p];
+        }
+    }
+}
+
+size_t FrameRateConverter::planesLength(int *rowBytes, int *rows, int nPlanes)
+{
+    size_t length = 0;
+
+    for (int p = 0; p < nPlanes; p++) {
+        length += (size_t) rowBytes[p] * rows[p];
+    }
+
+    return length;
+}
+
+void FrameRateConverter::doGetState(Jzon::Object &filterNode)
+{
+    filterNode.Add("fps", (int) fps);
+    filterNode.Add("mode", getFrameRateModeAsString(mode));
+    filterNode.Add("dropped", (int) dropped);
+    filterNode.Add("repeated", (int) repeated);
+}
+
+bool FrameRateConverter::configure0(unsigned fps, FrameRateMode mode)
+{
+    if (fps == 0 || fps > MAX_FPS || mode == FRM_NONE) {
+        utils::errorMsg("[FrameRateConverter] Error configuring. Invalid frame rate or mode");
+        return false;
+    }
+
+    this->fps = fps;
+    this->mode = mode;
+
+    //The new cadence starts at the next frame
+    synced = false;
+    prevFrame.clear();
+
+    return true;
+}
+
+void FrameRateConverter::initializeEventMap()
+{
+    eventMap["configure"] = std::bind(&FrameRateConverter::configEvent, this, std::placeholders::_1);
+}
+
+bool FrameRateConverter::configEvent(Jzon::Node* params)
+{
+    int newFps = fps;
+    FrameRateMode newMode = mode;
+
+    if (!params) {
+        return false;
+    }
+
+    if (params->Has("fps")) {
+        newFps = params->Get("fps").ToInt();
+        if (newFps <= 0) {
+            return false;
+        }
+    }
+
+    if (params->Has("mode")) {
+        newMode = getFrameRateModeFromString(params->Get("mode").ToString());
+    }
+
+    return configure0(newFps, newMode);
+}
@@ -0,0 +1,113 @@
+/*
+ *  FrameRateConverter - Video frame rate converter
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _FRAME_RATE_CONVERTER_HH
+#define _FRAME_RATE_CONVERTER_HH
+
+#include "../../VideoFrame.hh"
+#include "../../Filter.hh"
+#include "../../StreamInfo.hh"
+
+#include <vector>
+
+#define MAX_FPS 240
+#define MAX_REPEATED_FRAMES 8
+
+/**
+* Frame rate conversion modes
+* DROP: each output slot takes the nearest input frame, dropping or repeating frames
+* BLEND: each output slot is interpolated from the two input frames surrounding it
+*/
+enum FrameRateMode {FRM_NONE = -1, DROP, BLEND};
+
+FrameRateMode getFrameRateModeFromString(std::string mode);
+std::string getFrameRateModeAsString(FrameRateMode mode);
+
+/*! Converts a raw video stream to a constant frame rate. Output presentation times are
+    realigned to the output cadence, so following filters (e.g. encoders) see a steady
+    frame period regardless of the input rate or its jitter
+*/
+class FrameRateConverter : public OneToOneFilter {
+
+    public:
+        /**
+        * Creates a new frame rate converter
+        * @param fps output frame rate
+        * @param mode conversion mode
+        * @return Pointer to new object if succeed of NULL if not
+        */
+        static FrameRateConverter* createNew(unsigned fps = VIDEO_DEFAULT_FRAMERATE, FrameRateMode mode = DROP);
+
+        /**
+        * Class destructor
+        */
+        ~FrameRateConverter();
+
+        /**
+        * Configures the converter
+        * @param fps output frame rate
+        * @param mode conversion mode
+        */
+        bool configure(unsigned fps, FrameRateMode mode = DROP);
+
+    protected:
+        FrameRateConverter(unsigned fps, FrameRateMode mode);
+        FrameQueue *allocQueue(ConnectionData cData);
+        bool doProcessFrame(Frame *org, Frame *dst);
+        void doGetState(Jzon::Object &filterNode);
+        bool configure0(unsigned fps, FrameRateMode mode);
+        bool specificReaderConfig(int readerID, FrameQueue* queue);
+
+    private:
+        void initializeEventMap();
+        bool configEvent(Jzon::Node* params);
+        std::chrono::microseconds slotTime(size_t slot);
+        bool fillFrame(InterleavedVideoFrame *org, InterleavedVideoFrame *dst, std::chrono::microseconds ts);
+        bool blendFrame(InterleavedVideoFrame *org, InterleavedVideoFrame *dst, std::chrono::microseconds ts);
+        void keepPrevious(InterleavedVideoFrame *org);
+        size_t planesLength(int *rowBytes, int *rows, int nPlanes);
+
+        //NOTE: There is no need of specific reader delete or writer configuration
+        bool specificReaderDelete(int /*readerID*/) {return true;};
+        bool specificWriterConfig(int /*writerID*/) {return true;};
+        bool specificWriterDelete(int /*writerID*/) {return true;};
+
+        StreamInfo *outputStreamInfo;
+
+        unsigned fps;
+        FrameRateMode mode;
+
+        std::chrono::microseconds baseTs;
+        std::chrono::microseconds lastTs;
+        size_t nextSlot;
+        bool synced;
+
+        std::vector<unsigned char> prevFrame;
+        int prevWidth, prevHeight;
+        PixType prevPixFmt;
+
+        size_t seqNum;
+        size_t dropped;
+        size_t repeated;
+};
+
+#endif
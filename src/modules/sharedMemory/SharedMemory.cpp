@@ -120,7 +120,8 @@ bool SharedMemory::doProcessFrame(Frame *org, Frame *dst)
             break;
         case RAW:
             writeFramePayload(vframe);
-            writeSharedMemoryRAW(vframe->getDataBuf(), vframe->getLength());
+            writeSharedMemoryRAW(vframe->getDataBuf(), vframe->getLength(),
+                    vframe->getStride(), vframe->getHeight());
             break;
         default:
             utils::errorMsg("SharedMemory::error - only RAW and H264 frames are shareable");
@@ -270,11 +271,19 @@ bool SharedMemory::appendNalToFrame(unsigned char* nalData, unsigned nalDataLeng
     return true;
 }
 
-int SharedMemory::writeSharedMemoryRAW(uint8_t *buf, int buf_size)
+int SharedMemory::writeSharedMemoryRAW(uint8_t *buf, int buf_size, int stride, int lines)
 {
+    int lineSize;
 
     *access = CHAR_WRITING;
-    memcpy(buffer, buf, sizeof(uint8_t) * buf_size);
+    if (stride > 0 && lines > 0) {
+        lineSize = buf_size / lines;
+        for (int i = 0; i < lines; i++) {
+            memcpy(buffer + i * lineSize, buf + i * stride, sizeof(uint8_t) * lineSize);
+        }
+    } else {
+        memcpy(buffer, buf, sizeof(uint8_t) * buf_size);
+    }
     *access = CHAR_READING;
 
     return 0;
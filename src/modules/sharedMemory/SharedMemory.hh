@@ -87,7 +87,7 @@ protected:
     bool appendNalToFrame(unsigned char* nalData, unsigned nalDataLength, int startCodeOffset, bool &newFrame);
     bool parseNal(VideoFrame* nal, bool &newFrame);
     int detectStartCode(unsigned char const* ptr);
-    int writeSharedMemoryRAW(uint8_t *buffer, int buffer_size);
+    int writeSharedMemoryRAW(uint8_t *buffer, int buffer_size, int stride = 0, int lines = 0);
     void writeFramePayload(InterleavedVideoFrame *frame);
     bool isWritable();
     uint16_t getSeqNum() { return seqNum;};
@@ -23,6 +23,7 @@
 
 #include "Connection.hh"
 #include "Utils.hh"
+#include "RateController.hh"
 #include "UltraGridAudioRTPSink.hh"
 #include "UltraGridVideoRTPSink.hh"
 #include "H264VideoStreamSampler.hh"
@@ -735,7 +736,7 @@ ConnRTCPInstance::ConnRTCPInstance(Connection* conn, UsageEnvironment* env, Grou
     packetLossRatio(0), minPacketLossRatio(100), maxPacketLossRatio(0),
     avgBitrate(0), minBitrate(1000000), maxBitrate(0),
     roundTripDelay(0), minRoundTripDelay(1000000), maxRoundTripDelay(0),
-    jitter(0), minJitter(1000000), maxJitter(0)
+    jitter(0), minJitter(1000000), maxJitter(0), measurements(0)
 {
     struct timeval startTime;
     gettimeofday(&startTime, NULL);
@@ -787,11 +788,13 @@ void ConnRTCPInstance::periodicStatMeasurement(struct timeval const& timeNow)
     RTPTransmissionStats* stats;
     while((stats = statsIter.next()) != NULL){
         SSRC = stats->SSRC();
-        packetLossRatio = stats->packetLossRatio();
+        //Receiver reports carry the fraction lost in 1/256 units
+        packetLossRatio = RateController::lossPercentage(stats->packetLossRatio());
         if(minPacketLossRatio > packetLossRatio) minPacketLossRatio = packetLossRatio;
         if(maxPacketLossRatio < packetLossRatio) maxPacketLossRatio = packetLossRatio;        
         
-        roundTripDelay = stats->roundTripDelay();
+        //and the round trip delay in 1/65536 seconds units
+        roundTripDelay = RateController::rttMs(stats->roundTripDelay());
         if(minRoundTripDelay > roundTripDelay) minRoundTripDelay = roundTripDelay;
         if(maxRoundTripDelay < roundTripDelay) maxRoundTripDelay = roundTripDelay;
 
@@ -799,4 +802,6 @@ void ConnRTCPInstance::periodicStatMeasurement(struct timeval const& timeNow)
         if(minJitter > jitter) minJitter = jitter;
         if(maxJitter < jitter) maxJitter = jitter;
     }
+
+    measurements++;
 }
@@ -415,7 +415,7 @@ public:
     u_int32_t getSSRC() { return SSRC; };
 
     /**
-    * Returns current packet loss ratio in percentage
+    * Returns current packet loss ratio in percentage, converted from the receiver report fraction lost
     */    
     u_int8_t getPacketLossRatio() { return packetLossRatio; };
     /**
@@ -441,7 +441,7 @@ public:
     size_t getMaxBitrate() { return maxBitrate; };
 
     /**
-    * Returns the round trip delay in milliseconds
+    * Returns the round trip delay in milliseconds, converted from the RTCP 1/65536 seconds units
     */  
     size_t getRoundTripDelay() { return roundTripDelay; };
     /**
@@ -466,6 +466,11 @@ public:
     */  
     size_t getMaxJitter() { return maxJitter; };
 
+    /**
+    * Returns the number of stats measurements done, to detect new ones
+    */
+    size_t getMeasurements() { return measurements; };
+
 private:
     ConnRTCPInstance(Connection* conn, UsageEnvironment* env, Groupsock* RTPgs, unsigned totSessionBW,
                         unsigned char const* cname, RTPSink* sink);
@@ -484,6 +489,7 @@ private:
     size_t avgBitrate, minBitrate, maxBitrate;
     size_t roundTripDelay, minRoundTripDelay, maxRoundTripDelay;
     size_t jitter, minJitter, maxJitter;
+    size_t measurements;
 };
 
 #endif
\ No newline at end of file
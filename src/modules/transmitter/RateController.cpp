@@ -0,0 +1,87 @@
+/*
+ *  RateController - Receiver report driven encoder rate controller
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "RateController.hh"
+
+RateController::RateController(unsigned minBitrate_, unsigned maxBitrate_, unsigned maxFps_) :
+minBitrate(minBitrate_), maxBitrate(maxBitrate_), maxFps(maxFps_), bitrate(maxBitrate_),
+reportedBitrate(maxBitrate_), fps(maxFps_), minRtt(0), decreased(false)
+{
+}
+
+bool RateController::update(unsigned lossRatio, size_t rtt, size_t sentBitrate)
+{
+    unsigned prevFps = fps;
+
+    if (rtt > 0 && (minRtt == 0 || rtt < minRtt)) {
+        minRtt = rtt;
+    }
+
+    if (lossRatio > RC_LOSS_HIGH) {
+        bitrate *= 1.0 - 0.5 * std::min(lossRatio, 100U) / 100.0;
+        decreased = true;
+    } else if (minRtt > 0 && rtt > minRtt + RC_RTT_OVERUSE) {
+        //Packets are being queued somewhere in the path, send under the current rate
+        if (sentBitrate > 0) {
+            bitrate = std::min(bitrate, sentBitrate * RC_DELAY_DECREASE_FACTOR);
+        } else {
+            bitrate *= RC_DELAY_DECREASE_FACTOR;
+        }
+        decreased = true;
+    } else if (lossRatio < RC_LOSS_LOW && !decreased) {
+        bitrate *= RC_INCREASE_FACTOR;
+    } else {
+        //Hold one report after a decrease, so that its effect can be measured
+        decreased = false;
+    }
+
+    bitrate = std::max(std::min(bitrate, (double) maxBitrate), (double) minBitrate);
+
+    if (bitrate < maxBitrate * RC_FPS_DOWN_RATIO) {
+        fps = std::max(maxFps / 2, 1U);
+    } else if (bitrate > maxBitrate * RC_FPS_UP_RATIO) {
+        fps = maxFps;
+    }
+
+    //Bounds are always reported, so that the encoder reaches them
+    if (std::fabs(bitrate - reportedBitrate) >= reportedBitrate * RC_MIN_CHANGE ||
+        ((bitrate == minBitrate || bitrate == maxBitrate) && (unsigned) bitrate != reportedBitrate)) {
+        reportedBitrate = bitrate;
+        return true;
+    }
+
+    return fps != prevFps;
+}
+
+unsigned RateController::lossPercentage(unsigned fractionLost)
+{
+    return fractionLost * 100 / 256;
+}
+
+size_t RateController::rttMs(unsigned rtcpRtt)
+{
+    return (size_t) rtcpRtt * 1000 / 65536;
+}
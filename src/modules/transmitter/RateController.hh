@@ -0,0 +1,96 @@
+/*
+ *  RateController - Receiver report driven encoder rate controller
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of liveMediaStreamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#ifndef _RATE_CONTROLLER_HH
+#define _RATE_CONTROLLER_HH
+
+#include <cstddef>
+
+#define RC_LOSS_HIGH 10 //% of lost packets that reduces the bitrate
+#define RC_LOSS_LOW 2 //% of lost packets under which the bitrate can grow
+#define RC_INCREASE_FACTOR 1.08 //per receiver report
+#define RC_DELAY_DECREASE_FACTOR 0.85 //over the sent bitrate
+#define RC_RTT_OVERUSE 100 //ms over the minimum round trip delay
+#define RC_MIN_CHANGE 0.05 //minimum relative bitrate change sent to the encoder
+#define RC_FPS_DOWN_RATIO 0.25 //of the max bitrate, under it the frame rate is halved
+#define RC_FPS_UP_RATIO 0.5 //of the max bitrate, over it the frame rate is restored
+
+/*! Loss based AIMD rate controller, in the spirit of the loss based part of Google
+*   Congestion Control. The bitrate is cut proportionally to the loss ratio when it
+*   exceeds RC_LOSS_HIGH, it is brought under the sent bitrate when the round trip
+*   delay grows (queues are building) and it grows multiplicatively while there are
+*   almost no losses. Under low bitrates the frame rate is halved.
+*/
+class RateController {
+
+public:
+    /**
+    * Class constructor
+    * @param minBitrate lower bitrate bound in kbps
+    * @param maxBitrate upper bitrate bound in kbps, also the starting bitrate
+    * @param maxFps nominal frame rate
+    */
+    RateController(unsigned minBitrate, unsigned maxBitrate, unsigned maxFps);
+
+    /**
+    * Updates the targets with the statistics of a new receiver report
+    * @param lossRatio packet loss ratio in percentage
+    * @param rtt round trip delay in milliseconds
+    * @param sentBitrate sent bitrate in kbps, 0 if unknown
+    * @return true if the targets have changed enough to reconfigure the encoder
+    */
+    bool update(unsigned lossRatio, size_t rtt, size_t sentBitrate);
+
+    /**
+    * Converts the RTCP receiver report fraction lost to a percentage
+    * @param fractionLost lost packets fraction, in 1/256 units
+    * @return packet loss ratio in percentage
+    */
+    static unsigned lossPercentage(unsigned fractionLost);
+
+    /**
+    * Converts a RTCP round trip delay to milliseconds
+    * @param rtcpRtt round trip delay in 1/65536 seconds units
+    * @return round trip delay in milliseconds
+    */
+    static size_t rttMs(unsigned rtcpRtt);
+
+    unsigned getBitrate() {return reportedBitrate;};
+    unsigned getFps() {return fps;};
+    unsigned getMinBitrate() {return minBitrate;};
+    unsigned getMaxBitrate() {return maxBitrate;};
+    unsigned getMaxFps() {return maxFps;};
+
+private:
+    unsigned minBitrate;
+    unsigned maxBitrate;
+    unsigned maxFps;
+
+    double bitrate;
+    unsigned reportedBitrate;
+    unsigned fps;
+    size_t minRtt;
+    bool decreased;
+};
+
+#endif
@@ -22,6 +22,7 @@
  */
 
 
+#include <algorithm>
 #include <GroupsockHelper.hh>
 
 #include "SinkManager.hh"
@@ -79,6 +80,13 @@ SinkManager::~SinkManager()
 
 void SinkManager::stop()
 {
+    std::unique_lock<std::mutex> guard(rcMtx);
+    for (auto it : rateControls) {
+        delete it.second.controller;
+    }
+    rateControls.clear();
+    guard.unlock();
+
     for (auto it : connections) {
        delete it.second;
     }
@@ -135,6 +143,8 @@ bool SinkManager::doProcessFrame(std::map<int, Frame*> &oFrames, std::vector<int
     if (envir() == NULL){
         return false;
     }
+
+    updateRateControls();
     
     int pFrames = 0;
        
@@ -171,6 +181,8 @@ bool SinkManager::removeConnection(int id)
         return false;
     }
     
+    removeRateControl(id);
+
     connection = connections[id];
     connections.erase(id);
     connection->stopPlaying();
@@ -698,6 +710,18 @@ void SinkManager::doGetState(Jzon::Object &filterNode)
 
         jsonConnection.Add("subsessionsStats", jsonSubsessionsStats);
 
+        std::unique_lock<std::mutex> guard(rcMtx);
+        if (rateControls.count(it.first) > 0) {
+            Jzon::Object jsonRateControl;
+            RateController *controller = rateControls[it.first].controller;
+            jsonRateControl.Add("bitrate", (int) controller->getBitrate());
+            jsonRateControl.Add("fps", (int) controller->getFps());
+            jsonRateControl.Add("minBitrate", (int) controller->getMinBitrate());
+            jsonRateControl.Add("maxBitrate", (int) controller->getMaxBitrate());
+            jsonConnection.Add("rateControl", jsonRateControl);
+        }
+        guard.unlock();
+
         for (auto reader : it.second->getReaders()){
             jsonReaders.Add(reader);
         }
@@ -707,3 +731,118 @@ void SinkManager::doGetState(Jzon::Object &filterNode)
 
     filterNode.Add("sessions", connectionArray);
 }
+
+bool SinkManager::setRateControl(int id, BaseFilter* encoder, unsigned minBitrate, unsigned maxBitrate, unsigned maxFps)
+{
+    if (!encoder || minBitrate <= 0 || maxBitrate < minBitrate || maxFps <= 0) {
+        utils::errorMsg("[SinkManager] Error setting rate control. Invalid values");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(rcMtx);
+
+    if (rateControls.count(id) > 0) {
+        delete rateControls[id].controller;
+    }
+
+    rateControls[id].controller = new RateController(minBitrate, maxBitrate, maxFps);
+    rateControls[id].encoder = encoder;
+    rateControls[id].measurements = 0;
+
+    //The loop starts from the upper bound
+    sendRateTargets(encoder, maxBitrate, maxFps, true);
+    return true;
+}
+
+bool SinkManager::removeRateControl(int id)
+{
+    std::lock_guard<std::mutex> guard(rcMtx);
+
+    if (rateControls.count(id) <= 0) {
+        return false;
+    }
+
+    delete rateControls[id].controller;
+    rateControls.erase(id);
+    return true;
+}
+
+void SinkManager::removeRateControls(BaseFilter* encoder)
+{
+    std::lock_guard<std::mutex> guard(rcMtx);
+
+    for (auto it = rateControls.begin(); it != rateControls.end();) {
+        if (it->second.encoder == encoder) {
+            delete it->second.controller;
+            it = rateControls.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SinkManager::updateRateControls()
+{
+    size_t measurements;
+    unsigned lossRatio;
+    size_t rtt;
+    size_t sentBitrate;
+    unsigned prevFps;
+
+    std::lock_guard<std::mutex> guard(rcMtx);
+
+    for (auto &it : rateControls) {
+        if (connections.count(it.first) <= 0) {
+            continue;
+        }
+
+        measurements = 0;
+        lossRatio = 0;
+        rtt = 0;
+        sentBitrate = 0;
+
+        //The encoder is shared by all the receivers, so the worst one drives it
+        for (auto iter : connections[it.first]->getConnectionRTCPInstanceMap()) {
+            measurements += iter.second->getMeasurements();
+            lossRatio = std::max(lossRatio, (unsigned) iter.second->getPacketLossRatio());
+            rtt = std::max(rtt, iter.second->getRoundTripDelay());
+            sentBitrate = std::max(sentBitrate, iter.second->getAvgBitrate());
+        }
+
+        if (measurements == it.second.measurements) {
+            continue;
+        }
+
+        it.second.measurements = measurements;
+        prevFps = it.second.controller->getFps();
+
+        if (it.second.controller->update(lossRatio, rtt, sentBitrate)) {
+            sendRateTargets(it.second.encoder, it.second.controller->getBitrate(),
+                            it.second.controller->getFps(), prevFps != it.second.controller->getFps());
+        }
+    }
+}
+
+void SinkManager::sendRateTargets(BaseFilter* encoder, unsigned bitrate, unsigned fps, bool fpsChanged)
+{
+    Jzon::Object rateRoot, rateParams;
+    rateRoot.Add("action", "configRate");
+    rateParams.Add("bitrate", (int) bitrate);
+    rateRoot.Add("params", rateParams);
+
+    Event rateEvent(rateRoot, std::chrono::system_clock::now(), 0);
+    encoder->pushEvent(rateEvent);
+
+    if (!fpsChanged) {
+        return;
+    }
+
+    //Other encoding parameters are kept by the encoder
+    Jzon::Object fpsRoot, fpsParams;
+    fpsRoot.Add("action", "configure");
+    fpsParams.Add("fps", (int) fps);
+    fpsRoot.Add("params", fpsParams);
+
+    Event fpsEvent(fpsRoot, std::chrono::system_clock::now(), 0);
+    encoder->pushEvent(fpsEvent);
+}
@@ -29,8 +29,10 @@
 #include "../../StreamInfo.hh"
 #include "../../IOInterface.hh"
 #include "Connection.hh"
+#include "RateController.hh"
 
 #include <map>
+#include <mutex>
 #include <string>
 #include <liveMedia/liveMedia.hh>
 #include <BasicUsageEnvironment.hh>
@@ -86,6 +88,31 @@ public:
 
     std::map<int, Connection*> getConnections(){ return connections; };   
 
+    /**
+    * Closes the rate control loop of a connection. The receiver reports of the connection
+    * drive the bitrate and frame rate of the encoder through its configRate and configure events
+    * @param id Connection Id
+    * @param encoder Filter that encodes the connection stream
+    * @param minBitrate lower bitrate bound in kbps
+    * @param maxBitrate upper bitrate bound in kbps
+    * @param maxFps nominal frame rate
+    * @return True if succeded and false if not
+    */
+    bool setRateControl(int id, BaseFilter* encoder, unsigned minBitrate, unsigned maxBitrate, unsigned maxFps);
+
+    /**
+    * Opens the rate control loop of a connection
+    * @param id Connection Id
+    * @return True if the connection had a rate control loop
+    */
+    bool removeRateControl(int id);
+
+    /**
+    * Opens the rate control loops driving an encoder, which must be done before deleting it
+    * @param encoder Filter driven by the loops
+    */
+    void removeRateControls(BaseFilter* encoder);
+
     UsageEnvironment* envir() {return env;}
 
 private:
@@ -113,6 +140,9 @@ private:
 
     bool addSubsessionByReader(RTSPConnection* connection, int readerId);
 
+    void updateRateControls();
+    void sendRateTargets(BaseFilter* encoder, unsigned bitrate, unsigned fps, bool fpsChanged);
+
     bool createVideoQueueSource(const StreamInfo *si, int readerId);
     bool createAudioQueueSource(const StreamInfo *si, int readerId);
     void doGetState(Jzon::Object &filterNode);
@@ -121,6 +151,15 @@ private:
     std::map<int, QueueSource*> sources;
     std::map<int, Connection*> connections;
 
+    struct RateControl {
+        RateController *controller;
+        BaseFilter *encoder;
+        size_t measurements;
+    };
+
+    std::mutex rcMtx;
+    std::map<int, RateControl> rateControls;
+
     RTSPServer* rtspServer;
     UsageEnvironment* env;
     BasicTaskScheduler0* scheduler;
@@ -0,0 +1,63 @@
+/*
+ *  EncoderBackend - Video encoder library interface for VideoEncoderPlugin
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "EncoderBackend.hh"
+#include "VP8EncoderBackend.hh"
+
+std::map<std::string, std::function<EncoderBackend*()>>& EncoderBackend::getRegistry()
+{
+    static std::map<std::string, std::function<EncoderBackend*()>> registry = {
+        {"vp8", [](){return new VP8EncoderBackend();}}
+    };
+
+    return registry;
+}
+
+EncoderBackend* EncoderBackend::createNew(std::string name)
+{
+    if (getRegistry().count(name) <= 0) {
+        return NULL;
+    }
+
+    return getRegistry()[name]();
+}
+
+bool EncoderBackend::registerBackend(std::string name, std::function<EncoderBackend*()> factory)
+{
+    if (name.empty() || !factory || getRegistry().count(name) > 0) {
+        return false;
+    }
+
+    getRegistry()[name] = factory;
+    return true;
+}
+
+std::vector<std::string> EncoderBackend::getBackends()
+{
+    std::vector<std::string> names;
+
+    for (auto it : getRegistry()) {
+        names.push_back(it.first);
+    }
+
+    return names;
+}
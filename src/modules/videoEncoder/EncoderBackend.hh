@@ -0,0 +1,132 @@
+/*
+ *  EncoderBackend - Video encoder library interface for VideoEncoderPlugin
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _ENCODER_BACKEND_HH
+#define _ENCODER_BACKEND_HH
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+#include "../../Types.hh"
+
+/*! What a backend can do, so that the filter validates its configuration before opening it */
+struct EncoderCapabilities {
+    VCodecType codec;
+    std::vector<PixType> inputFormats;
+    bool rateReconfig;      //!< bitrate changes without reopening the encoder
+    bool forceKeyframe;     //!< keyframes can be requested per picture
+    unsigned maxThreads;    //!< 0 if there is no limit
+};
+
+/*! Encoding parameters of a backend */
+struct EncoderConfig {
+    int width;
+    int height;
+    PixType pixFmt;
+    unsigned fps;
+    unsigned bitrate;   //!< kbps
+    unsigned gop;
+    unsigned threads;
+};
+
+/*! Coded data returned by a backend. For NAL based codecs each packet is a NAL unit */
+struct EncodedPacket {
+    unsigned char *data;
+    unsigned size;
+    int64_t pts;
+    bool key;
+};
+
+/*! Interface implemented by each video encoder library. Pictures are submitted and coded
+    packets are polled independently, so that backends with internal delay (lookahead,
+    frame threads, hardware queues) can return them later. Submitted planes are not copied
+    by the caller, they are only valid during the submit call. Polled packet data is valid
+    until the next submit call.
+*/
+class EncoderBackend {
+    public:
+        virtual ~EncoderBackend() {};
+
+        /**
+        * Creates a backend by name. Built in backends are "vp8"
+        * @param name backend name
+        * @return pointer to new object or NULL if there is no such backend
+        */
+        static EncoderBackend* createNew(std::string name);
+
+        /**
+        * Adds a backend to the ones created by name, e.g. from an external library
+        * @param name backend name
+        * @param factory function creating a new backend
+        * @return false if the name is empty or already used
+        */
+        static bool registerBackend(std::string name, std::function<EncoderBackend*()> factory);
+
+        /**
+        * @return names of all the available backends
+        */
+        static std::vector<std::string> getBackends();
+
+        virtual std::string getName() = 0;
+        virtual EncoderCapabilities getCapabilities() = 0;
+
+        /**
+        * Opens the encoder, closing it first if it was already open
+        * @param config encoding parameters
+        * @return true if succeeded and false if not
+        */
+        virtual bool open(EncoderConfig const& config) = 0;
+
+        /**
+        * Changes the bitrate of an open encoder, only if the rateReconfig capability is set
+        * @param bitrate target bitrate in kbps
+        * @return true if succeeded and false if not
+        */
+        virtual bool setRate(unsigned bitrate) = 0;
+
+        /**
+        * Submits a picture to the encoder
+        * @param planes first byte of each plane
+        * @param strides line stride in bytes of each plane
+        * @param pts picture presentation timestamp, in frames
+        * @param key true to code it as a keyframe
+        * @return true if succeeded and false if not
+        */
+        virtual bool submit(unsigned char **planes, int *strides, int64_t pts, bool key) = 0;
+
+        /**
+        * Gets the next coded packet
+        * @param packet (out) coded packet
+        * @return false if there are no packets ready
+        */
+        virtual bool poll(EncodedPacket &packet) = 0;
+
+        virtual void close() = 0;
+
+    private:
+        static std::map<std::string, std::function<EncoderBackend*()>>& getRegistry();
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ *  KeyframeScheduler - Media time aligned keyframe placement
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "KeyframeScheduler.hh"
+
+KeyframeScheduler::KeyframeScheduler() : segmentDuration(0), currentSegment(-1)
+{
+}
+
+void KeyframeScheduler::setSegmentDuration(unsigned duration)
+{
+    if (duration != segmentDuration) {
+        segmentDuration = duration;
+        reset();
+    }
+}
+
+bool KeyframeScheduler::isBoundary(std::chrono::microseconds pTime)
+{
+    int64_t segment;
+
+    if (segmentDuration == 0) {
+        return false;
+    }
+
+    segment = pTime.count() / (segmentDuration * (int64_t) 1000);
+
+    //A new segment starts, or the source has restarted its timestamps
+    if (segment != currentSegment) {
+        currentSegment = segment;
+        return true;
+    }
+
+    return false;
+}
+
+void KeyframeScheduler::reset()
+{
+    currentSegment = -1;
+}
@@ -0,0 +1,65 @@
+/*
+ *  KeyframeScheduler - Media time aligned keyframe placement
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _KEYFRAME_SCHEDULER_HH
+#define _KEYFRAME_SCHEDULER_HH
+
+#include <chrono>
+
+/*! Places keyframes at the start of fixed duration segments of media time. Boundaries
+    are multiples of the segment duration, so encoders fed from the same source choose
+    the same frames regardless of their frame count or input frame rate variations
+*/
+class KeyframeScheduler {
+    public:
+        /**
+        * Class constructor. Scheduling is disabled until a segment duration is set
+        */
+        KeyframeScheduler();
+
+        /**
+        * Sets the segment duration
+        * @param duration segment duration in milliseconds, 0 to disable scheduling
+        */
+        void setSegmentDuration(unsigned duration);
+
+        /**
+        * Checks if a frame starts a new segment
+        * @param pTime frame presentation time
+        * @return true if the frame must be a keyframe
+        */
+        bool isBoundary(std::chrono::microseconds pTime);
+
+        /**
+        * Forgets the current segment, so that the next frame is a keyframe
+        */
+        void reset();
+
+        bool isEnabled() {return segmentDuration > 0;};
+        unsigned getSegmentDuration() {return segmentDuration;};
+
+    private:
+        unsigned segmentDuration;
+        int64_t currentSegment;
+};
+
+#endif
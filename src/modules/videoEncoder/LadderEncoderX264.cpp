@@ -0,0 +1,752 @@
+/*
+ *  LadderEncoderX264 - Multiple rendition x264 encoder with shared analysis
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "LadderEncoderX264.hh"
+#include "../../SlicedVideoFrameQueue.hh"
+#include "../../Utils.hh"
+
+#include <algorithm>
+#include <cstdlib>
+
+///////////////////////////////////////////////////
+//                SceneAnalyzer Class            //
+///////////////////////////////////////////////////
+
+SceneAnalyzer::SceneAnalyzer() : aWidth(0), aHeight(0), difference(0), avgDifference(0)
+{
+
+}
+
+void SceneAnalyzer::reset()
+{
+    previous.clear();
+    difference = 0;
+    avgDifference = 0;
+}
+
+bool SceneAnalyzer::analyze(unsigned char const* luma, int width, int height, int stride)
+{
+    unsigned char const* row;
+    unsigned sum = 0;
+    bool cut;
+
+    if (!luma || width < ANALYSIS_STEP || height < ANALYSIS_STEP) {
+        return false;
+    }
+
+    aWidth = width / ANALYSIS_STEP;
+    aHeight = height / ANALYSIS_STEP;
+    current.resize(aWidth * aHeight);
+
+    for (int y = 0; y < aHeight; y++) {
+        row = luma + y * ANALYSIS_STEP * stride;
+        for (int x = 0; x < aWidth; x++) {
+            current[y * aWidth + x] = row[x * ANALYSIS_STEP];
+        }
+    }
+
+    //Nothing to compare with after a reset or a size change
+    if (previous.size() != current.size()) {
+        previous.swap(current);
+        difference = 0;
+        return false;
+    }
+
+    for (size_t i = 0; i < current.size(); i++) {
+        sum += std::abs(current[i] - previous[i]);
+    }
+
+    difference = (float) sum / current.size();
+    cut = difference > SCENECUT_MIN_DIFF && difference > avgDifference * SCENECUT_RATIO;
+
+    //The average only follows the motion inside the scene
+    if (cut) {
+        avgDifference = 0;
+    } else {
+        avgDifference += (difference - avgDifference) / 8;
+    }
+
+    previous.swap(current);
+    return cut;
+}
+
+///////////////////////////////////////////////////
+//               LadderRendition Class           //
+///////////////////////////////////////////////////
+
+LadderRendition::LadderRendition() : width(0), height(0), bitrate(DEFAULT_RENDITION_BITRATE),
+ctx(NULL), picture(NULL), encoder(NULL), reopen(true), reconfig(true)
+{
+    x264_picture_init(&picIn);
+    x264_picture_init(&picOut);
+}
+
+LadderRendition::~LadderRendition()
+{
+    sws_freeContext(ctx);
+    delete picture;
+
+    if (encoder) {
+        x264_encoder_close(encoder);
+    }
+}
+
+void LadderRendition::config(int width, int height, unsigned bitrate)
+{
+    if (width != this->width || height != this->height) {
+        delete picture;
+        picture = NULL;
+        reopen = true;
+    }
+
+    this->width = width;
+    this->height = height;
+    this->bitrate = bitrate;
+    reconfig = true;
+}
+
+InterleavedVideoFrame *LadderRendition::getPicture()
+{
+    if (!picture && width > 0 && height > 0) {
+        picture = InterleavedVideoFrame::createNew(RAW, width, height, YUV420P);
+    }
+
+    return picture;
+}
+
+void LadderRendition::setEncoder(x264_t *e)
+{
+    if (encoder && encoder != e) {
+        x264_encoder_close(encoder);
+    }
+
+    encoder = e;
+}
+
+///////////////////////////////////////////////////
+//              LadderEncoderX264 Class          //
+///////////////////////////////////////////////////
+
+LadderEncoderX264* LadderEncoderX264::createNew(unsigned fps, unsigned gop, unsigned threads, std::string preset)
+{
+    if (fps == 0 || gop == 0 || threads == 0 || preset.empty()) {
+        utils::errorMsg("[LadderEncoderX264] Error creating LadderEncoderX264, invalid configuration values");
+        return NULL;
+    }
+
+    return new LadderEncoderX264(fps, gop, threads, preset);
+}
+
+LadderEncoderX264::LadderEncoderX264(unsigned fps, unsigned gop, unsigned threads, std::string preset) :
+OneToManyFilter(), pts(0), framesSinceKey(0), forceKey(true), keyframes(0), scenecuts(0)
+{
+    fType = LADDER_ENCODER;
+
+    inFrame = av_frame_alloc();
+    outFrame = av_frame_alloc();
+
+    configure0(fps, gop, threads, preset, true);
+    initializeEventMap();
+}
+
+LadderEncoderX264::~LadderEncoderX264()
+{
+    av_frame_free(&inFrame);
+    av_frame_free(&outFrame);
+
+    for (auto it : renditions) {
+        delete it.second;
+    }
+    renditions.clear();
+
+    for (auto it : outputStreamInfos) {
+        delete it.second;
+    }
+    outputStreamInfos.clear();
+}
+
+bool LadderEncoderX264::configRendition(int id, int width, int height, unsigned bitrate)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configRendition");
+    params.Add("id", id);
+    params.Add("width", width);
+    params.Add("height", height);
+    params.Add("bitrate", (int) bitrate);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool LadderEncoderX264::configure(unsigned fps, unsigned gop, unsigned threads, std::string preset, bool scenecut)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("fps", (int) fps);
+    params.Add("gop", (int) gop);
+    params.Add("threads", (int) threads);
+    params.Add("preset", preset);
+    params.Add("scenecut", scenecut);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool LadderEncoderX264::forceIntra()
+{
+    Jzon::Object root;
+    root.Add("action", "forceIntra");
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool LadderEncoderX264::configSegments(unsigned segmentDuration)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configSegments");
+    params.Add("segmentDuration", (int) segmentDuration);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+FrameQueue* LadderEncoderX264::allocQueue(ConnectionData cData)
+{
+    if (outputStreamInfos.count(cData.writerId) <= 0) {
+        utils::errorMsg("[LadderEncoderX264] No stream info for writer " + std::to_string(cData.writerId));
+        return NULL;
+    }
+
+    return SlicedVideoFrameQueue::createNew(cData, outputStreamInfos[cData.writerId], DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+}
+
+bool LadderEncoderX264::doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames)
+{
+    std::vector<std::pair<int, LadderRendition*>> ladder;
+    VideoFrame *vFrame;
+    VideoFrame *prevFrame;
+    AVPixelFormat prevPixFmt;
+    LadderRendition *rendition;
+    FrameTimeParams &times = frameTimes[pts % LADDER_MAX_DELAYED_FRAMES];
+    bool key;
+    bool processFrame = false;
+
+    vFrame = dynamic_cast<VideoFrame*>(org);
+
+    if (!vFrame) {
+        utils::errorMsg("[LadderEncoderX264] No origin frame");
+        return false;
+    }
+
+    for (auto it : dstFrames) {
+        rendition = renditions[it.first];
+        it.second->setConsumed(false);
+
+        if (rendition->getWidth() <= 0 || rendition->getHeight() <= 0) {
+            utils::warningMsg("[LadderEncoderX264] Rendition not configured (Rendition ID: " + std::to_string(it.first) + ")");
+            continue;
+        }
+
+        ladder.push_back(std::make_pair(it.first, rendition));
+    }
+
+    if (ladder.empty()) {
+        return false;
+    }
+
+    //Biggest renditions first, so that each one is scaled from the previous one
+    std::sort(ladder.begin(), ladder.end(),
+        [](const std::pair<int, LadderRendition*> &a, const std::pair<int, LadderRendition*> &b) {
+            return a.second->getWidth() * a.second->getHeight() > b.second->getWidth() * b.second->getHeight();
+        });
+
+    prevFrame = vFrame;
+    prevPixFmt = getLibavPixFmt(vFrame->getPixelFormat());
+
+    if (prevPixFmt == AV_PIX_FMT_NONE) {
+        return false;
+    }
+
+    for (auto step : ladder) {
+        if (!scaleRendition(step.second, prevFrame, prevPixFmt)) {
+            return false;
+        }
+
+        prevFrame = step.second->getPicture();
+        prevPixFmt = AV_PIX_FMT_YUV420P;
+    }
+
+    //Renditions reopened since the last frame start with a keyframe, so all of them do
+    for (auto step : ladder) {
+        if (step.second->needsOpen() || step.second->needsConfig()) {
+            if (!openEncoder(step.first, step.second)) {
+                return false;
+            }
+        }
+    }
+
+    //Analysis runs once, on the smallest rendition
+    key = keyframeDecision(ladder.back().second, org->getPresentationTime());
+
+    times.pTime = org->getPresentationTime();
+    times.oTime = org->getOriginTime();
+    times.seqNum = org->getSequenceNumber();
+
+    for (auto step : ladder) {
+        processFrame |= encodeRendition(step.first, step.second, key, dynamic_cast<VideoFrame*>(dstFrames[step.first]));
+    }
+
+    pts++;
+
+    return processFrame;
+}
+
+bool LadderEncoderX264::keyframeDecision(LadderRendition *analysed, std::chrono::microseconds pTime)
+{
+    InterleavedVideoFrame *picture = analysed->getPicture();
+    bool cut;
+    bool key;
+    bool scheduled;
+
+    cut = analyzer.analyze(picture->getDataBuf(), picture->getWidth(), picture->getHeight(), picture->getWidth());
+
+    //In segments mode the gop frame count is replaced by media time boundaries
+    if (keyScheduler.isEnabled()) {
+        scheduled = keyScheduler.isBoundary(pTime);
+    } else {
+        scheduled = framesSinceKey >= gop;
+    }
+
+    key = forceKey || scheduled ||
+          (scenecut && cut && framesSinceKey >= std::max(gop / MIN_KEYINT_FACTOR, 1U));
+
+    if (key && cut && !forceKey && !scheduled) {
+        scenecuts++;
+    }
+
+    if (key) {
+        framesSinceKey = 0;
+        forceKey = false;
+        keyframes++;
+    }
+
+    framesSinceKey++;
+    return key;
+}
+
+bool LadderEncoderX264::scaleRendition(LadderRendition *rendition, VideoFrame *prevFrame, AVPixelFormat prevPixFmt)
+{
+    InterleavedVideoFrame *picture;
+    ScalingAlgorithm algorithm;
+
+    picture = rendition->getPicture();
+
+    if (!picture) {
+        utils::errorMsg("[LadderEncoderX264] Could not allocate the rendition picture");
+        return false;
+    }
+
+    if (!setAVFrame(inFrame, prevFrame, prevPixFmt)) {
+        return false;
+    }
+
+    //Area averaging keeps downscaled steps free of aliasing, which would be carried down the ladder
+    if (rendition->getWidth() <= inFrame->width && rendition->getHeight() <= inFrame->height) {
+        algorithm = AREA;
+    } else {
+        algorithm = BICUBIC;
+    }
+
+    rendition->setContext(sws_getCachedContext(rendition->getContext(), inFrame->width, inFrame->height, prevPixFmt,
+                                               rendition->getWidth(), rendition->getHeight(), AV_PIX_FMT_YUV420P,
+                                               getSwsFlags(algorithm), 0, 0, 0));
+
+    if (!rendition->getContext()) {
+        utils::errorMsg("[LadderEncoderX264] Could not get the swscale context");
+        return false;
+    }
+
+    picture->setLength(avpicture_get_size(AV_PIX_FMT_YUV420P, rendition->getWidth(), rendition->getHeight()));
+
+    if (!setAVFrame(outFrame, picture, AV_PIX_FMT_YUV420P)) {
+        return false;
+    }
+
+    if (sws_scale(rendition->getContext(), inFrame->data, inFrame->linesize, 0,
+                  inFrame->height, outFrame->data, outFrame->linesize) <= 0) {
+        utils::errorMsg("[LadderEncoderX264] Could not scale image");
+        return false;
+    }
+
+    return true;
+}
+
+bool LadderEncoderX264::openEncoder(int id, LadderRendition *rendition)
+{
+    x264_param_t *xparams = rendition->getParams();
+    x264_t *encoder;
+    x264_nal_t *nals;
+    int piNal;
+    int encodeSize;
+
+    x264_param_default_preset(xparams, preset.c_str(), NULL);
+    x264_param_apply_profile(xparams, "high");
+
+    x264_param_parse(xparams, "fps", std::to_string(fps).c_str());
+    x264_param_parse(xparams, "threads", std::to_string(threads).c_str());
+    x264_param_parse(xparams, "aud", std::to_string(1).c_str());
+    x264_param_parse(xparams, "bitrate", std::to_string(rendition->getBitrate()).c_str());
+    x264_param_parse(xparams, "vbv-maxrate", std::to_string(rendition->getBitrate()*1.05).c_str());
+    x264_param_parse(xparams, "vbv-bufsize", std::to_string(rendition->getBitrate()*2).c_str());
+    x264_param_parse(xparams, "bframes", std::to_string(0).c_str());
+    x264_param_parse(xparams, "repeat-headers", std::to_string(1).c_str());
+    x264_param_parse(xparams, "annexb", std::to_string(1).c_str());
+
+    //GOPs are decided by the shared analysis, so encoders never place keyframes by themselves.
+    //Each one keeps the preset lookahead, which still drives its own rate control and mb-tree
+    x264_param_parse(xparams, "keyint", "infinite");
+    x264_param_parse(xparams, "scenecut", std::to_string(0).c_str());
+
+    xparams->i_width = rendition->getWidth();
+    xparams->i_height = rendition->getHeight();
+    xparams->i_csp = X264_CSP_I420;
+
+    encoder = rendition->getEncoder();
+
+    if (encoder && !rendition->needsOpen() && x264_encoder_reconfig(encoder, xparams) >= 0) {
+        rendition->setConfigured();
+        return true;
+    }
+
+    rendition->setEncoder(NULL);
+    encoder = x264_encoder_open(xparams);
+
+    if (!encoder) {
+        utils::errorMsg("[LadderEncoderX264] Could not open x264 encoder (Rendition ID: " + std::to_string(id) + ")");
+        return false;
+    }
+
+    rendition->setEncoder(encoder);
+    rendition->setConfigured();
+
+    encodeSize = x264_encoder_headers(encoder, &nals, &piNal);
+
+    if (encodeSize < 0) {
+        utils::errorMsg("[LadderEncoderX264] Could not encode headers");
+        return false;
+    }
+
+    outputStreamInfos[id]->setExtraData(nals[0].p_payload, encodeSize);
+
+    //A new encoder starts with a keyframe, which must be aligned in all the renditions
+    forceKey = true;
+    return true;
+}
+
+bool LadderEncoderX264::encodeRendition(int id, LadderRendition *rendition, bool key, VideoFrame *dst)
+{
+    SlicedVideoFrame *slicedFrame;
+    InterleavedVideoFrame *picture;
+    x264_picture_t *picIn;
+    x264_picture_t *picOut;
+    x264_nal_t *nals;
+    int piNal;
+    int success;
+
+    slicedFrame = dynamic_cast<SlicedVideoFrame*>(dst);
+    picture = rendition->getPicture();
+
+    if (!slicedFrame || !picture || !rendition->getEncoder()) {
+        utils::errorMsg("[LadderEncoderX264] Could not encode rendition " + std::to_string(id));
+        return false;
+    }
+
+    if (!setAVFrame(outFrame, picture, AV_PIX_FMT_YUV420P)) {
+        return false;
+    }
+
+    picIn = rendition->getPicIn();
+    picOut = rendition->getPicOut();
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && i < 4; i++) {
+        picIn->img.plane[i] = outFrame->data[i];
+        picIn->img.i_stride[i] = outFrame->linesize[i];
+    }
+
+    picIn->img.i_csp = X264_CSP_I420;
+    picIn->i_type = key ? X264_TYPE_IDR : X264_TYPE_AUTO;
+    picIn->i_pts = pts;
+
+    success = x264_encoder_encode(rendition->getEncoder(), &nals, &piNal, picIn, picOut);
+
+    if (success == 0) {
+        return false;
+    } else if (success < 0) {
+        utils::errorMsg("[LadderEncoderX264] Could not encode video frame (Rendition ID: " + std::to_string(id) + ")");
+        return false;
+    }
+
+    for (int i = 0; i < piNal; i++) {
+        if (!slicedFrame->setSlice(nals[i].p_payload, nals[i].i_payload)) {
+            utils::errorMsg("[LadderEncoderX264] Too many NALs for one slicedFrame");
+            return false;
+        }
+    }
+
+    //Encoders with frame threads return previous frames, which are identified by their pts
+    FrameTimeParams &times = frameTimes[picOut->i_pts % LADDER_MAX_DELAYED_FRAMES];
+
+    slicedFrame->setSize(rendition->getWidth(), rendition->getHeight());
+    slicedFrame->setPresentationTime(times.pTime);
+    slicedFrame->setOriginTime(times.oTime);
+    slicedFrame->setSequenceNumber(times.seqNum);
+    slicedFrame->setConsumed(true);
+
+    return true;
+}
+
+bool LadderEncoderX264::setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelFormat format)
+{
+    InterleavedVideoFrame *iFrame = dynamic_cast<InterleavedVideoFrame*> (vFrame);
+
+    //Padded or aligned planes are taken as they are
+    if (iFrame && iFrame->isPlanarView()) {
+        iFrame->getPlanes(aFrame->data, aFrame->linesize);
+        aFrame->width = vFrame->getWidth();
+        aFrame->height = vFrame->getHeight();
+        aFrame->format = format;
+        return true;
+    }
+
+    if (avpicture_fill((AVPicture *) aFrame, vFrame->getDataBuf(),
+            format, vFrame->getWidth(),
+            vFrame->getHeight()) <= 0){
+        utils::errorMsg("[LadderEncoderX264] Could not feed AVFrame");
+        return false;
+    }
+
+    //Strided views are only published for packed pixel formats
+    if (vFrame->getStride() > 0) {
+        aFrame->linesize[0] = vFrame->getStride();
+    }
+
+    aFrame->width = vFrame->getWidth();
+    aFrame->height = vFrame->getHeight();
+    aFrame->format = format;
+
+    return true;
+}
+
+void LadderEncoderX264::doGetState(Jzon::Object &filterNode)
+{
+    Jzon::Array jsonRenditions;
+
+    filterNode.Add("fps", (int) fps);
+    filterNode.Add("gop", (int) gop);
+    filterNode.Add("threads", (int) threads);
+    filterNode.Add("preset", preset);
+    filterNode.Add("scenecut", scenecut);
+    filterNode.Add("segmentDuration", (int) keyScheduler.getSegmentDuration());
+    filterNode.Add("keyframes", (int) keyframes);
+    filterNode.Add("scenecuts", (int) scenecuts);
+
+    for (auto it : renditions) {
+        Jzon::Object rendition;
+        rendition.Add("id", it.first);
+        rendition.Add("width", it.second->getWidth());
+        rendition.Add("height", it.second->getHeight());
+        rendition.Add("bitrate", (int) it.second->getBitrate());
+        jsonRenditions.Add(rendition);
+    }
+
+    filterNode.Add("renditions", jsonRenditions);
+}
+
+bool LadderEncoderX264::configRendition0(int id, int width, int height, unsigned bitrate)
+{
+    if (renditions.count(id) <= 0) {
+        utils::errorMsg("[LadderEncoderX264] Error configuring rendition. Incorrect Id " + std::to_string(id));
+        return false;
+    }
+
+    //4:2:0 chroma planes need even dimensions
+    if (width < MIN_WIDTH || height < MIN_HEIGHT || width % 2 != 0 || height % 2 != 0 || bitrate <= 0) {
+        utils::errorMsg("[LadderEncoderX264] Error configuring rendition. Incoherent values");
+        return false;
+    }
+
+    renditions[id]->config(width, height, bitrate);
+    outputStreamInfos[id]->video.width = width;
+    outputStreamInfos[id]->video.height = height;
+    return true;
+}
+
+bool LadderEncoderX264::configure0(unsigned fps, unsigned gop, unsigned threads, std::string preset, bool scenecut)
+{
+    if (fps == 0 || gop == 0 || threads == 0 || preset.empty()) {
+        utils::errorMsg("[LadderEncoderX264] Error configuring. Invalid configuration values");
+        return false;
+    }
+
+    this->fps = fps;
+    this->gop = gop;
+    this->threads = threads;
+    this->preset = preset;
+    this->scenecut = scenecut;
+
+    setFrameTime(std::chrono::microseconds(std::micro::den/fps));
+
+    for (auto it : renditions) {
+        it.second->setNeedsOpen();
+    }
+
+    return true;
+}
+
+bool LadderEncoderX264::configSegments0(unsigned segmentDuration)
+{
+    keyScheduler.setSegmentDuration(segmentDuration);
+    return true;
+}
+
+void LadderEncoderX264::initializeEventMap()
+{
+    eventMap["configRendition"] = std::bind(&LadderEncoderX264::configRenditionEvent, this, std::placeholders::_1);
+    eventMap["configure"] = std::bind(&LadderEncoderX264::configEvent, this, std::placeholders::_1);
+    eventMap["forceIntra"] = std::bind(&LadderEncoderX264::forceIntraEvent, this, std::placeholders::_1);
+    eventMap["configSegments"] = std::bind(&LadderEncoderX264::configSegmentsEvent, this, std::placeholders::_1);
+}
+
+bool LadderEncoderX264::configRenditionEvent(Jzon::Node* params)
+{
+    unsigned bitrate = DEFAULT_RENDITION_BITRATE;
+
+    if (!params) {
+        utils::errorMsg("[LadderEncoderX264::configRenditionEvent] Params node missing");
+        return false;
+    }
+
+    if (!params->Has("id") || !params->Has("width") || !params->Has("height")) {
+        utils::errorMsg("[LadderEncoderX264::configRenditionEvent] Params node not complete");
+        return false;
+    }
+
+    if (params->Has("bitrate")) {
+        bitrate = params->Get("bitrate").ToInt();
+    }
+
+    return configRendition0(params->Get("id").ToInt(), params->Get("width").ToInt(),
+                            params->Get("height").ToInt(), bitrate);
+}
+
+bool LadderEncoderX264::configEvent(Jzon::Node* params)
+{
+    unsigned tmpFps = fps;
+    unsigned tmpGop = gop;
+    unsigned tmpThreads = threads;
+    std::string tmpPreset = preset;
+    bool tmpScenecut = scenecut;
+
+    if (!params) {
+        return false;
+    }
+
+    if (params->Has("fps")) {
+        tmpFps = params->Get("fps").ToInt();
+    }
+
+    if (params->Has("gop")) {
+        tmpGop = params->Get("gop").ToInt();
+    }
+
+    if (params->Has("threads")) {
+        tmpThreads = params->Get("threads").ToInt();
+    }
+
+    if (params->Has("preset")) {
+        tmpPreset = params->Get("preset").ToString();
+    }
+
+    if (params->Has("scenecut")) {
+        tmpScenecut = params->Get("scenecut").ToBool();
+    }
+
+    return configure0(tmpFps, tmpGop, tmpThreads, tmpPreset, tmpScenecut);
+}
+
+bool LadderEncoderX264::configSegmentsEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("segmentDuration")) {
+        return false;
+    }
+
+    return configSegments0(params->Get("segmentDuration").ToInt());
+}
+
+bool LadderEncoderX264::forceIntraEvent(Jzon::Node*)
+{
+    forceKey = true;
+    return true;
+}
+
+bool LadderEncoderX264::specificWriterConfig(int writerID)
+{
+    if (renditions.count(writerID) > 0) {
+        utils::errorMsg("[LadderEncoderX264::specificWriterConfig] Error configuring. This WriterID exist " + std::to_string(writerID));
+        return false;
+    }
+
+    renditions[writerID] = new LadderRendition();
+
+    //Queues keep a pointer to the stream info, so it lives as long as the filter
+    if (outputStreamInfos.count(writerID) <= 0) {
+        outputStreamInfos[writerID] = new StreamInfo(VIDEO);
+    }
+
+    outputStreamInfos[writerID]->video.codec = H264;
+    outputStreamInfos[writerID]->video.h264or5.annexb = true;
+    outputStreamInfos[writerID]->video.width = 0;
+    outputStreamInfos[writerID]->video.height = 0;
+
+    return true;
+}
+
+bool LadderEncoderX264::specificWriterDelete(int writerID)
+{
+    if (renditions.count(writerID) <= 0) {
+        utils::errorMsg("[LadderEncoderX264::specificWriterDelete] Error configuring. This WriterID doesn't exist " + std::to_string(writerID));
+        return false;
+    }
+
+    delete renditions[writerID];
+    renditions.erase(writerID);
+
+    return true;
+}
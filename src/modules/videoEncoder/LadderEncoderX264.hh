@@ -0,0 +1,251 @@
+/*
+ *  LadderEncoderX264 - Multiple rendition x264 encoder with shared analysis
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _LADDER_ENCODER_X264_HH
+#define _LADDER_ENCODER_X264_HH
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libswscale/swscale.h>
+#include <libavcodec/avcodec.h>
+#include <x264.h>
+}
+
+#include "../../VideoFrame.hh"
+#include "../../Filter.hh"
+#include "../../StreamInfo.hh"
+#include "../videoResampler/VideoResampler.hh"
+#include "VideoEncoderX264or5.hh"
+#include "KeyframeScheduler.hh"
+
+#include <vector>
+
+#define DEFAULT_RENDITION_BITRATE 1000 //kbps
+#define LADDER_MAX_DELAYED_FRAMES 512 //covers the maximum lookahead plus frame threads
+#define ANALYSIS_STEP 8 //pixels between analysed luma samples
+#define SCENECUT_MIN_DIFF 20.0 //mean absolute luma difference
+#define SCENECUT_RATIO 3.0 //over the average difference of the scene
+#define MIN_KEYINT_FACTOR 4 //scene cuts are at least gop/MIN_KEYINT_FACTOR frames apart
+
+/*! Scene change detector shared by all the renditions. It compares a subsampled luma
+    plane with the one of the previous frame
+*/
+class SceneAnalyzer {
+    public:
+        /**
+        * Class constructor
+        */
+        SceneAnalyzer();
+
+        /**
+        * Analyses a frame
+        * @param luma luma plane
+        * @param width plane width
+        * @param height plane height
+        * @param stride plane stride in bytes
+        * @return true if the frame starts a new scene
+        */
+        bool analyze(unsigned char const* luma, int width, int height, int stride);
+
+        /**
+        * Forgets the previous frame, so that the next one is not compared
+        */
+        void reset();
+
+        float getDifference() {return difference;};
+
+    private:
+        std::vector<unsigned char> previous;
+        std::vector<unsigned char> current;
+        int aWidth;
+        int aHeight;
+        float difference;
+        float avgDifference;
+};
+
+/*! Output rendition of the ladder encoder. It keeps the picture scaled from the previous
+    (bigger) rendition and the x264 encoder that codes it
+*/
+class LadderRendition {
+    public:
+        /**
+        * Class constructor.
+        */
+        LadderRendition();
+
+        /**
+        * Class destructor.
+        */
+        ~LadderRendition();
+
+        /**
+        * It sets rendition size and bitrate
+        * @param width output width
+        * @param height output height
+        * @param bitrate output bitrate in kbps
+        */
+        void config(int width, int height, unsigned bitrate);
+
+        int getWidth() {return width;};
+        int getHeight() {return height;};
+        unsigned getBitrate() {return bitrate;};
+
+        struct SwsContext *getContext() {return ctx;};
+        void setContext(struct SwsContext *c) {ctx = c;};
+
+        InterleavedVideoFrame *getPicture();
+
+        x264_t *getEncoder() {return encoder;};
+        void setEncoder(x264_t *e);
+        x264_param_t *getParams() {return &xparams;};
+        x264_picture_t *getPicIn() {return &picIn;};
+        x264_picture_t *getPicOut() {return &picOut;};
+
+        bool needsOpen() {return reopen;};
+        bool needsConfig() {return reconfig;};
+        void setNeedsOpen() {reopen = true;};
+        void setConfigured() {reopen = false; reconfig = false;};
+
+    private:
+        int width;
+        int height;
+        unsigned bitrate;
+        struct SwsContext *ctx;
+        InterleavedVideoFrame *picture;
+
+        x264_t *encoder;
+        x264_param_t xparams;
+        x264_picture_t picIn;
+        x264_picture_t picOut;
+
+        bool reopen;
+        bool reconfig;
+};
+
+/*! One to many H264 encoder for ABR ladders. Scene cut and GOP decisions are taken once for
+    all the renditions, so that their keyframes are aligned, while each rendition keeps its own
+    lookahead for rate control. Each rendition is scaled from the previous (bigger) one
+*/
+class LadderEncoderX264 : public OneToManyFilter {
+
+    public:
+        /**
+        * Creates a new ladder encoder
+        * @param fps output frame rate
+        * @param gop maximum distance between keyframes
+        * @param threads encoding threads of each rendition
+        * @param preset x264 preset
+        * @return Pointer to new object if succeed of NULL if not
+        */
+        static LadderEncoderX264* createNew(unsigned fps = VIDEO_DEFAULT_FRAMERATE, unsigned gop = DEFAULT_GOP,
+                                           unsigned threads = DEFAULT_THREADS, std::string preset = DEFAULT_PRESET);
+
+        /**
+        * Class destructor
+        */
+        ~LadderEncoderX264();
+
+        /**
+        * Configures the rendition associated to a writer
+        * @param id writer id
+        * @param width output width
+        * @param height output height
+        * @param bitrate output bitrate in kbps
+        */
+        bool configRendition(int id, int width, int height, unsigned bitrate);
+
+        /**
+        * Configures the common encoding parameters
+        * @param fps output frame rate
+        * @param gop maximum distance between keyframes
+        * @param threads encoding threads of each rendition
+        * @param preset x264 preset
+        * @param scenecut true to start a GOP at scene changes
+        */
+        bool configure(unsigned fps, unsigned gop, unsigned threads, std::string preset, bool scenecut = true);
+
+        /**
+        * Forces a keyframe in all the renditions
+        */
+        bool forceIntra();
+
+        /**
+        * Starts every segment of media time with a keyframe in all the renditions, instead
+        * of placing one every gop frames. Scene cut keyframes are kept
+        * @param segmentDuration segment duration in milliseconds, 0 to go back to gop keyframes
+        */
+        bool configSegments(unsigned segmentDuration);
+
+    protected:
+        LadderEncoderX264(unsigned fps, unsigned gop, unsigned threads, std::string preset);
+        FrameQueue *allocQueue(ConnectionData cData);
+        bool doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames);
+        void doGetState(Jzon::Object &filterNode);
+        bool configRendition0(int id, int width, int height, unsigned bitrate);
+        bool configure0(unsigned fps, unsigned gop, unsigned threads, std::string preset, bool scenecut);
+        bool configSegments0(unsigned segmentDuration);
+        bool keyframeDecision(LadderRendition *analysed, std::chrono::microseconds pTime);
+        bool specificWriterConfig(int writerID);
+        bool specificWriterDelete(int writerID);
+
+    private:
+        void initializeEventMap();
+        bool configRenditionEvent(Jzon::Node* params);
+        bool configEvent(Jzon::Node* params);
+        bool forceIntraEvent(Jzon::Node* params);
+        bool configSegmentsEvent(Jzon::Node* params);
+        bool setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelFormat format);
+        bool scaleRendition(LadderRendition *rendition, VideoFrame *prevFrame, AVPixelFormat prevPixFmt);
+        bool openEncoder(int id, LadderRendition *rendition);
+        bool encodeRendition(int id, LadderRendition *rendition, bool key, VideoFrame *dst);
+
+        //NOTE: There is no need of specific reader configuration
+        bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
+        bool specificReaderDelete(int /*readerID*/) {return true;};
+
+        struct FrameTimeParams {
+            std::chrono::microseconds pTime;
+            std::chrono::system_clock::time_point oTime;
+            size_t seqNum;
+        };
+
+        std::map<int, LadderRendition*> renditions;
+        std::map<int, StreamInfo*> outputStreamInfos;
+
+        SceneAnalyzer       analyzer;
+        KeyframeScheduler   keyScheduler;
+        FrameTimeParams     frameTimes[LADDER_MAX_DELAYED_FRAMES];
+        int64_t             pts;
+        unsigned            framesSinceKey;
+        bool                forceKey;
+        size_t              keyframes;
+        size_t              scenecuts;
+
+        AVFrame             *inFrame, *outFrame;
+        unsigned            fps;
+        unsigned            gop;
+        unsigned            threads;
+        std::string         preset;
+        bool                scenecut;
+};
+
+#endif
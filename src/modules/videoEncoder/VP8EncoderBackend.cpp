@@ -0,0 +1,154 @@
+/*
+ *  VP8EncoderBackend - libvpx VP8 encoder backend
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "VP8EncoderBackend.hh"
+#include "../../Utils.hh"
+
+VP8EncoderBackend::VP8EncoderBackend() : iter(NULL), opened(false)
+{
+}
+
+VP8EncoderBackend::~VP8EncoderBackend()
+{
+    close();
+}
+
+EncoderCapabilities VP8EncoderBackend::getCapabilities()
+{
+    EncoderCapabilities caps;
+
+    caps.codec = VP8;
+    caps.inputFormats = {YUV420P};
+    caps.rateReconfig = true;
+    caps.forceKeyframe = true;
+    caps.maxThreads = VP8_MAX_THREADS;
+
+    return caps;
+}
+
+bool VP8EncoderBackend::open(EncoderConfig const& config_)
+{
+    close();
+
+    if (vpx_codec_enc_config_default(vpx_codec_vp8_cx(), &cfg, 0) != VPX_CODEC_OK) {
+        utils::errorMsg("[VP8EncoderBackend] Could not get default configuration");
+        return false;
+    }
+
+    config = config_;
+
+    cfg.g_w = config.width;
+    cfg.g_h = config.height;
+    cfg.g_timebase.num = 1;
+    cfg.g_timebase.den = config.fps;
+    cfg.g_threads = config.threads;
+    cfg.g_lag_in_frames = 0;
+    cfg.rc_end_usage = VPX_CBR;
+    cfg.rc_target_bitrate = config.bitrate;
+    cfg.kf_mode = VPX_KF_AUTO;
+    cfg.kf_max_dist = config.gop;
+
+    if (vpx_codec_enc_init(&codec, vpx_codec_vp8_cx(), &cfg, 0) != VPX_CODEC_OK) {
+        utils::errorMsg("[VP8EncoderBackend] Could not open encoder");
+        return false;
+    }
+
+    vpx_codec_control(&codec, VP8E_SET_CPUUSED, VP8_CPU_USED);
+
+    opened = true;
+    return true;
+}
+
+bool VP8EncoderBackend::setRate(unsigned bitrate)
+{
+    if (!opened) {
+        return false;
+    }
+
+    cfg.rc_target_bitrate = bitrate;
+
+    if (vpx_codec_enc_config_set(&codec, &cfg) != VPX_CODEC_OK) {
+        utils::errorMsg("[VP8EncoderBackend] Could not change bitrate");
+        return false;
+    }
+
+    config.bitrate = bitrate;
+    return true;
+}
+
+bool VP8EncoderBackend::submit(unsigned char **planes, int *strides, int64_t pts, bool key)
+{
+    if (!opened) {
+        return false;
+    }
+
+    //The image just points to the input planes, they are not copied
+    vpx_img_wrap(&img, VPX_IMG_FMT_I420, config.width, config.height, 1, planes[0]);
+
+    for (int i = 0; i < 3; i++) {
+        img.planes[i] = planes[i];
+        img.stride[i] = strides[i];
+    }
+
+    iter = NULL;
+
+    if (vpx_codec_encode(&codec, &img, pts, 1, key ? VPX_EFLAG_FORCE_KF : 0, VPX_DL_REALTIME) != VPX_CODEC_OK) {
+        utils::errorMsg("[VP8EncoderBackend] Could not encode picture");
+        return false;
+    }
+
+    return true;
+}
+
+bool VP8EncoderBackend::poll(EncodedPacket &packet)
+{
+    const vpx_codec_cx_pkt_t *pkt;
+
+    if (!opened) {
+        return false;
+    }
+
+    while ((pkt = vpx_codec_get_cx_data(&codec, &iter)) != NULL) {
+        if (pkt->kind != VPX_CODEC_CX_FRAME_PKT) {
+            continue;
+        }
+
+        packet.data = (unsigned char*) pkt->data.frame.buf;
+        packet.size = pkt->data.frame.sz;
+        packet.pts = pkt->data.frame.pts;
+        packet.key = (pkt->data.frame.flags & VPX_FRAME_IS_KEY) != 0;
+        return true;
+    }
+
+    return false;
+}
+
+void VP8EncoderBackend::close()
+{
+    if (!opened) {
+        return;
+    }
+
+    vpx_codec_destroy(&codec);
+    iter = NULL;
+    opened = false;
+}
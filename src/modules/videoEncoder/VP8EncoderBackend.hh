@@ -0,0 +1,61 @@
+/*
+ *  VP8EncoderBackend - libvpx VP8 encoder backend
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _VP8_ENCODER_BACKEND_HH
+#define _VP8_ENCODER_BACKEND_HH
+
+extern "C" {
+#include <vpx/vpx_encoder.h>
+#include <vpx/vp8cx.h>
+}
+
+#include "EncoderBackend.hh"
+
+#define VP8_CPU_USED 8 //speed over quality, as used for real time
+#define VP8_MAX_THREADS 64
+
+/*! Software reference backend, it codes VP8 in real time mode without lag, so each
+    submitted picture is polled back right away
+*/
+class VP8EncoderBackend : public EncoderBackend {
+    public:
+        VP8EncoderBackend();
+        ~VP8EncoderBackend();
+
+        std::string getName() {return "vp8";};
+        EncoderCapabilities getCapabilities();
+        bool open(EncoderConfig const& config);
+        bool setRate(unsigned bitrate);
+        bool submit(unsigned char **planes, int *strides, int64_t pts, bool key);
+        bool poll(EncodedPacket &packet);
+        void close();
+
+    private:
+        vpx_codec_ctx_t codec;
+        vpx_codec_enc_cfg_t cfg;
+        vpx_image_t img;
+        vpx_codec_iter_t iter;
+        EncoderConfig config;
+        bool opened;
+};
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ *  VideoEncoderPlugin - Video encoder filter driving an EncoderBackend
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "VideoEncoderPlugin.hh"
+#include "../../AVFramedQueue.hh"
+#include "../../SlicedVideoFrameQueue.hh"
+#include "../../Utils.hh"
+
+VideoEncoderPlugin* VideoEncoderPlugin::createNew(std::string backendName)
+{
+    EncoderBackend *backend;
+
+    backend = EncoderBackend::createNew(backendName);
+
+    if (!backend) {
+        utils::errorMsg("[VideoEncoderPlugin] Unknown encoder backend " + backendName);
+        return NULL;
+    }
+
+    return new VideoEncoderPlugin(backend);
+}
+
+VideoEncoderPlugin::VideoEncoderPlugin(EncoderBackend *backend_) :
+OneToOneFilter(), backend(backend_), pts(0), needsConfig(true), needsRateConfig(false), forceKey(false)
+{
+    fType = PLUGIN_ENCODER;
+    caps = backend->getCapabilities();
+
+    config.width = 0;
+    config.height = 0;
+    config.pixFmt = P_NONE;
+    config.bitrate = 0;
+    config.fps = 0;
+    config.gop = 0;
+    config.threads = 0;
+
+    outputStreamInfo = new StreamInfo(VIDEO);
+    outputStreamInfo->video.codec = caps.codec;
+    outputStreamInfo->video.h264or5.annexb = true;
+
+    configure0(DEFAULT_BITRATE, VIDEO_DEFAULT_FRAMERATE, DEFAULT_GOP, DEFAULT_THREADS);
+    initializeEventMap();
+}
+
+VideoEncoderPlugin::~VideoEncoderPlugin()
+{
+    backend->close();
+    delete backend;
+    delete outputStreamInfo;
+}
+
+FrameQueue* VideoEncoderPlugin::allocQueue(ConnectionData cData)
+{
+    //NAL based codecs are delivered in slices, others in whole frames
+    if (caps.codec == H264 || caps.codec == H265) {
+        return SlicedVideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+    }
+
+    return VideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_VIDEO_FRAMES);
+}
+
+bool VideoEncoderPlugin::doProcessFrame(Frame *org, Frame *dst)
+{
+    InterleavedVideoFrame *rawFrame;
+    VideoFrame *codedFrame;
+    EncodedPacket packet;
+    FrameTimeParams times;
+    unsigned char *planes[MAX_PLANES];
+    int strides[MAX_PLANES];
+    int64_t picturePts;
+    bool written = true;
+    bool success;
+
+    rawFrame = dynamic_cast<InterleavedVideoFrame*> (org);
+    codedFrame = dynamic_cast<VideoFrame*> (dst);
+
+    if (!rawFrame || !codedFrame) {
+        utils::errorMsg("[VideoEncoderPlugin] Error encoding frame: org and dst MUST be VideoFrame");
+        return false;
+    }
+
+    if (!reconfigure(rawFrame)) {
+        return false;
+    }
+
+    if (rawFrame->getPlanes(planes, strides) == 0) {
+        utils::errorMsg("[VideoEncoderPlugin] Could not get input frame planes");
+        return false;
+    }
+
+    times.pTime = org->getPresentationTime();
+    times.oTime = org->getOriginTime();
+    times.seqNum = org->getSequenceNumber();
+    frameTimes[pts % PLUGIN_MAX_DELAYED_FRAMES] = times;
+
+    success = backend->submit(planes, strides, pts, forceKey && caps.forceKeyframe);
+    pts++;
+    forceKey = false;
+
+    if (!success) {
+        return false;
+    }
+
+    //Packets are only valid until the next submit, so all the ready ones are kept now
+    while (backend->poll(packet)) {
+        pendingPackets.push_back({std::vector<unsigned char>(packet.data, packet.data + packet.size), packet.pts, packet.key});
+    }
+
+    if (pendingPackets.empty()) {
+        dst->setConsumed(false);
+        return false;
+    }
+
+    codedFrame->setSize(config.width, config.height);
+    dst->setLength(0);
+
+    //Only the packets of one picture are written, the following ones wait for the next frames
+    picturePts = pendingPackets.front().pts;
+
+    while (!pendingPackets.empty() && pendingPackets.front().pts == picturePts) {
+        PendingPacket &pending = pendingPackets.front();
+        packet.data = pending.data.data();
+        packet.size = pending.data.size();
+        packet.pts = pending.pts;
+        packet.key = pending.key;
+
+        written &= writePacket(packet, codedFrame);
+        pendingPackets.pop_front();
+    }
+
+    dst->setConsumed(written);
+    return written;
+}
+
+bool VideoEncoderPlugin::writePacket(EncodedPacket const& packet, VideoFrame *codedFrame)
+{
+    SlicedVideoFrame *slicedFrame;
+
+    if (packet.pts < 0 || packet.pts >= pts || pts - packet.pts > PLUGIN_MAX_DELAYED_FRAMES) {
+        utils::errorMsg("[VideoEncoderPlugin] Coded packet pts out of the encoder delay");
+        return false;
+    }
+
+    FrameTimeParams const& times = frameTimes[packet.pts % PLUGIN_MAX_DELAYED_FRAMES];
+    codedFrame->setPresentationTime(times.pTime);
+    codedFrame->setOriginTime(times.oTime);
+    codedFrame->setSequenceNumber(times.seqNum);
+
+    if ((slicedFrame = dynamic_cast<SlicedVideoFrame*> (codedFrame))) {
+        return slicedFrame->setSlice(packet.data, packet.size);
+    }
+
+    //Pictures coded in more than one packet are appended
+    if (codedFrame->getLength() + packet.size > codedFrame->getMaxLength()) {
+        utils::errorMsg("[VideoEncoderPlugin] Coded packet too big for the output frame");
+        return false;
+    }
+
+    memcpy(codedFrame->getDataBuf() + codedFrame->getLength(), packet.data, packet.size);
+    codedFrame->setLength(codedFrame->getLength() + packet.size);
+    return true;
+}
+
+bool VideoEncoderPlugin::reconfigure(VideoFrame *rawFrame)
+{
+    PixType pixFmt = rawFrame->getPixelFormat();
+
+    if (std::find(caps.inputFormats.begin(), caps.inputFormats.end(), pixFmt) == caps.inputFormats.end()) {
+        utils::errorMsg("[VideoEncoderPlugin] Input pixel format not supported by " + backend->getName());
+        return false;
+    }
+
+    if (rawFrame->getWidth() != config.width || rawFrame->getHeight() != config.height || pixFmt != config.pixFmt) {
+        config.width = rawFrame->getWidth();
+        config.height = rawFrame->getHeight();
+        config.pixFmt = pixFmt;
+        needsConfig = true;
+    }
+
+    if (needsConfig) {
+        if (!backend->open(config)) {
+            utils::errorMsg("[VideoEncoderPlugin] Could not open " + backend->getName() + " backend");
+            return false;
+        }
+
+        outputStreamInfo->video.width = config.width;
+        outputStreamInfo->video.height = config.height;
+        needsConfig = false;
+        needsRateConfig = false;
+        return true;
+    }
+
+    //A failed rate change keeps the previous rate control
+    if (needsRateConfig && !backend->setRate(config.bitrate)) {
+        utils::warningMsg("[VideoEncoderPlugin] Could not change encoder bitrate");
+    }
+
+    needsRateConfig = false;
+    return true;
+}
+
+bool VideoEncoderPlugin::configure(unsigned bitrate, unsigned fps, unsigned gop, unsigned threads)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("bitrate", (int) bitrate);
+    params.Add("fps", (int) fps);
+    params.Add("gop", (int) gop);
+    params.Add("threads", (int) threads);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool VideoEncoderPlugin::configure0(unsigned bitrate, unsigned fps, unsigned gop, unsigned threads)
+{
+    if (bitrate == 0 || fps == 0 || gop == 0 || threads == 0) {
+        utils::errorMsg("[VideoEncoderPlugin] Error configuring. Invalid configuration values");
+        return false;
+    }
+
+    if (caps.maxThreads > 0) {
+        threads = std::min(threads, caps.maxThreads);
+    }
+
+    //Only the bitrate changes and the backend can change it on the fly
+    if (caps.rateReconfig && fps == config.fps && gop == config.gop && threads == config.threads) {
+        needsRateConfig = bitrate != config.bitrate;
+        config.bitrate = bitrate;
+        return true;
+    }
+
+    config.bitrate = bitrate;
+    config.fps = fps;
+    config.gop = gop;
+    config.threads = threads;
+
+    setFrameTime(std::chrono::microseconds(std::micro::den/fps));
+    needsConfig = true;
+    return true;
+}
+
+void VideoEncoderPlugin::initializeEventMap()
+{
+    eventMap["configure"] = std::bind(&VideoEncoderPlugin::configEvent, this, std::placeholders::_1);
+    eventMap["forceIntra"] = std::bind(&VideoEncoderPlugin::forceIntraEvent, this, std::placeholders::_1);
+}
+
+bool VideoEncoderPlugin::configEvent(Jzon::Node* params)
+{
+    unsigned tmpBitrate = config.bitrate;
+    unsigned tmpFps = config.fps;
+    unsigned tmpGop = config.gop;
+    unsigned tmpThreads = config.threads;
+
+    if (!params) {
+        return false;
+    }
+
+    if (params->Has("bitrate")) {
+        tmpBitrate = params->Get("bitrate").ToInt();
+    }
+
+    if (params->Has("fps")) {
+        tmpFps = params->Get("fps").ToInt();
+    }
+
+    if (params->Has("gop")) {
+        tmpGop = params->Get("gop").ToInt();
+    }
+
+    if (params->Has("threads")) {
+        tmpThreads = params->Get("threads").ToInt();
+    }
+
+    return configure0(tmpBitrate, tmpFps, tmpGop, tmpThreads);
+}
+
+bool VideoEncoderPlugin::forceIntraEvent(Jzon::Node*)
+{
+    forceKey = true;
+    return true;
+}
+
+void VideoEncoderPlugin::doGetState(Jzon::Object &filterNode)
+{
+    Jzon::Object capsNode;
+
+    capsNode.Add("codec", utils::getVideoCodecAsString(caps.codec));
+    capsNode.Add("rateReconfig", caps.rateReconfig);
+    capsNode.Add("forceKeyframe", caps.forceKeyframe);
+    capsNode.Add("maxThreads", (int) caps.maxThreads);
+
+    filterNode.Add("backend", backend->getName());
+    filterNode.Add("capabilities", capsNode);
+    filterNode.Add("bitrate", (int) config.bitrate);
+    filterNode.Add("fps", (int) config.fps);
+    filterNode.Add("gop", (int) config.gop);
+    filterNode.Add("threads", (int) config.threads);
+}
@@ -0,0 +1,114 @@
+/*
+ *  VideoEncoderPlugin - Video encoder filter driving an EncoderBackend
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _VIDEO_ENCODER_PLUGIN_HH
+#define _VIDEO_ENCODER_PLUGIN_HH
+
+#include <deque>
+#include <vector>
+
+#include "../../VideoFrame.hh"
+#include "../../Filter.hh"
+#include "../../StreamInfo.hh"
+#include "EncoderBackend.hh"
+#include "VideoEncoderX264or5.hh"
+
+#define DEFAULT_BACKEND "vp8"
+#define PLUGIN_MAX_DELAYED_FRAMES 128
+
+/*! Video encoder filter independent of the encoding library, which is an EncoderBackend
+    chosen by name. Input frames are submitted to the backend without copying them. Each
+    output frame holds the packets of one picture, so packets of other pictures ready after
+    a submit are kept and written to the next output frames
+*/
+class VideoEncoderPlugin : public OneToOneFilter {
+
+    public:
+        /**
+        * Creates a new encoder
+        * @param backend backend name, see EncoderBackend::createNew
+        * @return Pointer to new object if succeed of NULL if not
+        */
+        static VideoEncoderPlugin* createNew(std::string backend = DEFAULT_BACKEND);
+
+        /**
+        * Class destructor
+        */
+        ~VideoEncoderPlugin();
+
+        /**
+        * Configures the encoder
+        * @param bitrate target bitrate in kbps
+        * @param fps output frame rate
+        * @param gop maximum distance between keyframes
+        * @param threads encoding threads
+        */
+        bool configure(unsigned bitrate, unsigned fps, unsigned gop, unsigned threads);
+
+    protected:
+        VideoEncoderPlugin(EncoderBackend *backend);
+        FrameQueue *allocQueue(ConnectionData cData);
+        bool doProcessFrame(Frame *org, Frame *dst);
+        void doGetState(Jzon::Object &filterNode);
+        bool configure0(unsigned bitrate, unsigned fps, unsigned gop, unsigned threads);
+        bool reconfigure(VideoFrame *rawFrame);
+        bool writePacket(EncodedPacket const& packet, VideoFrame *codedFrame);
+
+    private:
+        void initializeEventMap();
+        bool configEvent(Jzon::Node* params);
+        bool forceIntraEvent(Jzon::Node* params);
+
+        //NOTE: There is no need of specific reader configuration
+        bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
+        bool specificReaderDelete(int /*readerID*/) {return true;};
+
+        //NOTE: There is no need of specific writer configuration
+        bool specificWriterConfig(int /*writerID*/) {return true;};
+        bool specificWriterDelete(int /*writerID*/) {return true;};
+
+        struct FrameTimeParams {
+            std::chrono::microseconds pTime;
+            std::chrono::system_clock::time_point oTime;
+            size_t seqNum;
+        };
+
+        EncoderBackend      *backend;
+        EncoderCapabilities caps;
+        EncoderConfig       config;
+        StreamInfo          *outputStreamInfo;
+        //Coded packets copied from the backend, as they are only valid until the next submit
+        struct PendingPacket {
+            std::vector<unsigned char> data;
+            int64_t pts;
+            bool key;
+        };
+
+        FrameTimeParams     frameTimes[PLUGIN_MAX_DELAYED_FRAMES];
+        std::deque<PendingPacket> pendingPackets;
+        int64_t             pts;
+        bool                needsConfig;
+        bool                needsRateConfig;
+        bool                forceKey;
+};
+
+#endif
@@ -22,30 +22,60 @@
  */
 
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include "VideoEncoderX264.hh"
 #include "../../SlicedVideoFrameQueue.hh"
 
 #define MAX_PLANES_PER_PICTURE 4
 
 VideoEncoderX264::VideoEncoderX264() :
-VideoEncoderX264or5(), encoder(NULL)
+VideoEncoderX264or5(), encoder(NULL), lowLatency(false), encoderLowLatency(false), 
+sliceMaxSize(DEFAULT_SLICE_MAX_SIZE), outputQueue(NULL), nextMb(0), asyncFront(0), asyncCount(0),
+async(false), runAsync(false), asyncLastPts(0), encoderThreads(0)
 {
-    pts = 0;
     outputStreamInfo->video.codec = H264;
     x264_picture_init(&picIn);
     x264_picture_init(&picOut);
+    x264_picture_init(&asyncOut);
+
+    for (unsigned i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        x264_picture_init(&asyncPics[i].pic);
+        asyncPics[i].width = 0;
+        asyncPics[i].height = 0;
+        asyncPics[i].csp = X264_CSP_NONE;
+    }
+
+    asyncTimes = InterleavedVideoFrame::createNew(H264, 0);
+    initializeEventMap();
 }
 
 VideoEncoderX264::~VideoEncoderX264()
 {
+    stopAsync();
+
+    for (unsigned i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (asyncPics[i].width > 0) {
+            x264_picture_clean(&asyncPics[i].pic);
+        }
+    }
+
+    delete asyncTimes;
+
     if (encoder != NULL){
         x264_encoder_close(encoder);
         encoder = NULL;
     }
 }
 
-bool VideoEncoderX264::fillPicturePlanes(unsigned char** data, int* linesize)
+bool VideoEncoderX264::fillPicturePlanes(unsigned char** data, int* linesize, int planes)
 {
+    if (planes > MAX_PLANES_PER_PICTURE) {
+        return false;
+    }
+
+    picIn.img.i_plane = planes;
+
     for(int i = 0; i < MAX_PLANES_PER_PICTURE; i++){
         picIn.img.i_stride[i] = linesize[i];
         picIn.img.plane[i] = data[i];
@@ -68,25 +98,49 @@ bool VideoEncoderX264::encodeFrame(VideoFrame* codedFrame)
         return false;
     }
 
-    if (forceIntra) {
-        picIn.i_type = X264_TYPE_I;
-        forceIntra = false;
-    } else {
-        picIn.i_type = X264_TYPE_AUTO;
+    if (async && !lowLatency) {
+        return submitFrame();
     }
 
+    //Pictures submitted before disabling the asynchronous mode are coded first
+    stopAsync();
+
+    picIn.i_type = nextPictureType();
     picIn.i_pts = pts;
+    picIn.opaque = this;
+
+    if (lowLatency) {
+        std::lock_guard<std::mutex> guard(sliceMtx);
+        pendingSlices.clear();
+        nextMb = 0;
+    }
+
+    std::lock_guard<std::mutex> guard(encoderMtx);
     success = x264_encoder_encode(encoder, &nals, &piNal, &picIn, &picOut);
 
-    pts++;
+    //Slices are only held while a previous one is being coded, so none should remain
+    if (lowLatency) {
+        addAsyncFrames([this]{return publishPendingSlices();});
+    }
 
+    //Frames delayed by the lookahead or B-frames are returned by later calls
     if (success == 0) {
-        return false;
+        return true;
     } else if (success < 0) {
         utils::errorMsg("X264 Encoder: Could not encode video frame");
         return false;
     }
 
+    if (!setOutputTimes(codedFrame, picOut.i_pts, picOut.i_dts)) {
+        return false;
+    }
+
+    //NALs have already been published by naluProcess
+    if (lowLatency) {
+        codedFrame->setConsumed(true);
+        return true;
+    }
+
     for (int i = 0; i < piNal; i++) {
 
         if (!slicedFrame->setSlice(nals[i].p_payload, nals[i].i_payload)) {
@@ -95,95 +149,409 @@ bool VideoEncoderX264::encodeFrame(VideoFrame* codedFrame)
         }
     }
 
+    codedFrame->setConsumed(true);
+    return true;
+}
+
+int VideoEncoderX264::nextPictureType()
+{
+    if (forceKeyframe) {
+        //Segments must start with an IDR, also in low latency mode
+        forceKeyframe = false;
+        forceIntra = false;
+        return X264_TYPE_IDR;
+    }
+
+    if (forceIntra && lowLatency) {
+        //The refresh wave is restarted instead of coding a whole intra frame
+        x264_encoder_intra_refresh(encoder);
+        forceIntra = false;
+        return X264_TYPE_AUTO;
+    }
+
+    if (forceIntra) {
+        forceIntra = false;
+        return X264_TYPE_I;
+    }
+
+    return X264_TYPE_AUTO;
+}
+
+bool VideoEncoderX264::submitFrame()
+{
+    AsyncPicture *slot;
+
+    {
+        std::lock_guard<std::mutex> guard(asyncMtx);
+
+        if (asyncCount == ASYNC_QUEUE_SIZE) {
+            utils::warningMsg("X264 Encoder: submit queue full, discarding frame");
+            return false;
+        }
+
+        slot = &asyncPics[(asyncFront + asyncCount) % ASYNC_QUEUE_SIZE];
+    }
+
+    //The slot is not used by the encoding thread until it is queued
+    if (!copyPicture(slot)) {
+        return false;
+    }
+
+    slot->pic.i_type = nextPictureType();
+    slot->pic.i_pts = pts;
+    slot->times = getFrameTimes(pts);
+
+    {
+        std::lock_guard<std::mutex> guard(asyncMtx);
+        asyncCount++;
+
+        if (!asyncThread.joinable()) {
+            runAsync = true;
+            asyncThread = std::thread(&VideoEncoderX264::encodeLoop, this);
+        }
+    }
+
+    asyncCheck.notify_one();
     return true;
 }
 
+bool VideoEncoderX264::copyPicture(AsyncPicture *slot)
+{
+    int width = xparams.i_width;
+    int height = xparams.i_height;
+    int csp = picIn.img.i_csp;
+    int planeWidth;
+    int planeHeight;
+
+    if (slot->width != width || slot->height != height || slot->csp != csp) {
+        if (slot->width > 0) {
+            x264_picture_clean(&slot->pic);
+            slot->width = 0;
+        }
+
+        if (x264_picture_alloc(&slot->pic, csp, width, height) < 0) {
+            utils::errorMsg("X264 Encoder: could not allocate submitted picture");
+            return false;
+        }
+
+        slot->width = width;
+        slot->height = height;
+        slot->csp = csp;
+    }
+
+    for (int p = 0; p < picIn.img.i_plane; p++) {
+        planeWidth = p == 0 || csp == X264_CSP_I444 ? width : (width + 1)/2;
+        planeHeight = p == 0 || csp != X264_CSP_I420 ? height : (height + 1)/2;
+
+        for (int y = 0; y < planeHeight; y++) {
+            memcpy(slot->pic.img.plane[p] + y*slot->pic.img.i_stride[p],
+                   picIn.img.plane[p] + y*picIn.img.i_stride[p], planeWidth);
+        }
+    }
+
+    return true;
+}
+
+void VideoEncoderX264::encodeLoop()
+{
+    int success;
+    int piNal;
+    x264_nal_t* nals;
+    x264_picture_t *pic;
+    std::unique_lock<std::mutex> lock(asyncMtx);
+
+    while (true) {
+        asyncCheck.wait(lock, [this]{return !runAsync || asyncCount > 0;});
+
+        //Submitted pictures are encoded before stopping
+        if (asyncCount == 0) {
+            break;
+        }
+
+        pic = &asyncPics[asyncFront].pic;
+        lock.unlock();
+
+        //Times travel with the queued picture, as the filter thread keeps writing its own ones
+        asyncFrameTimes[pic->i_pts % MAX_DELAYED_FRAMES] = asyncPics[asyncFront].times;
+        asyncLastPts = pic->i_pts;
+
+        {
+            std::lock_guard<std::mutex> guard(encoderMtx);
+            success = encoder ? x264_encoder_encode(encoder, &nals, &piNal, pic, &asyncOut) : -1;
+
+            //Readers are woken up right away, also for the last frames when the input stops
+            if (success < 0) {
+                utils::errorMsg("X264 Encoder: Could not encode video frame");
+            } else if (success > 0) {
+                addAsyncFrames([this, nals, piNal]{return completeFrame(nals, piNal);});
+            }
+        }
+
+        lock.lock();
+        asyncFront = (asyncFront + 1) % ASYNC_QUEUE_SIZE;
+        asyncCount--;
+    }
+}
+
+bool VideoEncoderX264::completeFrame(x264_nal_t *nals, int piNal)
+{
+    std::lock_guard<std::mutex> guard(sliceMtx);
+
+    if (!setOutputTimes(asyncTimes, asyncOut.i_pts, asyncOut.i_dts, asyncFrameTimes, asyncLastPts)) {
+        return false;
+    }
+
+    for (int i = 0; i < piNal; i++) {
+        publishSlice(nals[i].p_payload, nals[i].i_payload, asyncTimes);
+    }
+
+    return true;
+}
+
+void VideoEncoderX264::stopAsync()
+{
+    //The encoding thread is only started and stopped by the filter thread
+    if (!asyncThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(asyncMtx);
+        runAsync = false;
+    }
+
+    asyncCheck.notify_all();
+
+    if (asyncThread.joinable()) {
+        asyncThread.join();
+    }
+}
+
 bool VideoEncoderX264::encodeHeadersFrame()
 {
     int encodeSize;
     int piNal;
     x264_nal_t* nals;
+    x264_param_t headerParams;
+    x264_t* headerEncoder;
+
+    if (!xparams.nalu_process) {
+        encodeSize = x264_encoder_headers(encoder, &nals, &piNal);
+
+        if (encodeSize < 0) {
+            utils::errorMsg("Could not encode headers");
+            return false;
+        }
+
+        outputStreamInfo->setExtraData(nals[0].p_payload, encodeSize);
+        return true;
+    }
+
+    //Header NALs would also be reported to naluProcess, out of any picture. They only
+    //depend on the parameters, so they are taken from an encoder without the callback
+    headerParams = xparams;
+    headerParams.nalu_process = NULL;
+    headerEncoder = x264_encoder_open(&headerParams);
+
+    if (!headerEncoder) {
+        utils::errorMsg("Could not open x264 encoder to encode headers");
+        return false;
+    }
 
-    encodeSize = x264_encoder_headers(encoder, &nals, &piNal);
+    encodeSize = x264_encoder_headers(headerEncoder, &nals, &piNal);
+
+    if (encodeSize >= 0) {
+        outputStreamInfo->setExtraData(nals[0].p_payload, encodeSize);
+    }
+
+    x264_encoder_close(headerEncoder);
 
     if (encodeSize < 0) {
         utils::errorMsg("Could not encode headers");
         return false;
     }
-       
-    outputStreamInfo->setExtraData(nals[0].p_payload, encodeSize);
 
     return true;
 }
 
+void VideoEncoderX264::naluProcess(x264_t *h, x264_nal_t *nal, void *opaque)
+{
+    VideoEncoderX264 *enc = static_cast<VideoEncoderX264*>(opaque);
+
+    if (enc) {
+        enc->publishNal(h, nal);
+    }
+}
+
+void VideoEncoderX264::publishNal(x264_t *h, x264_nal_t *nal)
+{
+    //NOTE: x264 requires at least this room to escape and encapsulate the NAL
+    std::vector<unsigned char> buffer(nal->i_payload*3/2 + 5 + 64);
+
+    x264_nal_encode(h, buffer.data(), nal);
+    buffer.resize(nal->i_payload);
+
+    //Readers are woken up for each slice, so that it is sent while the next ones are coded
+    addAsyncFrames([this, nal, &buffer]{return orderSlice(nal, buffer);});
+}
+
+bool VideoEncoderX264::orderSlice(x264_nal_t *nal, std::vector<unsigned char> &buffer)
+{
+    std::lock_guard<std::mutex> guard(sliceMtx);
+
+    //Non VCL units are written by the encoding thread before the slices, so they are already in order
+    if ((nal->i_type != NAL_SLICE && nal->i_type != NAL_SLICE_IDR) || nal->i_first_mb < nextMb) {
+        publishSlice(buffer.data(), buffer.size());
+        return true;
+    }
+
+    //Sliced threads may finish out of order, but slices must be sent in decoding order
+    if (nal->i_first_mb > nextMb) {
+        pendingSlices[nal->i_first_mb].lastMb = nal->i_last_mb;
+        pendingSlices[nal->i_first_mb].data.swap(buffer);
+        return false;
+    }
+
+    publishSlice(buffer.data(), buffer.size());
+    nextMb = nal->i_last_mb + 1;
+
+    while (!pendingSlices.empty() && pendingSlices.begin()->first == nextMb) {
+        publishSlice(pendingSlices.begin()->second.data.data(), pendingSlices.begin()->second.data.size());
+        nextMb = pendingSlices.begin()->second.lastMb + 1;
+        pendingSlices.erase(pendingSlices.begin());
+    }
+
+    return true;
+}
+
+bool VideoEncoderX264::publishPendingSlices()
+{
+    std::lock_guard<std::mutex> guard(sliceMtx);
+    bool published = !pendingSlices.empty();
+
+    for (auto &it : pendingSlices) {
+        publishSlice(it.second.data.data(), it.second.data.size());
+    }
+
+    pendingSlices.clear();
+    return published;
+}
+
+void VideoEncoderX264::publishSlice(unsigned char *data, unsigned size, VideoFrame *times)
+{
+    if (!outputQueue) {
+        return;
+    }
+
+    if (!outputQueue->pushSlice(data, size, times)) {
+        utils::warningMsg("X264 Encoder: could not publish slice");
+    }
+}
+
 FrameQueue* VideoEncoderX264::allocQueue(ConnectionData cData)
 {
-    return SlicedVideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+    SlicedVideoFrameQueue *queue;
+
+    queue = SlicedVideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_VIDEO_FRAMES, MAX_H264_OR_5_NAL_SIZE);
+
+    std::lock_guard<std::mutex> guard(sliceMtx);
+    outputQueue = queue;
+    return queue;
+}
+
+bool VideoEncoderX264::specificWriterDelete(int /*writerID*/)
+{
+    std::lock_guard<std::mutex> guard(sliceMtx);
+    outputQueue = NULL;
+    return true;
 }
 
 bool VideoEncoderX264::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
 {
     int colorspace;
+    x264_param_t openParams;
 
     if (!needsConfig && orgFrame->getWidth() == xparams.i_width &&
         orgFrame->getHeight() == xparams.i_height && orgFrame->getPixelFormat() == inPixFmt) {
         return true;
     }
 
+    //Parameters are shared with the encoding thread, which codes the submitted pictures and
+    //stops while they change. It is started again by the next submitted picture
+    stopAsync();
+    std::lock_guard<std::mutex> guard(encoderMtx);
+
     inPixFmt = orgFrame->getPixelFormat();
     switch (inPixFmt) {
         case YUV420P:
-            libavInPixFmt = AV_PIX_FMT_YUV420P;
             colorspace = X264_CSP_I420;
             break;
         case YUV422P:
-            libavInPixFmt = AV_PIX_FMT_YUV422P;
             colorspace = X264_CSP_I422;
             break;
         case YUV444P:
-            libavInPixFmt = AV_PIX_FMT_YUV444P;
             colorspace = X264_CSP_I444;
             break;
         default:
             utils::errorMsg("Uncompatibe input pixel format");
-            libavInPixFmt = AV_PIX_FMT_NONE;
             colorspace = X264_CSP_NONE;
             return false;
             break;
     }
 
     picIn.img.i_csp = colorspace;
-    x264_param_default_preset(&xparams, preset.c_str(), NULL);
+
+    //The preset resets every parameter, so the ones the encoder was opened with are kept to compare
+    openParams = xparams;
+    x264_param_default_preset(&xparams, preset.c_str(), lowLatency ? "zerolatency" : NULL);
     x264_param_apply_profile(&xparams, "high");
 
-    x264_param_parse(&xparams, "keyint", std::to_string(gop).c_str());
+    x264_param_parse(&xparams, "keyint", keyScheduler.isEnabled() ? "infinite" : std::to_string(gop).c_str());
     x264_param_parse(&xparams, "fps", std::to_string(fps).c_str());
-    x264_param_parse(&xparams, "intra-refresh", std::to_string(0).c_str());
     x264_param_parse(&xparams, "threads", std::to_string(threads).c_str());
     x264_param_parse(&xparams, "aud", std::to_string(1).c_str());
     x264_param_parse(&xparams, "bitrate", std::to_string(bitrate).c_str());
-    x264_param_parse(&xparams, "bframes", std::to_string(0).c_str());
+    //Reordering delays frames, so B-frames are not used in low latency mode
+    x264_param_parse(&xparams, "bframes", std::to_string(lowLatency ? 0 : bframes).c_str());
     x264_param_parse(&xparams, "repeat-headers", std::to_string(0).c_str());
-    x264_param_parse(&xparams, "vbv-maxrate", std::to_string(bitrate*1.05).c_str());
-    x264_param_parse(&xparams, "vbv-bufsize", std::to_string(bitrate*2).c_str());
-    x264_param_parse(&xparams, "rc-lookahead", std::to_string(lookahead).c_str());
+    x264_param_parse(&xparams, "vbv-maxrate", std::to_string(getVbvMaxrate()).c_str());
     x264_param_parse(&xparams, "scenecut", std::to_string(0).c_str());
 
+    if (lowLatency) {
+        //Keyframes are spread over the GOP, so a one frame VBV buffer does not starve them
+        x264_param_parse(&xparams, "intra-refresh", std::to_string(1).c_str());
+        x264_param_parse(&xparams, "sliced-threads", std::to_string(1).c_str());
+        x264_param_parse(&xparams, "sync-lookahead", std::to_string(0).c_str());
+        x264_param_parse(&xparams, "rc-lookahead", std::to_string(0).c_str());
+        x264_param_parse(&xparams, "slice-max-size", std::to_string(sliceMaxSize).c_str());
+        xparams.nalu_process = naluProcess;
+    } else {
+        x264_param_parse(&xparams, "intra-refresh", std::to_string(0).c_str());
+        x264_param_parse(&xparams, "rc-lookahead", std::to_string(lookahead).c_str());
+    }
+
+    x264_param_parse(&xparams, "vbv-bufsize", std::to_string(getVbvBufsize()).c_str());
+
     if (outputStreamInfo->video.h264or5.annexb) {
         x264_param_parse(&xparams, "repeat-headers", std::to_string(1).c_str());
         x264_param_parse(&xparams, "annexb", std::to_string(1).c_str());
     }
 
-    if (orgFrame->getWidth() != xparams.i_width || orgFrame->getHeight() != xparams.i_height) {
-        xparams.i_width = orgFrame->getWidth();
-        xparams.i_height = orgFrame->getHeight();
+    xparams.i_width = orgFrame->getWidth();
+    xparams.i_height = orgFrame->getHeight();
+    asyncTimes->setSize(xparams.i_width, xparams.i_height);
 
-        if (encoder != NULL){
-            x264_encoder_close(encoder);
-            encoder = NULL;
-        }
+    //x264_encoder_reconfig ignores the size, threading, lookahead and B-frames, so changing them
+    //or switching profile reopens the encoder, which restarts with an IDR
+    if (encoder != NULL && (xparams.i_width != openParams.i_width || xparams.i_height != openParams.i_height ||
+        xparams.i_threads != openParams.i_threads || xparams.rc.i_lookahead != openParams.rc.i_lookahead ||
+        xparams.i_bframe != openParams.i_bframe || lowLatency != encoderLowLatency)) {
+        x264_encoder_close(encoder);
+        encoder = NULL;
     }
 
+    encoderLowLatency = lowLatency;
+
     if (!encoder) {
         encoder = x264_encoder_open(&xparams);
     } else if (x264_encoder_reconfig(encoder, &xparams) < 0) {
@@ -194,11 +562,155 @@ bool VideoEncoderX264::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
 
     if (!encoder) {
         utils::errorMsg("Error reconfiguring x264 encoder. At this point encoder should not be NULL...");
+        encoderThreads = 0;
         return false;
     }
 
+    x264_encoder_parameters(encoder, &openParams);
+    encoderThreads = openParams.i_threads;
+
     needsConfig = false;
+    needsRateConfig = false;
    
     return encodeHeadersFrame();
 
 }
+
+bool VideoEncoderX264::reconfigureRate()
+{
+    x264_param_t rateParams;
+
+    needsRateConfig = false;
+
+    if (!encoder) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(encoderMtx);
+
+    //Only rate control fields change, x264 applies them from the next frame
+    rateParams = xparams;
+    rateParams.rc.i_bitrate = bitrate;
+    rateParams.rc.i_vbv_max_bitrate = getVbvMaxrate();
+    rateParams.rc.i_vbv_buffer_size = getVbvBufsize();
+
+    if (x264_encoder_reconfig(encoder, &rateParams) < 0) {
+        utils::errorMsg("Could not reconfigure x264 rate control, keeping the previous one");
+        bitrate = xparams.rc.i_bitrate;
+        vbvMaxrate = xparams.rc.i_vbv_max_bitrate;
+        vbvBufsize = xparams.rc.i_vbv_buffer_size;
+        return false;
+    }
+
+    xparams = rateParams;
+    return true;
+}
+
+unsigned VideoEncoderX264::getVbvBufsize()
+{
+    //One frame buffer, as keyframes are spread by the intra refresh
+    if (lowLatency && vbvBufsize == 0) {
+        return std::max(bitrate/fps, 1U);
+    }
+
+    return VideoEncoderX264or5::getVbvBufsize();
+}
+
+bool VideoEncoderX264::setLowLatency(bool enable, unsigned sliceMaxSize_)
+{
+    if (sliceMaxSize_ < MIN_SLICE_MAX_SIZE || sliceMaxSize_ > MAX_H264_OR_5_NAL_SIZE) {
+        utils::errorMsg("[VideoEncoderX264] Invalid slice max size " + std::to_string(sliceMaxSize_));
+        return false;
+    }
+
+    //Slices are published while encoding in the filter thread, so submitted pictures are coded
+    //first. Events hold the filter lock, which the encoding thread takes to wake the readers up,
+    //so it is stopped by the reconfiguration instead of here
+    lowLatency = enable;
+    sliceMaxSize = sliceMaxSize_;
+    needsConfig = true;
+    return true;
+}
+
+bool VideoEncoderX264::configLowLatencyEvent(Jzon::Node* params)
+{
+    unsigned tmpSliceMaxSize = sliceMaxSize;
+
+    if (!params) {
+        return false;
+    }
+
+    if (!params->Has("enable")) {
+        return false;
+    }
+
+    if (params->Has("sliceMaxSize")) {
+        tmpSliceMaxSize = params->Get("sliceMaxSize").ToInt();
+    }
+
+    return setLowLatency(params->Get("enable").ToBool(), tmpSliceMaxSize);
+}
+
+bool VideoEncoderX264::configLowLatency(bool enable, unsigned sliceMaxSize)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configLowLatency");
+    params.Add("enable", enable);
+    params.Add("sliceMaxSize", (int) sliceMaxSize);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool VideoEncoderX264::setAsync(bool enable)
+{
+    if (enable && lowLatency) {
+        utils::warningMsg("[VideoEncoderX264] Asynchronous mode does not apply in low latency mode");
+    }
+
+    //The encoding thread is stopped by the next synchronous frame, after coding the submitted ones
+    async = enable;
+    return true;
+}
+
+bool VideoEncoderX264::configAsyncEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("enable")) {
+        return false;
+    }
+
+    return setAsync(params->Get("enable").ToBool());
+}
+
+bool VideoEncoderX264::configAsync(bool enable)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configAsync");
+    params.Add("enable", enable);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+void VideoEncoderX264::initializeEventMap()
+{
+    eventMap["configLowLatency"] = std::bind(&VideoEncoderX264::configLowLatencyEvent, this, std::placeholders::_1);
+    eventMap["configAsync"] = std::bind(&VideoEncoderX264::configAsyncEvent, this, std::placeholders::_1);
+}
+
+void VideoEncoderX264::doGetState(Jzon::Object &filterNode)
+{
+    VideoEncoderX264or5::doGetState(filterNode);
+    filterNode.Add("lowLatency", lowLatency);
+    filterNode.Add("sliceMaxSize", (int) sliceMaxSize);
+    filterNode.Add("async", async);
+
+    //Threads of the running encoder, which follow the configured ones at the next frame
+    if (encoderThreads > 0) {
+        filterNode.Add("encoderThreads", (int) encoderThreads);
+    }
+}
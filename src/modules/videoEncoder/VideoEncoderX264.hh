@@ -32,31 +32,130 @@
 #include "../../Filter.hh"
 #include "../../FrameQueue.hh"
 #include "../../Types.hh"
+#include "../../SlicedVideoFrameQueue.hh"
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 
 extern "C" {
 #include <x264.h>
 }
 
+#define DEFAULT_SLICE_MAX_SIZE 1400 //bytes, fits in a default live555 RTP packet (1456 bytes)
+#define MIN_SLICE_MAX_SIZE 256
+#define ASYNC_QUEUE_SIZE 8 //pictures submitted and not yet taken by the encoding thread
+
 class VideoEncoderX264 : public VideoEncoderX264or5 {
 
 public:
     VideoEncoderX264();
     ~VideoEncoderX264();
 
+    /**
+    * Configures the low latency (zerolatency) profile. Keyframes are replaced by a periodic
+    * intra refresh, the encoder does not buffer frames and each frame is coded in slices by
+    * parallel threads. Slices are published to the output queue as soon as they are coded and
+    * the readers are woken up for each of them.
+    * @param enable true to use the low latency profile
+    * @param sliceMaxSize maximum slice size in bytes, to be matched with the transport MTU
+    * @return always true
+    */
+    bool configLowLatency(bool enable, unsigned sliceMaxSize = DEFAULT_SLICE_MAX_SIZE);
+
+    /**
+    * Configures the asynchronous mode. Pictures are copied to a submit queue and coded by an
+    * encoder own thread, which publishes the NALs to the output queue and wakes the readers up
+    * when x264 returns them, so that pool workers do not wait for the encoding. Pictures are
+    * discarded when the submit queue is full. It does not apply in low latency mode.
+    * @param enable true to encode asynchronously
+    * @return always true
+    */
+    bool configAsync(bool enable);
+
+protected:
+    bool setLowLatency(bool enable, unsigned sliceMaxSize);
+    bool setAsync(bool enable);
+    void doGetState(Jzon::Object &filterNode);
+
+    //Taken while calling x264, which may be done by the filter and the encoding threads.
+    //Coded frames are published holding it, so the filter lock must not be held to take it
+    std::mutex encoderMtx;
+
 private:
     FrameQueue* allocQueue(ConnectionData cData);
     void initializeEventMap();
+    bool configLowLatencyEvent(Jzon::Node* params);
+    bool configAsyncEvent(Jzon::Node* params);
+    bool specificWriterDelete(int writerID);
+
+    static void naluProcess(x264_t *h, x264_nal_t *nal, void *opaque);
+    void publishNal(x264_t *h, x264_nal_t *nal);
+    bool orderSlice(x264_nal_t *nal, std::vector<unsigned char> &buffer);
+    bool publishPendingSlices();
+    void publishSlice(unsigned char *data, unsigned size, VideoFrame *times = NULL);
+
+    int nextPictureType();
+    bool submitFrame();
+    void encodeLoop();
+    bool completeFrame(x264_nal_t *nals, int piNal);
+    void stopAsync();
 
     x264_picture_t picIn;
     x264_picture_t picOut;
     x264_param_t xparams;
     x264_t* encoder;
 
-    int64_t pts;
+    bool lowLatency;
+    bool encoderLowLatency;
+    unsigned sliceMaxSize;
+
+    //Slices published while encoding, which may be coded out of order by sliced threads
+    struct PendingSlice {
+        int lastMb;
+        std::vector<unsigned char> data;
+    };
+
+    std::mutex sliceMtx;
+    SlicedVideoFrameQueue *outputQueue;
+    std::map<int, PendingSlice> pendingSlices;
+    int nextMb;
+
+    //Pictures owned by the submit queue, as input frames are released after doProcessFrame
+    struct AsyncPicture {
+        x264_picture_t pic;
+        FrameTimeParams times;
+        int width;
+        int height;
+        int csp;
+    };
+
+    bool copyPicture(AsyncPicture *slot);
+
+    std::mutex asyncMtx;
+    std::condition_variable asyncCheck;
+    std::thread asyncThread;
+    AsyncPicture asyncPics[ASYNC_QUEUE_SIZE];
+    unsigned asyncFront;
+    unsigned asyncCount;
+    bool async;
+    bool runAsync;
+    x264_picture_t asyncOut;
+    //Owned by the encoding thread: times of the pictures inside the encoder and of the frame being published
+    FrameTimeParams asyncFrameTimes[MAX_DELAYED_FRAMES];
+    int64_t asyncLastPts;
+    VideoFrame *asyncTimes;
+    //Threads of the running encoder, reported by getState
+    std::atomic<int> encoderThreads;
 
-    bool fillPicturePlanes(unsigned char** data, int* linesize);
+    bool fillPicturePlanes(unsigned char** data, int* linesize, int planes);
     bool encodeFrame(VideoFrame* codedFrame);
     bool reconfigure(VideoFrame *orgFrame, VideoFrame* dstFrame);
+    bool reconfigureRate();
+    unsigned getVbvBufsize();
     bool encodeHeadersFrame();
 };
 
@@ -24,27 +24,25 @@
 #include "VideoEncoderX264or5.hh"
 
 VideoEncoderX264or5::VideoEncoderX264or5() :
-OneToOneFilter(), inPixFmt(P_NONE), forceIntra(false), fps(0), bitrate(0), gop(0), threads(0), needsConfig(false)
+OneToOneFilter(), inPixFmt(P_NONE), forceIntra(false), forceKeyframe(false), fps(0), bitrate(0), gop(0), threads(0), bframes(0), 
+vbvMaxrate(0), vbvBufsize(0), needsConfig(false), needsRateConfig(false), pendingThreads(0), pts(0)
 {
     fType = VIDEO_ENCODER;
-    midFrame = av_frame_alloc();
     outputStreamInfo = new StreamInfo(VIDEO);
     outputStreamInfo->video.h264or5.annexb = true;
     initializeEventMap();
     configure0(DEFAULT_BITRATE, VIDEO_DEFAULT_FRAMERATE, DEFAULT_GOP, 
-              DEFAULT_LOOKAHEAD, DEFAULT_THREADS, DEFAULT_ANNEXB, DEFAULT_PRESET);
+              DEFAULT_LOOKAHEAD, DEFAULT_THREADS, DEFAULT_ANNEXB, DEFAULT_PRESET, DEFAULT_BFRAMES);
 }
 
 VideoEncoderX264or5::~VideoEncoderX264or5()
 {
-    if (midFrame){
-        av_frame_free(&midFrame);
-    }
 }
 
 bool VideoEncoderX264or5::doProcessFrame(Frame *org, Frame *dst)
 {
     FrameTimeParams frameTP;
+    bool success;
     
     if (!(org && dst)) {
         utils::errorMsg("Error encoding video frame: org or dst are NULL");
@@ -59,53 +57,111 @@ bool VideoEncoderX264or5::doProcessFrame(Frame *org, Frame *dst)
         return false;
     }
 
+    if (keyScheduler.isBoundary(org->getPresentationTime())) {
+        forceKeyframe = true;
+    }
+
+    //Changing the threads reopens the encoder, which starts with an IDR. In segments mode
+    //it waits for the next segment, so that keyframes stay aligned with the other encoders
+    if (pendingThreads > 0 && (forceKeyframe || !keyScheduler.isEnabled())) {
+        threads = pendingThreads;
+        pendingThreads = 0;
+        needsConfig = true;
+    }
+
     if (!reconfigure(rawFrame, codedFrame)) {
         utils::errorMsg("Error encoding video frame: reconfigure failed");
         return false;
     }
 
+    //A failed rate change keeps the previous rate control, the encoder is never reopened for it
+    if (needsRateConfig && !reconfigureRate()) {
+        utils::warningMsg("Could not change encoder rate control");
+    }
+
     if (!fill_x264or5_picture(rawFrame)){
         utils::errorMsg("Could not fill x264_picture_t from frame");
         return false;
     }
     
-    /*NOTE: lookahead is multiplied by 2 beacuse the buffered frames might be 
-    * higher than lookahead plus the threads number depending on the configuration. 
-    */
-    if (qFTP.size() == 0 || qFTP.size() <= (lookahead + threads)* 2){
-        frameTP.pTime = org->getPresentationTime();
-        frameTP.oTime = org->getOriginTime();
-        frameTP.seqNum = org->getSequenceNumber();
-        qFTP.push(frameTP);
-    }
-    
-    if (!encodeFrame(codedFrame)) {
+    frameTP.pTime = org->getPresentationTime();
+    frameTP.oTime = org->getOriginTime();
+    frameTP.seqNum = org->getSequenceNumber();
+    frameTimes[pts % MAX_DELAYED_FRAMES] = frameTP;
+
+    //Coded frame is described before encoding it, as slices may be published while encoding.
+    //Slices are only published in low latency mode, where frames are not delayed nor reordered
+    codedFrame->setSize(rawFrame->getWidth(), rawFrame->getHeight());
+    dst->setPresentationTime(frameTP.pTime);
+    dst->setOriginTime(frameTP.oTime);
+    dst->setSequenceNumber(frameTP.seqNum);
+
+    success = encodeFrame(codedFrame);
+    pts++;
+
+    if (!success) {
         utils::warningMsg("Could not encode video frame");
         return false;
     }
 
-    codedFrame->setSize(rawFrame->getWidth(), rawFrame->getHeight());
-    
-    dst->setConsumed(true);
-    dst->setPresentationTime(qFTP.front().pTime);
-    dst->setOriginTime(qFTP.front().oTime);
-    dst->setSequenceNumber(qFTP.front().seqNum);
-    
-    qFTP.pop();
-    
+    //Frames still inside the encoder (lookahead, reordering or asynchronous encoding) are not errors
+    return dst->getConsumed();
+}
+
+bool VideoEncoderX264or5::setOutputTimes(VideoFrame* codedFrame, int64_t outPts, int64_t outDts)
+{
+    return setOutputTimes(codedFrame, outPts, outDts, frameTimes, pts);
+}
+
+bool VideoEncoderX264or5::setOutputTimes(VideoFrame* codedFrame, int64_t outPts, int64_t outDts,
+                                         FrameTimeParams const* timesArray, int64_t lastPts)
+{
+    std::chrono::microseconds dTime;
+
+    if (outPts < 0 || outPts > lastPts || lastPts - outPts >= MAX_DELAYED_FRAMES) {
+        utils::errorMsg("Coded frame pts out of the encoder delay " + std::to_string(outPts));
+        return false;
+    }
+
+    FrameTimeParams const& times = timesArray[outPts % MAX_DELAYED_FRAMES];
+
+    //Input pts are frame counters, so the decode time of the first reordered frames,
+    //which is negative, is extrapolated with the frame period
+    if (outDts >= 0 && lastPts - outDts < MAX_DELAYED_FRAMES) {
+        dTime = timesArray[outDts % MAX_DELAYED_FRAMES].pTime;
+    } else {
+        dTime = times.pTime - (outPts - outDts) * 
+            std::chrono::microseconds(std::micro::den/(fps > 0 ? fps : VIDEO_DEFAULT_FRAMERATE));
+    }
+
+    codedFrame->setPresentationTime(times.pTime);
+    codedFrame->setDecodeTime(dTime);
+    codedFrame->setOriginTime(times.oTime);
+    codedFrame->setSequenceNumber(times.seqNum);
     return true;
 }
 
 bool VideoEncoderX264or5::fill_x264or5_picture(VideoFrame* videoFrame)
 {
-    if (avpicture_fill((AVPicture *) midFrame, videoFrame->getDataBuf(),
-            (AVPixelFormat) libavInPixFmt, videoFrame->getWidth(),
-            videoFrame->getHeight()) <= 0){
-        utils::errorMsg("Could not feed AVFrame");
+    unsigned char *planes[MAX_PLANES];
+    int strides[MAX_PLANES];
+    int nPlanes;
+    InterleavedVideoFrame *rawFrame = dynamic_cast<InterleavedVideoFrame*> (videoFrame);
+
+    if (!rawFrame) {
+        utils::errorMsg("Could not feed picture: raw frames must be InterleavedVideoFrame");
+        return false;
+    }
+
+    //Planes and strides are handed to the encoder as they are, including padded planar views
+    nPlanes = rawFrame->getPlanes(planes, strides);
+
+    if (nPlanes <= 0) {
+        utils::errorMsg("Could not feed picture: unsupported pixel format");
         return false;
     }
 
-    if (!fillPicturePlanes(midFrame->data, midFrame->linesize)) {
+    if (!fillPicturePlanes(planes, strides, nPlanes)) {
         utils::errorMsg("Could not fill picture planes");
         return false;
     }
@@ -113,17 +169,31 @@ bool VideoEncoderX264or5::fill_x264or5_picture(VideoFrame* videoFrame)
     return true;
 }
 
-bool VideoEncoderX264or5::configure0(unsigned bitrate_, unsigned fps_, unsigned gop_, unsigned lookahead_, unsigned threads_, bool annexB_, std::string preset_)
+bool VideoEncoderX264or5::configure0(unsigned bitrate_, unsigned fps_, unsigned gop_, unsigned lookahead_, unsigned threads_, bool annexB_, 
+                                     std::string preset_, unsigned bframes_)
 {
-    if (bitrate_ <= 0 || gop_ <= 0 || lookahead_ < 0 || threads_ <= 0 || preset_.empty()) {
+    //Frames delayed by the lookahead and B-frames must fit in frameTimes
+    if (bitrate_ <= 0 || gop_ <= 0 || lookahead_ + bframes_ >= MAX_DELAYED_FRAMES || threads_ <= 0 || preset_.empty()) {
         utils::errorMsg("Error configuring VideoEncoderX264or5: invalid configuration values");
         return false;
     }
 
+    //Configured threads replace the ones waiting for a keyframe
+    pendingThreads = 0;
+
+    //Only the rate control changes, so the encoder is not rebuilt
+    if (fps_ > 0 && fps_ == fps && gop_ == gop && lookahead_ == lookahead && threads_ == threads &&
+        annexB_ == outputStreamInfo->video.h264or5.annexb && preset_ == preset && bframes_ == bframes) {
+        return setRate(bitrate_, 0, 0);
+    }
+
     bitrate = bitrate_;
+    vbvMaxrate = 0;
+    vbvBufsize = 0;
     gop = gop_;
     lookahead = lookahead_;
     threads = threads_;
+    bframes = bframes_;
 
     outputStreamInfo->video.h264or5.annexb = annexB_;
     preset = preset_;
@@ -140,6 +210,39 @@ bool VideoEncoderX264or5::configure0(unsigned bitrate_, unsigned fps_, unsigned
     return true;
 }
 
+bool VideoEncoderX264or5::setRate(unsigned bitrate_, unsigned vbvMaxrate_, unsigned vbvBufsize_)
+{
+    if (bitrate_ <= 0 || (vbvMaxrate_ > 0 && vbvMaxrate_ < bitrate_)) {
+        utils::errorMsg("Error configuring VideoEncoderX264or5 rate: invalid rate values");
+        return false;
+    }
+
+    bitrate = bitrate_;
+    vbvMaxrate = vbvMaxrate_;
+    vbvBufsize = vbvBufsize_;
+
+    needsRateConfig = true;
+    return true;
+}
+
+unsigned VideoEncoderX264or5::getVbvMaxrate()
+{
+    if (vbvMaxrate > 0) {
+        return vbvMaxrate;
+    }
+
+    return bitrate*VBV_MAXRATE_FACTOR;
+}
+
+unsigned VideoEncoderX264or5::getVbvBufsize()
+{
+    if (vbvBufsize > 0) {
+        return vbvBufsize;
+    }
+
+    return bitrate*VBV_BUFSIZE_FACTOR;
+}
+
 bool VideoEncoderX264or5::configEvent(Jzon::Node* params)
 {
     unsigned tmpBitrate;
@@ -147,6 +250,7 @@ bool VideoEncoderX264or5::configEvent(Jzon::Node* params)
     unsigned tmpGop;
     unsigned tmpLookahead;
     unsigned tmpThreads;
+    unsigned tmpBframes;
     bool tmpAnnexB;
     std::string tmpPreset;
 
@@ -159,6 +263,7 @@ bool VideoEncoderX264or5::configEvent(Jzon::Node* params)
     tmpGop = gop;
     tmpLookahead = lookahead;
     tmpThreads = threads;
+    tmpBframes = bframes;
     tmpAnnexB = outputStreamInfo->video.h264or5.annexb;
     tmpPreset = preset;
 
@@ -182,6 +287,10 @@ bool VideoEncoderX264or5::configEvent(Jzon::Node* params)
         tmpThreads = params->Get("threads").ToInt();
     }
 
+    if (params->Has("bframes")) {
+        tmpBframes = params->Get("bframes").ToInt();
+    }
+
     if (params->Has("annexb")) {
         tmpAnnexB = params->Get("annexb").ToBool();
     }
@@ -190,7 +299,68 @@ bool VideoEncoderX264or5::configEvent(Jzon::Node* params)
         tmpPreset = params->Get("preset").ToString();
     }
 
-    return configure0(tmpBitrate, tmpFps, tmpGop, tmpLookahead, tmpThreads, tmpAnnexB, tmpPreset);
+    return configure0(tmpBitrate, tmpFps, tmpGop, tmpLookahead, tmpThreads, tmpAnnexB, tmpPreset, tmpBframes);
+}
+
+bool VideoEncoderX264or5::configRateEvent(Jzon::Node* params)
+{
+    unsigned tmpVbvMaxrate = 0;
+    unsigned tmpVbvBufsize = 0;
+
+    if (!params || !params->Has("bitrate")) {
+        return false;
+    }
+
+    if (params->Has("vbvMaxrate")) {
+        tmpVbvMaxrate = params->Get("vbvMaxrate").ToInt();
+    }
+
+    if (params->Has("vbvBufsize")) {
+        tmpVbvBufsize = params->Get("vbvBufsize").ToInt();
+    }
+
+    return setRate(params->Get("bitrate").ToInt(), tmpVbvMaxrate, tmpVbvBufsize);
+}
+
+bool VideoEncoderX264or5::configSegmentsEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("segmentDuration")) {
+        return false;
+    }
+
+    return configSegments0(params->Get("segmentDuration").ToInt());
+}
+
+bool VideoEncoderX264or5::configSegments0(unsigned segmentDuration)
+{
+    //Encoder own keyframes are only placed out of segments mode
+    if (keyScheduler.isEnabled() != (segmentDuration > 0)) {
+        needsConfig = true;
+    }
+
+    keyScheduler.setSegmentDuration(segmentDuration);
+    return true;
+}
+
+bool VideoEncoderX264or5::configThreadsEvent(Jzon::Node* params)
+{
+    if (!params || !params->Has("threads")) {
+        return false;
+    }
+
+    return setThreads(params->Get("threads").ToInt());
+}
+
+bool VideoEncoderX264or5::setThreads(unsigned threads_)
+{
+    if (threads_ <= 0) {
+        utils::errorMsg("Error configuring VideoEncoderX264or5 threads: invalid value");
+        return false;
+    }
+
+    //Applied by the next frame that may start with an IDR
+    pendingThreads = threads_ == threads ? 0 : threads_;
+    return true;
 }
 
 bool VideoEncoderX264or5::forceIntraEvent(Jzon::Node*)
@@ -203,20 +373,28 @@ void VideoEncoderX264or5::initializeEventMap()
 {
     eventMap["forceIntra"] = std::bind(&VideoEncoderX264or5::forceIntraEvent, this, std::placeholders::_1);
     eventMap["configure"] = std::bind(&VideoEncoderX264or5::configEvent, this, std::placeholders::_1);
+    eventMap["configRate"] = std::bind(&VideoEncoderX264or5::configRateEvent, this, std::placeholders::_1);
+    eventMap["configSegments"] = std::bind(&VideoEncoderX264or5::configSegmentsEvent, this, std::placeholders::_1);
+    eventMap["configThreads"] = std::bind(&VideoEncoderX264or5::configThreadsEvent, this, std::placeholders::_1);
 }
 
 void VideoEncoderX264or5::doGetState(Jzon::Object &filterNode)
 {
     filterNode.Add("bitrate", std::to_string(bitrate));
+    filterNode.Add("vbvMaxrate", std::to_string(getVbvMaxrate()));
+    filterNode.Add("vbvBufsize", std::to_string(getVbvBufsize()));
     filterNode.Add("fps", std::to_string(fps));
     filterNode.Add("gop", std::to_string(gop));
+    filterNode.Add("segmentDuration", std::to_string(keyScheduler.getSegmentDuration()));
     filterNode.Add("lookahead", std::to_string(lookahead));
     filterNode.Add("threads", std::to_string(threads));
+    filterNode.Add("bframes", std::to_string(bframes));
     filterNode.Add("annexb", std::to_string(outputStreamInfo->video.h264or5.annexb));
     filterNode.Add("preset", preset);
 }
 
-bool VideoEncoderX264or5::configure(int bitrate, int fps, int gop, int lookahead, int threads, bool annexB, std::string preset)
+bool VideoEncoderX264or5::configure(int bitrate, int fps, int gop, int lookahead, int threads, bool annexB, std::string preset,
+                                    int bframes)
 {
     Jzon::Object root, params;
     root.Add("action", "configure");
@@ -227,6 +405,33 @@ bool VideoEncoderX264or5::configure(int bitrate, int fps, int gop, int lookahead
     params.Add("threads", threads);
     params.Add("annexb", annexB);
     params.Add("preset", preset);
+    params.Add("bframes", bframes);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool VideoEncoderX264or5::configRate(unsigned bitrate, unsigned vbvMaxrate, unsigned vbvBufsize)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configRate");
+    params.Add("bitrate", (int) bitrate);
+    params.Add("vbvMaxrate", (int) vbvMaxrate);
+    params.Add("vbvBufsize", (int) vbvBufsize);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
+
+bool VideoEncoderX264or5::configSegments(unsigned segmentDuration)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configSegments");
+    params.Add("segmentDuration", (int) segmentDuration);
     root.Add("params", params);
 
     Event e(root, std::chrono::system_clock::now(), 0);
@@ -234,3 +439,14 @@ bool VideoEncoderX264or5::configure(int bitrate, int fps, int gop, int lookahead
     return true;
 }
 
+bool VideoEncoderX264or5::configThreads(unsigned threads)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configThreads");
+    params.Add("threads", (int) threads);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e); 
+    return true;
+}
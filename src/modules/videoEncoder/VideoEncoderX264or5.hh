@@ -32,6 +32,7 @@
 #include "../../FrameQueue.hh"
 #include "../../Types.hh"
 #include "../../StreamInfo.hh"
+#include "KeyframeScheduler.hh"
 
 extern "C" {
 #include <libswscale/swscale.h>
@@ -45,6 +46,10 @@ extern "C" {
 #define DEFAULT_THREADS 4
 #define DEFAULT_ANNEXB true
 #define DEFAULT_PRESET "ultrafast"
+#define DEFAULT_BFRAMES 0
+#define MAX_DELAYED_FRAMES 512 //covers the maximum lookahead plus B-frames and frame threads
+#define VBV_MAXRATE_FACTOR 1.05 //default vbv maxrate over the bitrate
+#define VBV_BUFSIZE_FACTOR 2 //default vbv buffer size over the bitrate
 
 /*! Base class for VideoEncoderX264 and VideoEncoderX265. It implements common methods, basically configure and doProcessFrame */
 
@@ -61,38 +66,96 @@ public:
     */
     virtual ~VideoEncoderX264or5();
 
-    bool configure(int bitrate, int fps, int gop, int lookahead, int threads, bool annexB, std::string preset);
+    bool configure(int bitrate, int fps, int gop, int lookahead, int threads, bool annexB, std::string preset,
+                   int bframes = DEFAULT_BFRAMES);
+
+    /**
+    * Changes the rate control without reopening the encoder, so it can be driven by a network
+    * feedback loop. Changes are applied at the next frame boundary and pending ones are merged.
+    * @param bitrate target bitrate in kbps
+    * @param vbvMaxrate vbv maxrate in kbps, 0 for the default one
+    * @param vbvBufsize vbv buffer size in kbits, 0 for the default one
+    * @return always true
+    */
+    bool configRate(unsigned bitrate, unsigned vbvMaxrate = 0, unsigned vbvBufsize = 0);
+
+    /**
+    * Places IDR frames at the start of every segment of media time instead of every gop
+    * frames, so that encoders fed from the same source have aligned keyframes
+    * @param segmentDuration segment duration in milliseconds, 0 to go back to gop keyframes
+    * @return always true
+    */
+    bool configSegments(unsigned segmentDuration);
+
+    /**
+    * Changes the encoding threads, keeping the other parameters. Running encoders cannot change
+    * them, so the encoder is reopened and starts with an IDR. In segments mode this waits for the
+    * next segment boundary, otherwise it is done at the next frame. It is used by the pipeline
+    * thread budget.
+    * @param threads encoding threads
+    * @return always true
+    */
+    bool configThreads(unsigned threads);
     
 protected:
-    AVPixelFormat libavInPixFmt;
-    AVFrame *midFrame;
-    
     PixType inPixFmt;
     bool forceIntra;
+    bool forceKeyframe;
     unsigned fps;
     unsigned bitrate;
     unsigned gop;
     unsigned threads;
     unsigned lookahead;
+    unsigned bframes;
+    unsigned vbvMaxrate;
+    unsigned vbvBufsize;
     bool needsConfig;
+    bool needsRateConfig;
+    //Threads to apply at the next keyframe, 0 if none
+    unsigned pendingThreads;
     std::string preset;
+    int64_t pts;
+    KeyframeScheduler keyScheduler;
 
     StreamInfo *outputStreamInfo;
     
     bool doProcessFrame(Frame *org, Frame *dst);
     void initializeEventMap();      
-    virtual bool fillPicturePlanes(unsigned char** data, int* linesize) = 0;
+    virtual bool fillPicturePlanes(unsigned char** data, int* linesize, int planes) = 0;
+    //It returns false on errors only and marks codedFrame as consumed when it has been written
     virtual bool encodeFrame(VideoFrame* codedFrame) = 0;
     virtual bool reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame) = 0;
+    virtual bool reconfigureRate() = 0;
     void setIntra(){forceIntra = true;};
     bool fill_x264or5_picture(VideoFrame* videoFrame);
+    bool setOutputTimes(VideoFrame* codedFrame, int64_t outPts, int64_t outDts);
 
-    bool configure0(unsigned bitrate_, unsigned fps_, unsigned gop_, unsigned lookahead_, unsigned threads_, bool annexB_, std::string preset_);
+    struct FrameTimeParams {
+        std::chrono::microseconds pTime;
+        std::chrono::system_clock::time_point oTime;
+        size_t seqNum;
+    };
+
+    FrameTimeParams const& getFrameTimes(int64_t framePts) {return frameTimes[framePts % MAX_DELAYED_FRAMES];};
+    //Times of the frames coded out of the filter thread, indexed by their input pts up to lastPts
+    bool setOutputTimes(VideoFrame* codedFrame, int64_t outPts, int64_t outDts,
+                        FrameTimeParams const* timesArray, int64_t lastPts);
+
+    bool configure0(unsigned bitrate_, unsigned fps_, unsigned gop_, unsigned lookahead_, unsigned threads_, bool annexB_, 
+                    std::string preset_, unsigned bframes_);
+    bool setRate(unsigned bitrate_, unsigned vbvMaxrate_, unsigned vbvBufsize_);
+    bool configSegments0(unsigned segmentDuration);
+    bool setThreads(unsigned threads_);
+    unsigned getVbvMaxrate();
+    virtual unsigned getVbvBufsize();
+    void doGetState(Jzon::Object &filterNode);
     
 private:
     bool forceIntraEvent(Jzon::Node* params);
     bool configEvent(Jzon::Node* params);
-    void doGetState(Jzon::Object &filterNode);
+    bool configRateEvent(Jzon::Node* params);
+    bool configSegmentsEvent(Jzon::Node* params);
+    bool configThreadsEvent(Jzon::Node* params);
     
     //There is no need of specific reader configuration
     bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
@@ -102,13 +165,8 @@ private:
     bool specificWriterConfig(int /*writerID*/) {return true;};
     bool specificWriterDelete(int /*writerID*/) {return true;};
     
-    struct FrameTimeParams {
-        std::chrono::microseconds pTime;
-        std::chrono::system_clock::time_point oTime;
-        size_t seqNum;
-    };
-    
-    std::queue<FrameTimeParams> qFTP;
+    //Times of the frames inside the encoder, indexed by their input pts
+    FrameTimeParams frameTimes[MAX_DELAYED_FRAMES];
 };
 
 #endif
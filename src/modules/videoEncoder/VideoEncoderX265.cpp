@@ -23,6 +23,7 @@
  */
 
 #include <cmath>
+#include <algorithm>
 #include "VideoEncoderX265.hh"
 #include "../../SlicedVideoFrameQueue.hh"
 
@@ -31,7 +32,6 @@
 VideoEncoderX265::VideoEncoderX265() :
 VideoEncoderX264or5(), encoder(NULL)
 {
-    pts = 0;
     outputStreamInfo->video.codec = H265;
     xparams = x265_param_alloc();
     picIn = x265_picture_alloc();
@@ -48,8 +48,12 @@ VideoEncoderX265::~VideoEncoderX265()
     //TODO add x265_picture_clean(&x265pic) or x265_picture_free(&x265pic)?
 }
 
-bool VideoEncoderX265::fillPicturePlanes(unsigned char** data, int* linesize)
+bool VideoEncoderX265::fillPicturePlanes(unsigned char** data, int* linesize, int planes)
 {
+    if (planes > MAX_PLANES_PER_PICTURE) {
+        return false;
+    }
+
     for(int i = 0; i < MAX_PLANES_PER_PICTURE; i++){
         picIn->stride[i] = linesize[i];
         picIn->planes[i] = data[i];
@@ -72,7 +76,11 @@ bool VideoEncoderX265::encodeFrame(VideoFrame* codedFrame)
         return false;
     }
 
-    if (forceIntra) {
+    if (forceKeyframe) {
+        picIn->sliceType = X265_TYPE_IDR;
+        forceKeyframe = false;
+        forceIntra = false;
+    } else if (forceIntra) {
         picIn->sliceType = X265_TYPE_I;
         forceIntra = false;
     } else {
@@ -82,13 +90,15 @@ bool VideoEncoderX265::encodeFrame(VideoFrame* codedFrame)
     picIn->pts = pts;
     success = x265_encoder_encode(encoder, &nals, &piNal, picIn, picOut);
 
-    pts++;
-
     if (success < 0) {
         utils::errorMsg("X265 Encoder: Could not encode video frame");
         return false;
     } else if (success == 0) {
         utils::debugMsg("X265 Encoder: NAL not retrieved after encoding");
+        return true;
+    }
+
+    if (!setOutputTimes(codedFrame, picOut->pts, picOut->dts)) {
         return false;
     }
 
@@ -99,6 +109,7 @@ bool VideoEncoderX265::encodeFrame(VideoFrame* codedFrame)
         }
     }
 
+    codedFrame->setConsumed(true);
     return true;
 }
 
@@ -137,21 +148,17 @@ bool VideoEncoderX265::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
     inPixFmt = orgFrame->getPixelFormat();
     switch (inPixFmt) {
         case YUV420P:
-            libavInPixFmt = AV_PIX_FMT_YUV420P;
             colorspace = X265_CSP_I420;
             break;
         /*TODO X265_CSP_I422 not supported yet. Continue checking x265 library releases for its support.
         case YUV422P:
-            libavInPixFmt = AV_PIX_FMT_YUV422P;
             colorspace = X265_CSP_I422;
             break;*/
         case YUV444P:
-            libavInPixFmt = AV_PIX_FMT_YUV444P;
             colorspace = X265_CSP_I444;
             break;
         default:
             utils::debugMsg("Uncompatibe input pixel format");
-            libavInPixFmt = AV_PIX_FMT_NONE;
             /*TODO X265_CSP_NONE is not implemented. Continue checking x265 library releases for its support*/
             colorspace = -1;
             return false;
@@ -163,20 +170,23 @@ bool VideoEncoderX265::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
     /*TODO check with NULL profile*/
     x265_param_apply_profile(xparams, "main");
 
-    x265_param_parse(xparams, "keyint", std::to_string(gop).c_str());
+    //Segment keyframes are forced, so the encoder does not place its own ones
+    x265_param_parse(xparams, "keyint", keyScheduler.isEnabled() ? "-1" : std::to_string(gop).c_str());
     x265_param_parse(xparams, "fps", std::to_string(fps).c_str());
     x265_param_parse(xparams, "input-res", (std::to_string(orgFrame->getWidth()) + 'x' + std::to_string(orgFrame->getHeight())).c_str());
 
     //TODO check same management for intra-refresh like x264
     //x265_param_parse(xparams, "intra-refresh", std::to_string(0).c_str());
 
-    x265_param_parse(xparams, "frame-threads", std::to_string(threads).c_str());
+    //The worker pool of the encoder is limited to its threads, so that it does not take every core
+    x265_param_parse(xparams, "pools", std::to_string(threads).c_str());
+    x265_param_parse(xparams, "frame-threads", std::to_string(std::min(threads, (unsigned) X265_MAX_FRAME_THREADS)).c_str());
     x265_param_parse(xparams, "aud", std::to_string(1).c_str());
     x265_param_parse(xparams, "bitrate", std::to_string(bitrate).c_str());
-    x265_param_parse(xparams, "bframes", std::to_string(0).c_str());
+    x265_param_parse(xparams, "bframes", std::to_string(bframes).c_str());
     x265_param_parse(xparams, "repeat-headers", std::to_string(0).c_str());
-    x265_param_parse(xparams, "vbv-maxrate", std::to_string(bitrate*1.05).c_str());
-    x265_param_parse(xparams, "vbv-bufsize", std::to_string(bitrate*2).c_str());
+    x265_param_parse(xparams, "vbv-maxrate", std::to_string(getVbvMaxrate()).c_str());
+    x265_param_parse(xparams, "vbv-bufsize", std::to_string(getVbvBufsize()).c_str());
     x265_param_parse(xparams, "rc-lookahead", std::to_string(lookahead).c_str());
     x265_param_parse(xparams, "annexb", std::to_string(1).c_str());
     x265_param_parse(xparams, "scenecut", std::to_string(0).c_str());
@@ -189,7 +199,8 @@ bool VideoEncoderX265::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
     if (!encoder) {
         encoder = x265_encoder_open(xparams);
     } else {
-        /*TODO reimplement it when a reconfigure method appear*/
+        //x265_encoder_reconfig does not change the thread pools, so the threads budget needs a new encoder
+        /*TODO reimplement it for other parameters when a reconfigure method appear*/
         x265_encoder_close(encoder);
         encoder = x265_encoder_open(xparams);
     }
@@ -203,6 +214,39 @@ bool VideoEncoderX265::reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame)
     x265_picture_init(xparams, picOut);
 
     needsConfig = false;
+    needsRateConfig = false;
 
     return encodeHeadersFrame();
 }
+
+bool VideoEncoderX265::reconfigureRate()
+{
+    int prevBitrate;
+    int prevVbvMaxrate;
+    int prevVbvBufsize;
+
+    needsRateConfig = false;
+
+    if (!encoder) {
+        return false;
+    }
+
+    prevBitrate = xparams->rc.bitrate;
+    prevVbvMaxrate = xparams->rc.vbvMaxBitrate;
+    prevVbvBufsize = xparams->rc.vbvBufferSize;
+
+    //Only rate control fields change, x265 applies them from the next frame
+    xparams->rc.bitrate = bitrate;
+    xparams->rc.vbvMaxBitrate = getVbvMaxrate();
+    xparams->rc.vbvBufferSize = getVbvBufsize();
+
+    if (x265_encoder_reconfig(encoder, xparams) < 0) {
+        utils::errorMsg("Could not reconfigure x265 rate control, keeping the previous one");
+        xparams->rc.bitrate = bitrate = prevBitrate;
+        xparams->rc.vbvMaxBitrate = vbvMaxrate = prevVbvMaxrate;
+        xparams->rc.vbvBufferSize = vbvBufsize = prevVbvBufsize;
+        return false;
+    }
+
+    return true;
+}
@@ -52,11 +52,10 @@ private:
     x265_param      *xparams;
     x265_encoder*   encoder;
 
-    int64_t         pts;
-
-    bool fillPicturePlanes(unsigned char** data, int* linesize);
+    bool fillPicturePlanes(unsigned char** data, int* linesize, int planes);
     bool encodeFrame(VideoFrame* codedFrame);
     bool reconfigure(VideoFrame *orgFrame, VideoFrame* dstFrame);
+    bool reconfigureRate();
     bool encodeHeadersFrame();
 };
 
@@ -0,0 +1,369 @@
+/*
+ *  VideoLadder - Multiple rendition video resampler
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include "VideoLadder.hh"
+#include "../../AVFramedQueue.hh"
+#include "../../Utils.hh"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////
+//                 LadderRung Class              //
+///////////////////////////////////////////////////
+
+LadderRung::LadderRung() : width(0), height(0), ctx(NULL)
+{
+
+}
+
+LadderRung::~LadderRung()
+{
+    sws_freeContext(ctx);
+}
+
+void LadderRung::config(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+}
+
+///////////////////////////////////////////////////
+//               VideoLadder Class               //
+///////////////////////////////////////////////////
+
+VideoLadder* VideoLadder::createNew(PixType pixelFormat)
+{
+    if (getLibavPixFmt(pixelFormat) == AV_PIX_FMT_NONE) {
+        utils::errorMsg("[VideoLadder] Error creating VideoLadder, invalid pixel format");
+        return NULL;
+    }
+
+    return new VideoLadder(pixelFormat);
+}
+
+VideoLadder::VideoLadder(PixType pixelFormat) : OneToManyFilter()
+{
+    fType = VIDEO_LADDER;
+
+    inFrame = av_frame_alloc();
+    outFrame = av_frame_alloc();
+
+    outPixFmt = pixelFormat;
+    libavOutPixFmt = getLibavPixFmt(outPixFmt);
+    algorithm = FAST_BILINEAR;
+
+    initializeEventMap();
+}
+
+VideoLadder::~VideoLadder()
+{
+    av_frame_free(&inFrame);
+    av_frame_free(&outFrame);
+
+    for (auto it : rungs) {
+        delete it.second;
+    }
+    rungs.clear();
+
+    for (auto it : outputStreamInfos) {
+        delete it.second;
+    }
+    outputStreamInfos.clear();
+}
+
+bool VideoLadder::configRung(int id, int width, int height)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configRung");
+    params.Add("id", id);
+    params.Add("width", width);
+    params.Add("height", height);
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+bool VideoLadder::configure(PixType pixelFormat, ScalingAlgorithm algorithm)
+{
+    Jzon::Object root, params;
+    root.Add("action", "configure");
+    params.Add("pixelFormat", pixelFormat);
+    params.Add("algorithm", getScalingAlgorithmAsString(algorithm));
+    root.Add("params", params);
+
+    Event e(root, std::chrono::system_clock::now(), 0);
+    pushEvent(e);
+    return true;
+}
+
+FrameQueue* VideoLadder::allocQueue(ConnectionData cData)
+{
+    if (outputStreamInfos.count(cData.writerId) <= 0) {
+        utils::errorMsg("[VideoLadder] No stream info for writer " + std::to_string(cData.writerId));
+        return NULL;
+    }
+
+    return VideoFrameQueue::createNew(cData, outputStreamInfos[cData.writerId], DEFAULT_RAW_VIDEO_FRAMES);
+}
+
+bool VideoLadder::doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames)
+{
+    std::vector<std::pair<int, LadderRung*>> ladder;
+    VideoFrame *vFrame;
+    VideoFrame *dstFrame;
+    VideoFrame *prevFrame;
+    AVPixelFormat prevPixFmt;
+    LadderRung *rung;
+    bool processFrame = false;
+
+    vFrame = dynamic_cast<VideoFrame*>(org);
+
+    if (!vFrame) {
+        utils::errorMsg("[VideoLadder] No origin frame");
+        return false;
+    }
+
+    for (auto it : dstFrames) {
+        rung = rungs[it.first];
+
+        if (rung->getWidth() <= 0 || rung->getHeight() <= 0) {
+            utils::warningMsg("[VideoLadder] Rung not configured (Rung ID: " + std::to_string(it.first) + ")");
+            it.second->setConsumed(false);
+            continue;
+        }
+
+        ladder.push_back(std::make_pair(it.first, rung));
+    }
+
+    //Biggest renditions first, so that each one is scaled from the previous one
+    std::sort(ladder.begin(), ladder.end(),
+        [](const std::pair<int, LadderRung*> &a, const std::pair<int, LadderRung*> &b) {
+            return a.second->getWidth() * a.second->getHeight() > b.second->getWidth() * b.second->getHeight();
+        });
+
+    prevFrame = vFrame;
+    prevPixFmt = getLibavPixFmt(vFrame->getPixelFormat());
+
+    if (prevPixFmt == AV_PIX_FMT_NONE) {
+        return false;
+    }
+
+    for (auto step : ladder) {
+        rung = step.second;
+        dstFrame = dynamic_cast<VideoFrame*>(dstFrames[step.first]);
+
+        if (!setAVFrame(inFrame, prevFrame, prevPixFmt)) {
+            break;
+        }
+
+        rung->setContext(sws_getCachedContext(rung->getContext(), inFrame->width, inFrame->height, prevPixFmt,
+                                              rung->getWidth(), rung->getHeight(), libavOutPixFmt,
+                                              getSwsFlags(algorithm), 0, 0, 0));
+
+        if (!rung->getContext()) {
+            utils::errorMsg("[VideoLadder] Could not get the swscale context");
+            break;
+        }
+
+        dstFrame->setLength(avpicture_get_size(libavOutPixFmt, rung->getWidth(), rung->getHeight()));
+        dstFrame->setSize(rung->getWidth(), rung->getHeight());
+        dstFrame->setPixelFormat(outPixFmt);
+
+        if (!setAVFrame(outFrame, dstFrame, libavOutPixFmt)) {
+            break;
+        }
+
+        if (sws_scale(rung->getContext(), inFrame->data, inFrame->linesize, 0,
+                      inFrame->height, outFrame->data, outFrame->linesize) <= 0) {
+            utils::errorMsg("[VideoLadder] Could not convert image");
+            break;
+        }
+
+        dstFrame->setConsumed(true);
+        dstFrame->setPresentationTime(org->getPresentationTime());
+        dstFrame->setOriginTime(org->getOriginTime());
+        dstFrame->setSequenceNumber(org->getSequenceNumber());
+
+        prevFrame = dstFrame;
+        prevPixFmt = libavOutPixFmt;
+        processFrame = true;
+    }
+
+    return processFrame;
+}
+
+bool VideoLadder::setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelFormat format)
+{
+    if (avpicture_fill((AVPicture *) aFrame, vFrame->getDataBuf(),
+            format, vFrame->getWidth(),
+            vFrame->getHeight()) <= 0){
+        utils::errorMsg("[VideoLadder] Could not feed AVFrame");
+        return false;
+    }
+
+    //Strided views are only published for packed pixel formats
+    if (vFrame->getStride() > 0) {
+        aFrame->linesize[0] = vFrame->getStride();
+    }
+
+    aFrame->width = vFrame->getWidth();
+    aFrame->height = vFrame->getHeight();
+    aFrame->format = format;
+
+    return true;
+}
+
+void VideoLadder::doGetState(Jzon::Object &filterNode)
+{
+    Jzon::Array jsonRungs;
+
+    filterNode.Add("pixelFormat", utils::getPixTypeAsString(outPixFmt));
+    filterNode.Add("algorithm", getScalingAlgorithmAsString(algorithm));
+
+    for (auto it : rungs) {
+        Jzon::Object rung;
+        rung.Add("id", it.first);
+        rung.Add("width", it.second->getWidth());
+        rung.Add("height", it.second->getHeight());
+        jsonRungs.Add(rung);
+    }
+
+    filterNode.Add("rungs", jsonRungs);
+}
+
+bool VideoLadder::configRung0(int id, int width, int height)
+{
+    if (rungs.count(id) <= 0) {
+        utils::errorMsg("[VideoLadder] Error configuring rung. Incorrect Id " + std::to_string(id));
+        return false;
+    }
+
+    if (width < MIN_WIDTH || height < MIN_HEIGHT) {
+        utils::errorMsg("[VideoLadder] Error configuring rung. Incoherent values");
+        return false;
+    }
+
+    rungs[id]->config(width, height);
+    outputStreamInfos[id]->video.width = width;
+    outputStreamInfos[id]->video.height = height;
+    return true;
+}
+
+bool VideoLadder::configure0(PixType pixelFormat, ScalingAlgorithm algorithm)
+{
+    if (getLibavPixFmt(pixelFormat) == AV_PIX_FMT_NONE || algorithm == SA_NONE) {
+        utils::errorMsg("[VideoLadder] Error configuring. Invalid pixel format or scaling algorithm");
+        return false;
+    }
+
+    outPixFmt = pixelFormat;
+    libavOutPixFmt = getLibavPixFmt(outPixFmt);
+    this->algorithm = algorithm;
+
+    for (auto it : outputStreamInfos) {
+        it.second->video.pixelFormat = outPixFmt;
+    }
+
+    return true;
+}
+
+void VideoLadder::initializeEventMap()
+{
+    eventMap["configRung"] = std::bind(&VideoLadder::configRungEvent, this, std::placeholders::_1);
+    eventMap["configure"] = std::bind(&VideoLadder::configEvent, this, std::placeholders::_1);
+}
+
+bool VideoLadder::configRungEvent(Jzon::Node* params)
+{
+    if (!params) {
+        utils::errorMsg("[VideoLadder::configRungEvent] Params node missing");
+        return false;
+    }
+
+    if (!params->Has("id") || !params->Has("width") || !params->Has("height")) {
+        utils::errorMsg("[VideoLadder::configRungEvent] Params node not complete");
+        return false;
+    }
+
+    return configRung0(params->Get("id").ToInt(), params->Get("width").ToInt(), params->Get("height").ToInt());
+}
+
+bool VideoLadder::configEvent(Jzon::Node* params)
+{
+    PixType pixelType = outPixFmt;
+    ScalingAlgorithm scalingAlgorithm = algorithm;
+
+    if (!params) {
+        return false;
+    }
+
+    if (params->Has("pixelFormat")) {
+        int pixel = params->Get("pixelFormat").ToInt();
+        if (!isValidOutputPixFmt(pixel)) {
+            return false;
+        }
+        pixelType = static_cast<PixType> (pixel);
+    }
+
+    if (params->Has("algorithm")) {
+        scalingAlgorithm = getScalingAlgorithmFromString(params->Get("algorithm").ToString());
+    }
+
+    return configure0(pixelType, scalingAlgorithm);
+}
+
+bool VideoLadder::specificWriterConfig(int writerID)
+{
+    if (rungs.count(writerID) > 0) {
+        utils::errorMsg("[VideoLadder::specificWriterConfig] Error configuring. This WriterID exist " + std::to_string(writerID));
+        return false;
+    }
+
+    rungs[writerID] = new LadderRung();
+
+    //Queues keep a pointer to the stream info, so it lives as long as the filter
+    if (outputStreamInfos.count(writerID) <= 0) {
+        outputStreamInfos[writerID] = new StreamInfo(VIDEO);
+    }
+
+    outputStreamInfos[writerID]->video.codec = RAW;
+    outputStreamInfos[writerID]->video.pixelFormat = outPixFmt;
+    outputStreamInfos[writerID]->video.width = 0;
+    outputStreamInfos[writerID]->video.height = 0;
+
+    return true;
+}
+
+bool VideoLadder::specificWriterDelete(int writerID)
+{
+    if (rungs.count(writerID) <= 0) {
+        utils::errorMsg("[VideoLadder::specificWriterDelete] Error configuring. This WriterID doesn't exist " + std::to_string(writerID));
+        return false;
+    }
+
+    delete rungs[writerID];
+    rungs.erase(writerID);
+
+    return true;
+}
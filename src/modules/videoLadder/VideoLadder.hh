@@ -0,0 +1,132 @@
+/*
+ *  VideoLadder - Multiple rendition video resampler
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#ifndef _VIDEO_LADDER_HH
+#define _VIDEO_LADDER_HH
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libswscale/swscale.h>
+#include <libavcodec/avcodec.h>
+}
+
+#include "../../VideoFrame.hh"
+#include "../../Filter.hh"
+#include "../../StreamInfo.hh"
+#include "../videoResampler/VideoResampler.hh"
+
+/*! Output rendition of the ladder. It keeps the swscale context used to
+    produce it from the previous (bigger) rendition
+*/
+class LadderRung {
+    public:
+        /**
+        * Class constructor.
+        */
+        LadderRung();
+
+        /**
+        * Class destructor.
+        */
+        ~LadderRung();
+
+        /**
+        * It sets rendition size
+        * @param width output width
+        * @param height output height
+        */
+        void config(int width, int height);
+
+        int getWidth() {return width;};
+        int getHeight() {return height;};
+        struct SwsContext *getContext() {return ctx;};
+        void setContext(struct SwsContext *c) {ctx = c;};
+
+    private:
+        int width;
+        int height;
+        struct SwsContext *ctx;
+};
+
+/*! One to many video resampler. Colour conversion is done once, for the biggest rendition,
+    and each smaller rendition is scaled from the previous one instead of from the source
+*/
+class VideoLadder : public OneToManyFilter {
+
+    public:
+        /**
+        * Creates a new ladder
+        * @param pixelFormat output pixel format, common to all renditions
+        * @return Pointer to new object if succeed of NULL if not
+        */
+        static VideoLadder* createNew(PixType pixelFormat = YUV420P);
+
+        /**
+        * Class destructor
+        */
+        ~VideoLadder();
+
+        /**
+        * Configures the rendition associated to a writer
+        * @param id writer id
+        * @param width output width
+        * @param height output height
+        */
+        bool configRung(int id, int width, int height);
+
+        /**
+        * Configures the common output parameters
+        * @param pixelFormat output pixel format
+        * @param algorithm scaling algorithm
+        */
+        bool configure(PixType pixelFormat, ScalingAlgorithm algorithm = FAST_BILINEAR);
+
+    protected:
+        VideoLadder(PixType pixelFormat);
+        FrameQueue *allocQueue(ConnectionData cData);
+        bool doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames);
+        void doGetState(Jzon::Object &filterNode);
+        bool configRung0(int id, int width, int height);
+        bool configure0(PixType pixelFormat, ScalingAlgorithm algorithm);
+        bool specificWriterConfig(int writerID);
+        bool specificWriterDelete(int writerID);
+
+    private:
+        void initializeEventMap();
+        bool configRungEvent(Jzon::Node* params);
+        bool configEvent(Jzon::Node* params);
+        bool setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelFormat format);
+
+        //NOTE: There is no need of specific reader configuration
+        bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
+        bool specificReaderDelete(int /*readerID*/) {return true;};
+
+        std::map<int, LadderRung*> rungs;
+        std::map<int, StreamInfo*> outputStreamInfos;
+
+        AVFrame             *inFrame, *outFrame;
+        PixType             outPixFmt;
+        AVPixelFormat       libavOutPixFmt;
+        ScalingAlgorithm    algorithm;
+};
+
+#endif
@@ -25,7 +25,8 @@
 #include "../../AVFramedQueue.hh"
 #include "../../Utils.hh"
 
-AVPixelFormat getLibavPixFmt(PixType pixType);
+#include <algorithm>
+#include <cmath>
 
 VideoResampler::VideoResampler() : OneToOneFilter()
 {
@@ -34,16 +35,25 @@ VideoResampler::VideoResampler() : OneToOneFilter()
     inFrame = av_frame_alloc();
     outFrame = av_frame_alloc();
 
-    imgConvertCtx = NULL;
+    scaler = NULL;
 
     outputWidth = 0;
     outputHeight = 0;
     discartPeriod = 0;
     discartCount = 1;
+    inPixFmt = P_NONE;
+    outPixFmt = RGB24;
     libavOutPixFmt = getLibavPixFmt(outPixFmt);
+    algorithm = FAST_BILINEAR;
+    threads = 1;
 
     needsConfig = false;
 
+    sliceJob = 0;
+    pendingSlices = 0;
+    slicesFailed = false;
+    runSlices = false;
+
     outputStreamInfo = new StreamInfo(VIDEO);
     outputStreamInfo->video.codec = RAW;
     outputStreamInfo->video.pixelFormat = RGB24;
@@ -53,9 +63,10 @@ VideoResampler::VideoResampler() : OneToOneFilter()
 
 VideoResampler::~VideoResampler()
 {
+    stopSliceWorkers();
     av_free(inFrame);
     av_free(outFrame);
-    sws_freeContext(imgConvertCtx);
+    freeScalers();
 
     delete outputStreamInfo;
 }
@@ -67,7 +78,7 @@ FrameQueue* VideoResampler::allocQueue(ConnectionData cData)
 
 bool VideoResampler::reconfigure(VideoFrame* orgFrame)
 {      
-    if (!imgConvertCtx || needsConfig || 
+    if (!scaler || needsConfig || 
         orgFrame->getWidth() != inFrame->width ||
         orgFrame->getHeight() != inFrame->height ||
         orgFrame->getPixelFormat() != inPixFmt)
@@ -92,11 +103,14 @@ bool VideoResampler::reconfigure(VideoFrame* orgFrame)
             outHeight = outputHeight;
         }
         
-        imgConvertCtx = sws_getContext(orgFrame->getWidth(), orgFrame->getHeight(), 
-                                       libavInPixFmt, outWidth, outHeight,
-                                       libavOutPixFmt, SWS_FAST_BILINEAR, 0, 0, 0);
+        if (sliceWorkers.size() != threads - 1) {
+            stopSliceWorkers();
+            startSliceWorkers();
+        }
+
+        scaler = getScaler(orgFrame->getWidth(), orgFrame->getHeight(), outWidth, outHeight);
 
-        if (!imgConvertCtx){
+        if (!scaler){
             utils::errorMsg("Could not get the swscale context");
             return false;
         }
@@ -106,10 +120,257 @@ bool VideoResampler::reconfigure(VideoFrame* orgFrame)
     return true;
 }
 
+Scaler *VideoResampler::getScaler(int inWidth, int inHeight, int outWidth, int outHeight)
+{
+    Scaler newScaler;
+    int flags = getSwsFlags(algorithm);
+
+    for (auto it = scalers.begin(); it != scalers.end(); it++) {
+        if (it->inWidth == inWidth && it->inHeight == inHeight && it->inPixFmt == libavInPixFmt &&
+            it->outWidth == outWidth && it->outHeight == outHeight && it->outPixFmt == libavOutPixFmt &&
+            it->flags == flags && it->threads == threads) {
+            //Most recently used scalers are kept at the front
+            scalers.splice(scalers.begin(), scalers, it);
+            return &scalers.front();
+        }
+    }
+
+    newScaler.inWidth = inWidth;
+    newScaler.inHeight = inHeight;
+    newScaler.inPixFmt = libavInPixFmt;
+    newScaler.outWidth = outWidth;
+    newScaler.outHeight = outHeight;
+    newScaler.outPixFmt = libavOutPixFmt;
+    newScaler.flags = flags;
+    newScaler.threads = threads;
+
+    if (!setSlices(newScaler)) {
+        freeSlices(newScaler);
+        return NULL;
+    }
+
+    scalers.push_front(newScaler);
+
+    if (scalers.size() > MAX_CACHED_SCALERS) {
+        freeSlices(scalers.back());
+        scalers.pop_back();
+    }
+
+    return &scalers.front();
+}
+
+bool VideoResampler::setSlices(Scaler &s)
+{
+    ScalerSlice slice;
+    int common, remainder, inUnit, outUnit, units, margin;
+    int first, last, scaledFirst, scaledLast;
+    double ratio;
+
+    //Band limits are placed where input and output lines match exactly, so that each
+    //band keeps the whole picture scaling ratio, and are kept even so that they are 
+    //aligned to subsampled chroma lines
+    common = s.inHeight;
+    remainder = s.outHeight;
+    while (remainder != 0) {
+        std::swap(common, remainder);
+        remainder %= common;
+    }
+
+    inUnit = s.inHeight / common;
+    outUnit = s.outHeight / common;
+    if (inUnit % 2 != 0 || outUnit % 2 != 0) {
+        inUnit *= 2;
+        outUnit *= 2;
+    }
+    units = (s.outHeight + outUnit - 1) / outUnit;
+
+    //Extra units scaled at each side of a band to cover the vertical filter taps
+    ratio = std::max(1.0, (double) s.inHeight / s.outHeight);
+    margin = (int) std::ceil(SCALING_FILTER_RADIUS * ratio);
+    margin = (margin + inUnit - 1) / inUnit;
+
+    for (int i = 0; i < 4; i++) {
+        slice.data[i] = NULL;
+        slice.linesize[i] = 0;
+    }
+
+    if (threads == 1 || units < 2) {
+        slice.inY = 0;
+        slice.inHeight = s.inHeight;
+        slice.scaledY = slice.outY = 0;
+        slice.scaledHeight = slice.outHeight = s.outHeight;
+        slice.ctx = sws_getContext(s.inWidth, s.inHeight, s.inPixFmt, s.outWidth, s.outHeight,
+                                   s.outPixFmt, s.flags, 0, 0, 0);
+        s.slices.push_back(slice);
+        return slice.ctx != NULL;
+    }
+
+    first = 0;
+    for (unsigned i = 1; i <= threads; i++) {
+        last = units * i / threads;
+
+        if (last == first) {
+            continue;
+        }
+
+        scaledFirst = std::max(0, first - margin);
+        scaledLast = std::min(units, last + margin);
+
+        slice.outY = first * outUnit;
+        slice.outHeight = std::min(last * outUnit, s.outHeight) - slice.outY;
+        slice.scaledY = scaledFirst * outUnit;
+        slice.scaledHeight = std::min(scaledLast * outUnit, s.outHeight) - slice.scaledY;
+        slice.inY = scaledFirst * inUnit;
+        slice.inHeight = std::min(scaledLast * inUnit, s.inHeight) - slice.inY;
+
+        slice.ctx = sws_getContext(s.inWidth, slice.inHeight, s.inPixFmt, s.outWidth, slice.scaledHeight,
+                                   s.outPixFmt, s.flags, 0, 0, 0);
+        s.slices.push_back(slice);
+
+        if (!slice.ctx) {
+            return false;
+        }
+
+        if (av_image_alloc(s.slices.back().data, s.slices.back().linesize, s.outWidth, 
+                           slice.scaledHeight, s.outPixFmt, 16) < 0) {
+            return false;
+        }
+
+        first = last;
+    }
+
+    return true;
+}
+
+void VideoResampler::freeSlices(Scaler &s)
+{
+    for (auto &slice : s.slices) {
+        sws_freeContext(slice.ctx);
+        av_freep(&slice.data[0]);
+    }
+
+    s.slices.clear();
+}
+
+void VideoResampler::freeScalers()
+{
+    for (auto &it : scalers) {
+        freeSlices(it);
+    }
+
+    scalers.clear();
+    scaler = NULL;
+}
+
+bool VideoResampler::scaleSlice(ScalerSlice &slice)
+{
+    const uint8_t *src[AV_NUM_DATA_POINTERS];
+    const AVPixFmtDescriptor *inDesc = av_pix_fmt_desc_get(libavInPixFmt);
+    const AVPixFmtDescriptor *outDesc = av_pix_fmt_desc_get(libavOutPixFmt);
+    int shift, firstLine, lastLine;
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+        //Only chroma planes are vertically subsampled
+        shift = (i == 1 || i == 2) ? inDesc->log2_chroma_h : 0;
+        src[i] = inFrame->data[i] ? inFrame->data[i] + (slice.inY >> shift) * inFrame->linesize[i] : NULL;
+    }
+
+    if (sws_scale(slice.ctx, src, inFrame->linesize, 0, slice.inHeight, slice.data, slice.linesize) <= 0) {
+        return false;
+    }
+
+    //Lines scaled for the filter taps belong to the neighbour bands
+    for (int i = 0; i < av_pix_fmt_count_planes(libavOutPixFmt); i++) {
+        shift = (i == 1 || i == 2) ? outDesc->log2_chroma_h : 0;
+        firstLine = slice.outY >> shift;
+        lastLine = -((-(slice.outY + slice.outHeight)) >> shift);
+        av_image_copy_plane(outFrame->data[i] + firstLine * outFrame->linesize[i], outFrame->linesize[i],
+                            slice.data[i] + ((slice.outY - slice.scaledY) >> shift) * slice.linesize[i],
+                            slice.linesize[i], av_image_get_linesize(libavOutPixFmt, scaler->outWidth, i),
+                            lastLine - firstLine);
+    }
+
+    return true;
+}
+
+bool VideoResampler::scale()
+{
+    bool success;
+
+    if (scaler->slices.size() == 1) {
+        return sws_scale(scaler->slices.front().ctx, inFrame->data, inFrame->linesize, 0,
+                         inFrame->height, outFrame->data, outFrame->linesize) > 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(slicesMtx);
+        pendingSlices = sliceWorkers.size();
+        slicesFailed = false;
+        sliceJob++;
+    }
+    slicesCheck.notify_all();
+
+    //First slice is scaled by the filter worker itself
+    success = scaleSlice(scaler->slices.front());
+
+    std::unique_lock<std::mutex> guard(slicesMtx);
+    slicesDone.wait(guard, [this]{return pendingSlices == 0;});
+
+    return success && !slicesFailed;
+}
+
+void VideoResampler::startSliceWorkers()
+{
+    runSlices = true;
+
+    for (unsigned i = 1; i < threads; i++) {
+        sliceWorkers.push_back(std::thread(&VideoResampler::sliceWorker, this, i, sliceJob));
+    }
+}
+
+void VideoResampler::stopSliceWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(slicesMtx);
+        runSlices = false;
+    }
+    slicesCheck.notify_all();
+
+    for (std::thread &worker : sliceWorkers) {
+        worker.join();
+    }
+
+    sliceWorkers.clear();
+}
+
+void VideoResampler::sliceWorker(unsigned id, unsigned job)
+{
+    bool success;
+    std::unique_lock<std::mutex> guard(slicesMtx);
+
+    while (true) {
+        slicesCheck.wait(guard, [this, job]{return !runSlices || sliceJob != job;});
+
+        if (!runSlices) {
+            return;
+        }
+
+        job = sliceJob;
+        guard.unlock();
+
+        success = id >= scaler->slices.size() || scaleSlice(scaler->slices[id]);
+
+        guard.lock();
+        slicesFailed |= !success;
+        if (--pendingSlices == 0) {
+            slicesDone.notify_one();
+        }
+    }
+}
+
 bool VideoResampler::doProcessFrame(Frame *org, Frame *dst)
 {
     int outWidth, outHeight;
-    int height;
 
     VideoFrame* dstFrame = dynamic_cast<VideoFrame*>(dst);
     VideoFrame* orgFrame = dynamic_cast<VideoFrame*>(org);
@@ -149,10 +410,7 @@ bool VideoResampler::doProcessFrame(Frame *org, Frame *dst)
         return false;
     }
     
-    height = sws_scale(imgConvertCtx, inFrame->data, inFrame->linesize, 0, 
-              inFrame->height, outFrame->data, outFrame->linesize);
-    
-    if (height <= 0){
+    if (!scale()){
         utils::errorMsg("Could not convert image");
         return false;
     }
@@ -166,20 +424,28 @@ bool VideoResampler::doProcessFrame(Frame *org, Frame *dst)
 }
 
 
-bool VideoResampler::configure0(int width, int height, int period, PixType pixelFormat) 
+bool VideoResampler::configure0(int width, int height, int period, PixType pixelFormat, 
+                                ScalingAlgorithm algorithm, unsigned threads) 
 {
+    if (getLibavPixFmt(pixelFormat) == AV_PIX_FMT_NONE || algorithm == SA_NONE){
+        return false;
+    }
+
+    if (threads == 0 || threads > MAX_SCALING_THREADS) {
+        utils::errorMsg("[Resampler] Invalid number of scaling threads");
+        return false;
+    }
+
     outputWidth = width;
     outputHeight = height;
     outPixFmt = pixelFormat;
     discartPeriod = period;
+    this->algorithm = algorithm;
+    this->threads = threads;
     
     libavOutPixFmt = getLibavPixFmt(outPixFmt);
     needsConfig = true;
     
-    if (libavOutPixFmt == AV_PIX_FMT_NONE){
-        return false;
-    }
-    
     return true;
 }
 
@@ -187,6 +453,8 @@ bool VideoResampler::configEvent(Jzon::Node* params)
 {
     int width, height, period;
     PixType pixelType;
+    ScalingAlgorithm scalingAlgorithm;
+    unsigned scalingThreads;
        
     if (!params) {
         return false;
@@ -196,6 +464,8 @@ bool VideoResampler::configEvent(Jzon::Node* params)
     height = outputHeight;
     period = discartPeriod;
     pixelType = outPixFmt;
+    scalingAlgorithm = algorithm;
+    scalingThreads = threads;
     
     if (params->Has("width")){
         width = params->Get("width").ToInt();
@@ -211,13 +481,25 @@ bool VideoResampler::configEvent(Jzon::Node* params)
     
     if (params->Has("pixelFormat")){
         int pixel = params->Get("pixelFormat").ToInt();
-        if ((pixel < P_NONE) || (pixel > YUYV422)) {
+        if (!isValidOutputPixFmt(pixel)) {
             return false;
         }
         pixelType = static_cast<PixType> (pixel);
     }
 
-    return configure0(width, height, period, pixelType);
+    if (params->Has("algorithm")){
+        scalingAlgorithm = getScalingAlgorithmFromString(params->Get("algorithm").ToString());
+        if (scalingAlgorithm == SA_NONE) {
+            utils::errorMsg("[Resampler] Unknown scaling algorithm");
+            return false;
+        }
+    }
+
+    if (params->Has("threads")){
+        scalingThreads = params->Get("threads").ToInt();
+    }
+
+    return configure0(width, height, period, pixelType, scalingAlgorithm, scalingThreads);
 }
 
 void VideoResampler::initializeEventMap()
@@ -227,7 +509,12 @@ void VideoResampler::initializeEventMap()
 
 void VideoResampler::doGetState(Jzon::Object &filterNode)
 {
-    //TODO:
+    filterNode.Add("width", outputWidth);
+    filterNode.Add("height", outputHeight);
+    filterNode.Add("discartPeriod", discartPeriod);
+    filterNode.Add("pixelFormat", utils::getPixTypeAsString(outPixFmt));
+    filterNode.Add("algorithm", getScalingAlgorithmAsString(algorithm));
+    filterNode.Add("threads", (int) threads);
 }
 
 AVPixelFormat getLibavPixFmt(PixType pixType)
@@ -262,14 +549,35 @@ AVPixelFormat getLibavPixFmt(PixType pixType)
     return AV_PIX_FMT_NONE;
 }
 
+bool isValidOutputPixFmt(int pixel)
+{
+    return pixel >= P_NONE && pixel <= YUYV422;
+}
+
 bool VideoResampler::setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelFormat format)
 {      
+    InterleavedVideoFrame *iFrame = dynamic_cast<InterleavedVideoFrame*> (vFrame);
+
+    //Padded or aligned planes are taken as they are
+    if (iFrame && iFrame->isPlanarView()) {
+        iFrame->getPlanes(aFrame->data, aFrame->linesize);
+        aFrame->width = vFrame->getWidth();
+        aFrame->height = vFrame->getHeight();
+        aFrame->format = format;
+        return true;
+    }
+
     if (avpicture_fill((AVPicture *) aFrame, vFrame->getDataBuf(), 
             format, vFrame->getWidth(), 
             vFrame->getHeight()) <= 0){
         utils::errorMsg("Could not feed AVFrame");
         return false;
     }
+
+    //Strided views are only published for packed pixel formats
+    if (vFrame->getStride() > 0) {
+        aFrame->linesize[0] = vFrame->getStride();
+    }
     
     aFrame->width = vFrame->getWidth();
     aFrame->height = vFrame->getHeight();
@@ -278,13 +586,17 @@ bool VideoResampler::setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelForm
     return true;
 }
 
-bool VideoResampler::configure(int width, int height, int period, PixType pixelFormat) 
+bool VideoResampler::configure(int width, int height, int period, PixType pixelFormat, 
+                               ScalingAlgorithm algorithm, unsigned threads) 
 {
     Jzon::Object root, params;
     root.Add("action", "configure");
     params.Add("width", width);
     params.Add("height", height);
+    params.Add("discartPeriod", period);
     params.Add("pixelFormat", pixelFormat);
+    params.Add("algorithm", getScalingAlgorithmAsString(algorithm));
+    params.Add("threads", (int) threads);
     root.Add("params", params);
 
     Event e(root, std::chrono::system_clock::now(), 0);
@@ -292,4 +604,60 @@ bool VideoResampler::configure(int width, int height, int period, PixType pixelF
     return true;
 }
 
+int getSwsFlags(ScalingAlgorithm algorithm)
+{
+    switch(algorithm){
+        case BILINEAR:
+            return SWS_BILINEAR;
+        case BICUBIC:
+            return SWS_BICUBIC;
+        case POINT:
+            return SWS_POINT;
+        case AREA:
+            return SWS_AREA;
+        case LANCZOS:
+            return SWS_LANCZOS;
+        case FAST_BILINEAR:
+        default:
+            return SWS_FAST_BILINEAR;
+    }
+}
+
+ScalingAlgorithm getScalingAlgorithmFromString(std::string stringAlgorithm)
+{
+    if (stringAlgorithm.compare("fast_bilinear") == 0) {
+        return FAST_BILINEAR;
+    } else if (stringAlgorithm.compare("bilinear") == 0) {
+        return BILINEAR;
+    } else if (stringAlgorithm.compare("bicubic") == 0) {
+        return BICUBIC;
+    } else if (stringAlgorithm.compare("point") == 0) {
+        return POINT;
+    } else if (stringAlgorithm.compare("area") == 0) {
+        return AREA;
+    } else if (stringAlgorithm.compare("lanczos") == 0) {
+        return LANCZOS;
+    }
+
+    return SA_NONE;
+}
 
+std::string getScalingAlgorithmAsString(ScalingAlgorithm algorithm)
+{
+    switch(algorithm){
+        case FAST_BILINEAR:
+            return "fast_bilinear";
+        case BILINEAR:
+            return "bilinear";
+        case BICUBIC:
+            return "bicubic";
+        case POINT:
+            return "point";
+        case AREA:
+            return "area";
+        case LANCZOS:
+            return "lanczos";
+        default:
+            return "";
+    }
+}
@@ -26,6 +26,8 @@
 
 extern "C" {
 #include <libavutil/avutil.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 #include <libavcodec/avcodec.h>
 }
@@ -35,15 +37,80 @@ extern "C" {
 #include "../../Filter.hh"
 #include "../../StreamInfo.hh"
 
+#include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define MAX_CACHED_SCALERS 4
+#define MAX_SCALING_THREADS 16
+//Input lines reached at each side by the widest swscale vertical filter without downscaling
+#define SCALING_FILTER_RADIUS 4
+
+enum ScalingAlgorithm {SA_NONE = -1, FAST_BILINEAR, BILINEAR, BICUBIC, POINT, AREA, LANCZOS};
+
+/*! Horizontal band of the picture scaled by its own swscale context. The band
+    is scaled with some extra lines above and below it into its own buffer, so
+    that the filter taps next to its limits are the same as in a whole picture
+    conversion, and only the outY to outY + outHeight lines are copied
+*/
+struct ScalerSlice {
+    struct SwsContext *ctx;
+    int inY;
+    int inHeight;
+    int scaledY;
+    int scaledHeight;
+    int outY;
+    int outHeight;
+    uint8_t *data[4];
+    int linesize[4];
+};
+
+/*! Swscale contexts cached by VideoResampler. It is identified by the whole
+    conversion it performs, so switching back to a previous configuration
+    reuses it instead of initializing the scaling filters again
+*/
+struct Scaler {
+    int inWidth;
+    int inHeight;
+    AVPixelFormat inPixFmt;
+    int outWidth;
+    int outHeight;
+    AVPixelFormat outPixFmt;
+    int flags;
+    unsigned threads;
+    std::vector<ScalerSlice> slices;
+};
+
+AVPixelFormat getLibavPixFmt(PixType pixType);
+bool isValidOutputPixFmt(int pixel);
+int getSwsFlags(ScalingAlgorithm algorithm);
+ScalingAlgorithm getScalingAlgorithmFromString(std::string stringAlgorithm);
+std::string getScalingAlgorithmAsString(ScalingAlgorithm algorithm);
+
 class VideoResampler : public OneToOneFilter {
 
     public:
         VideoResampler();
         ~VideoResampler();
-        bool configure(int width, int height, int period, PixType pixelFormat);
+
+        /**
+        * Configures the resampler
+        * @param width output width, 0 keeps input width
+        * @param height output height, 0 keeps input height
+        * @param period discards one frame every period frames, 0 disables discarding
+        * @param pixelFormat output pixel format
+        * @param algorithm scaling algorithm
+        * @param threads number of horizontal slices scaled concurrently
+        * @return true if succeeded, false if not
+        */
+        bool configure(int width, int height, int period, PixType pixelFormat, 
+                       ScalingAlgorithm algorithm = FAST_BILINEAR, unsigned threads = 1);
         
     private:
-        bool configure0(int width, int height, int period, PixType pixelFormat);
+        bool configure0(int width, int height, int period, PixType pixelFormat, 
+                        ScalingAlgorithm algorithm, unsigned threads);
         bool doProcessFrame(Frame *org, Frame *dst);
         FrameQueue* allocQueue(ConnectionData cData);
         void initializeEventMap();
@@ -51,6 +118,15 @@ class VideoResampler : public OneToOneFilter {
         void doGetState(Jzon::Object &filterNode);
         bool reconfigure(VideoFrame* orgFrame);
         bool setAVFrame(AVFrame *aFrame, VideoFrame* vFrame, AVPixelFormat format);
+        Scaler *getScaler(int inWidth, int inHeight, int outWidth, int outHeight);
+        bool setSlices(Scaler &scaler);
+        void freeSlices(Scaler &s);
+        void freeScalers();
+        bool scaleSlice(ScalerSlice &slice);
+        bool scale();
+        void startSliceWorkers();
+        void stopSliceWorkers();
+        void sliceWorker(unsigned id, unsigned job);
         
         //NOTE: There is no need of specific reader configuration
         bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/)  {return true;};
@@ -60,7 +136,8 @@ class VideoResampler : public OneToOneFilter {
         bool specificWriterConfig(int /*writerID*/) {return true;};
         bool specificWriterDelete(int /*writerID*/) {return true;};
         
-        struct SwsContext   *imgConvertCtx;
+        std::list<Scaler>   scalers;
+        Scaler              *scaler;
         AVFrame             *inFrame, *outFrame;
         AVPixelFormat       libavInPixFmt, libavOutPixFmt;
 
@@ -71,7 +148,18 @@ class VideoResampler : public OneToOneFilter {
         int                 discartCount;
         int                 discartPeriod;
         PixType             inPixFmt, outPixFmt;
+        ScalingAlgorithm    algorithm;
+        unsigned            threads;
         bool                needsConfig;
+
+        std::vector<std::thread>    sliceWorkers;
+        std::mutex                  slicesMtx;
+        std::condition_variable     slicesCheck;
+        std::condition_variable     slicesDone;
+        unsigned                    sliceJob;
+        unsigned                    pendingSlices;
+        bool                        slicesFailed;
+        bool                        runSlices;
 };
 
 #endif
@@ -112,8 +112,11 @@ bool VideoSplitter::doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames
 	int widthROI = 0;
 	int heightROI = 0;
 	int degreeCrop = 0;
+	int orgStride = 0;
 	VideoFrame *vFrame;
 	VideoFrame *vFrameDst;
+	InterleavedVideoFrame *iFrame;
+	InterleavedVideoFrame *iFrameDst;
 
 	vFrame = dynamic_cast<VideoFrame*>(org);
 	
@@ -121,8 +124,11 @@ bool VideoSplitter::doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames
 		utils::errorMsg("[VideoSplitter] No origin frame");
 		return false;
 	}
+
+	iFrame = dynamic_cast<InterleavedVideoFrame*>(org);
+	orgStride = vFrame->getStride() > 0 ? vFrame->getStride() : vFrame->getWidth() * RGB24_BYTES_PER_PIXEL;
 	
-	cv::Mat orgFrame(vFrame->getHeight(), vFrame->getWidth(), CV_8UC3, vFrame->getDataBuf());
+	cv::Mat orgFrame(vFrame->getHeight(), vFrame->getWidth(), CV_8UC3, vFrame->getDataBuf(), orgStride);
 	
 	for (auto it : dstFrames){
 		xROI = cropsConfig[it.first]->getX();
@@ -133,12 +139,18 @@ bool VideoSplitter::doProcessFrame(Frame *org, std::map<int, Frame *> &dstFrames
 
 		if((xROI >= 0 || yROI >= 0 || widthROI > 0 || heightROI > 0) && xROI+widthROI <= vFrame->getWidth() && yROI+heightROI <= vFrame->getHeight()){
 			vFrameDst = dynamic_cast<VideoFrame*>(it.second);
-			cropsConfig[it.first]->getCrop()->data = vFrameDst->getDataBuf();
-			vFrameDst->setLength(widthROI * heightROI);
+			iFrameDst = dynamic_cast<InterleavedVideoFrame*>(it.second);
+			vFrameDst->setLength(widthROI * heightROI * RGB24_BYTES_PER_PIXEL);
     		vFrameDst->setSize(widthROI, heightROI);
-    		if (degreeCrop == 0){
+    		if (degreeCrop == 0 && iFrame && iFrameDst){
+    			//Unrotated crops are published as strided views of the origin frame buffer
+    			iFrameDst->setView(iFrame->getSharedBuf(), 
+    				iFrame->getDataBuf() + yROI * orgStride + xROI * RGB24_BYTES_PER_PIXEL, orgStride);
+			} else if (degreeCrop == 0){
+				cropsConfig[it.first]->getCrop()->data = vFrameDst->getDataBuf();
     			orgFrame(cv::Rect(xROI, yROI, widthROI, heightROI)).copyTo(cropsConfig[it.first]->getCropRect(0, 0, widthROI, heightROI));
 			} else {
+				cropsConfig[it.first]->getCrop()->data = vFrameDst->getDataBuf();
 				cv::Mat rotationMatrix, rotatedImage;
 				cv::Point orgFrameCenter(orgFrame.cols/2, orgFrame.rows/2);
 				rotationMatrix = cv::getRotationMatrix2D(orgFrameCenter, degreeCrop, 1.0);
@@ -28,6 +28,7 @@
 #include "../../StreamInfo.hh"
 #include <opencv/cv.hpp>
 
+#define RGB24_BYTES_PER_PIXEL 3
 
 
 class CropConfig {
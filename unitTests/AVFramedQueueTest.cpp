@@ -32,6 +32,7 @@
 #include <cppunit/XmlOutputter.h>
 
 #include "AVFramedQueue.hh"
+#include "VideoFrame.hh"
 #include "FilterMockup.hh"
 #include "Utils.hh"
 #include "StreamInfo.hh"
@@ -42,6 +43,7 @@ class AVFramedQueueTest : public CppUnit::TestFixture
     CPPUNIT_TEST(normalBehaviour);
     CPPUNIT_TEST(forceGetRearTest);
     CPPUNIT_TEST(forceGetFrontTest);
+    CPPUNIT_TEST(videoFrameViewTest);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -52,6 +54,7 @@ protected:
     void normalBehaviour();
     void forceGetRearTest();
     void forceGetFrontTest();
+    void videoFrameViewTest();
 
     struct ConnectionData cData;
     unsigned maxFrames;
@@ -174,6 +177,56 @@ void AVFramedQueueTest::forceGetFrontTest()
     CPPUNIT_ASSERT(frame->getSequenceNumber() == seq - 1);
 }
 
+void AVFramedQueueTest::videoFrameViewTest()
+{
+    StreamInfo si(VIDEO);
+    VideoFrameQueue *vq;
+    InterleavedVideoFrame *org;
+    InterleavedVideoFrame *dst;
+    unsigned char *orgData;
+    int stride = DEFAULT_WIDTH * 3;
+
+    si.video.codec = RAW;
+    si.video.pixelFormat = RGB24;
+
+    org = InterleavedVideoFrame::createNew(RAW, DEFAULT_WIDTH, DEFAULT_HEIGHT, RGB24);
+    orgData = org->getDataBuf();
+    vq = VideoFrameQueue::createNew(cData, &si, maxFrames);
+    CPPUNIT_ASSERT(vq);
+
+    dst = dynamic_cast<InterleavedVideoFrame*>(vq->getRear());
+    CPPUNIT_ASSERT(dst && !dst->isView());
+    dst->setView(org->getSharedBuf(), orgData + stride + 3, stride);
+    CPPUNIT_ASSERT(dst->isView());
+    CPPUNIT_ASSERT(dst->getStride() == stride);
+    CPPUNIT_ASSERT(dst->getDataBuf() == orgData + stride + 3);
+    CPPUNIT_ASSERT(org->getSharedBuf() == dst->getSharedBuf());
+
+    //Origin buffer is still referenced by the view, writing to it must detach
+    org->detachBuffer();
+    CPPUNIT_ASSERT(org->getDataBuf() != orgData);
+    CPPUNIT_ASSERT(dst->getDataBuf() == orgData + stride + 3);
+
+    vq->addFrame();
+    CPPUNIT_ASSERT(vq->getFront() == dst);
+    vq->removeFrame();
+    CPPUNIT_ASSERT(vq->forceGetFront() == dst);
+    CPPUNIT_ASSERT(dst->isView());
+
+    for (unsigned i = 0; i < maxFrames - 1; i++) {
+        CPPUNIT_ASSERT(vq->getRear());
+        vq->addFrame();
+        vq->removeFrame();
+    }
+
+    //Frame slot has been reused, so its view must have been dropped
+    CPPUNIT_ASSERT(!dst->isView());
+    CPPUNIT_ASSERT(dst->getStride() == 0);
+
+    delete vq;
+    delete org;
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(AVFramedQueueTest);
 
 int main(int argc, char* argv[])
@@ -23,6 +23,7 @@
 #include <iostream>
 #include <fstream>
 #include <string.h>
+#include <cstdlib>
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -47,6 +48,8 @@ class AudioCircularBufferTest : public CppUnit::TestFixture
     CPPUNIT_TEST(timestampGap);
     CPPUNIT_TEST(timestampOverlapping);
     CPPUNIT_TEST(flushBecauseOfDeviation);
+    CPPUNIT_TEST(wrapAround);
+    CPPUNIT_TEST(driftCompensation);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -59,6 +62,8 @@ protected:
     void timestampGap();
     void timestampOverlapping();
     void flushBecauseOfDeviation();
+    void wrapAround();
+    void driftCompensation();
 
     struct ConnectionData cData;
 
@@ -327,6 +332,102 @@ void AudioCircularBufferTest::flushBecauseOfDeviation()
     buffer->removeFrame();
 }
 
+void AudioCircularBufferTest::wrapAround()
+{
+    PlanarAudioFrame* inFrame;
+    PlanarAudioFrame* outFrame;
+    std::chrono::microseconds syncTime = std::chrono::microseconds(0);
+    const unsigned samplesPerFrame = 80;
+    const unsigned frames = 1000;
+    unsigned char valueTestBlock[samplesPerFrame*bytesPerSample];
+    buffer->setOutputFrameSamples(samplesPerFrame);
+
+    //Frames do not divide the ring length, so some of them cross its end
+    for (unsigned i = 0; i < frames; i++) {
+        inFrame = dynamic_cast<PlanarAudioFrame*>(buffer->getRear());
+        CPPUNIT_ASSERT(inFrame->isView());
+
+        inFrame->fillWithValue(i % 200 + 1);
+        inFrame->setSamples(samplesPerFrame);
+        inFrame->setPresentationTime(syncTime + std::chrono::microseconds(i*samplesPerFrame*std::micro::den/sampleRate));
+        buffer->addFrame();
+
+        outFrame = dynamic_cast<PlanarAudioFrame*>(buffer->getFront());
+        CPPUNIT_ASSERT(outFrame);
+        CPPUNIT_ASSERT(outFrame->isView());
+        CPPUNIT_ASSERT(outFrame->getPresentationTime() == inFrame->getPresentationTime());
+
+        memset(valueTestBlock, i % 200 + 1, sizeof valueTestBlock);
+        CPPUNIT_ASSERT(memcmp(outFrame->getPlanarDataBuf()[0], valueTestBlock, sizeof valueTestBlock) == 0);
+        CPPUNIT_ASSERT(memcmp(outFrame->getPlanarDataBuf()[1], valueTestBlock, sizeof valueTestBlock) == 0);
+        buffer->removeFrame();
+    }
+
+    CPPUNIT_ASSERT(buffer->getElements() == 0);
+}
+
+void AudioCircularBufferTest::driftCompensation()
+{
+    PlanarAudioFrame* inFrame;
+    PlanarAudioFrame* outFrame;
+    std::chrono::microseconds syncTime = std::chrono::microseconds(0);
+    std::chrono::microseconds lastTs;
+    std::chrono::microseconds frameDuration;
+    const unsigned samplesPerFrame = 400;
+    const unsigned outputSamples = 100;
+    const unsigned frames = 10;
+    const unsigned outputFrames = 10;
+    unsigned depth;
+    unsigned consumedSamples;
+    buffer->setOutputFrameSamples(outputSamples);
+    frameDuration = std::chrono::microseconds(outputSamples*std::micro::den/sampleRate);
+    buffer->setAdaptiveBuffering(true);
+
+    //Frames arrive in a burst, so the buffer is far deeper than the measured jitter requires
+    for (unsigned i = 0; i < frames; i++) {
+        inFrame = dynamic_cast<PlanarAudioFrame*>(buffer->getRear());
+        inFrame->fillWithValue(2);
+        inFrame->setSamples(samplesPerFrame);
+        inFrame->setPresentationTime(syncTime + std::chrono::microseconds(i*samplesPerFrame*std::micro::den/sampleRate));
+        buffer->addFrame();
+    }
+
+    CPPUNIT_ASSERT(buffer->getJitter().count() > 0);
+    CPPUNIT_ASSERT(buffer->getTargetDepth().count() > 0);
+    CPPUNIT_ASSERT(buffer->getTargetDepth() < std::chrono::microseconds(frames*samplesPerFrame*std::micro::den/sampleRate));
+
+    //Depth in samples, measured with one sample frames
+    buffer->setOutputFrameSamples(1);
+    depth = buffer->getElements();
+    buffer->setOutputFrameSamples(outputSamples);
+    lastTs = syncTime - frameDuration;
+
+    for (unsigned i = 0; i < outputFrames; i++) {
+        outFrame = dynamic_cast<PlanarAudioFrame*>(buffer->getFront());
+        CPPUNIT_ASSERT(outFrame);
+        //Resampled frames are not views of the ring, but the signal is preserved
+        CPPUNIT_ASSERT(!outFrame->isView());
+        CPPUNIT_ASSERT(outFrame->getPlanarDataBuf()[0][0] == 2);
+        //Timestamps follow the output samples, so they are continuous
+        CPPUNIT_ASSERT(std::abs((outFrame->getPresentationTime() - lastTs - frameDuration).count()) <= 1);
+        lastTs = outFrame->getPresentationTime();
+        buffer->removeFrame();
+    }
+
+    //The input is read slightly faster to reduce the depth, without dropping whole frames
+    buffer->setOutputFrameSamples(1);
+    consumedSamples = depth - buffer->getElements();
+    buffer->setOutputFrameSamples(outputSamples);
+    CPPUNIT_ASSERT(consumedSamples > outputFrames*outputSamples);
+    CPPUNIT_ASSERT(consumedSamples <= outputFrames*outputSamples*(1 + MAX_DRIFT_CORRECTION) + 1);
+
+    buffer->setAdaptiveBuffering(false);
+    buffer->removeFrame();
+    outFrame = dynamic_cast<PlanarAudioFrame*>(buffer->getFront());
+    CPPUNIT_ASSERT(outFrame);
+    CPPUNIT_ASSERT(outFrame->isView());
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(AudioCircularBufferTest);
 
 int main(int argc, char* argv[])
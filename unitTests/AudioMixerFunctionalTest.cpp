@@ -23,6 +23,8 @@
 #include <iostream>
 #include <chrono>
 #include <fstream>
+#include <cmath>
+#include <vector>
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -61,6 +63,11 @@ class AudioMixerFunctionalTest : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(AudioMixerFunctionalTest);
     CPPUNIT_TEST(mixingTest);
+    CPPUNIT_TEST(conversionTest);
+    CPPUNIT_TEST(mixMinusTest);
+    CPPUNIT_TEST(meteringTest);
+    CPPUNIT_TEST(limiterTest);
+    CPPUNIT_TEST(limiterChannelOrderTest);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -69,6 +76,11 @@ public:
 
 protected:
     void mixingTest();
+    void conversionTest();
+    void mixMinusTest();
+    void meteringTest();
+    void limiterTest();
+    void limiterChannelOrderTest();
 
     int channels = 2;
     int sampleRate = 48000;
@@ -171,6 +183,320 @@ void AudioMixerFunctionalTest::mixingTest()
     }
 }
 
+void AudioMixerFunctionalTest::conversionTest()
+{
+    float samples[] = {-1.5, -1.0, -0.25, 0.0, 0.5, 0.999, 1.0, 2.0};
+    unsigned nOfSamples = sizeof(samples)/sizeof(float);
+    unsigned char blockBytes[sizeof(samples)];
+    unsigned char sampleBytes[sizeof(samples)];
+    float converted[sizeof(samples)/sizeof(float)];
+    float fValue;
+
+    CPPUNIT_ASSERT(AudioMixer::floatToBytes(blockBytes, samples, nOfSamples, S16P));
+    CPPUNIT_ASSERT(AudioMixer::bytesToFloat(blockBytes, converted, nOfSamples, S16P));
+
+    //Block conversion saturates instead of wrapping around
+    CPPUNIT_ASSERT(converted[0] == -1.0);
+    CPPUNIT_ASSERT(converted[nOfSamples - 1] > 0.999);
+
+    //Unclipped samples match the per sample conversion
+    for (unsigned i = 1; i < nOfSamples - 2; i++) {
+        CPPUNIT_ASSERT(AudioMixer::floatToBytes(sampleBytes + i*2, samples[i], S16P));
+        CPPUNIT_ASSERT(memcmp(sampleBytes + i*2, blockBytes + i*2, 2) == 0);
+        CPPUNIT_ASSERT(AudioMixer::bytesToFloat(blockBytes + i*2, fValue, S16P));
+        CPPUNIT_ASSERT(fValue == converted[i]);
+    }
+
+    CPPUNIT_ASSERT(AudioMixer::floatToBytes(blockBytes, samples, nOfSamples, FLTP));
+    CPPUNIT_ASSERT(AudioMixer::bytesToFloat(blockBytes, converted, nOfSamples, FLTP));
+    CPPUNIT_ASSERT(memcmp(samples, converted, sizeof(samples)) == 0);
+
+    CPPUNIT_ASSERT(!AudioMixer::bytesToFloat(blockBytes, converted, nOfSamples, U8));
+}
+
+void AudioMixerFunctionalTest::mixMinusTest()
+{
+    AudioMixer* mmMixer;
+    AudioHeadFilterMockup* heads[2];
+    AudioTailFilterMockup* tails[3];
+    PlanarAudioFrame* frames[2];
+    PlanarAudioFrame* mixedFrame;
+    float values[2] = {0.5, 0.25};
+    float expected[3];
+    float fValue;
+    int nOfSamples;
+    int bytesPerSample;
+    int ret;
+    std::chrono::microseconds ts;
+
+    bytesPerSample = utils::getBytesPerSampleFromFormat(sFmt);
+    mmMixer = new AudioMixer();
+    nOfSamples = mmMixer->getInputFrameSamples();
+
+    for (int h = 0; h < 2; h++) {
+        heads[h] = new AudioHeadFilterMockup(channels, sampleRate, sFmt);
+        CPPUNIT_ASSERT(heads[h]->connectOneToMany(mmMixer, h + 1));
+
+        frames[h] = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, sFmt);
+        for (int c = 0; c < channels; c++) {
+            for (int i = 0; i < nOfSamples; i++) {
+                AudioMixer::floatToBytes(frames[h]->getPlanarDataBuf()[c] + i*bytesPerSample, values[h], sFmt);
+            }
+        }
+        frames[h]->setLength(nOfSamples*bytesPerSample);
+        frames[h]->setSamples(nOfSamples);
+    }
+
+    //Bus 1 hears everyone, bus 2 everyone but channel 1 and bus 3 everyone but channel 2
+    for (int t = 0; t < 3; t++) {
+        tails[t] = new AudioTailFilterMockup();
+        CPPUNIT_ASSERT(mmMixer->connectManyToMany(tails[t], 1, t + 1));
+    }
+
+    mmMixer->configBus(2, 1);
+    mmMixer->configBus(3, 2);
+
+    expected[0] = (values[0] + values[1])*DEFAULT_MASTER_GAIN;
+    expected[1] = values[1]*DEFAULT_MASTER_GAIN;
+    expected[2] = values[0]*DEFAULT_MASTER_GAIN;
+
+    ts = std::chrono::microseconds(40000);
+
+    for (unsigned introduced = 0; introduced < mmMixer->getMixingThreshold(); introduced += nOfSamples) {
+        for (int h = 0; h < 2; h++) {
+            frames[h]->setPresentationTime(ts);
+            CPPUNIT_ASSERT(heads[h]->inject(frames[h]));
+            heads[h]->processFrame(ret);
+        }
+
+        mmMixer->processFrame(ret);
+        ts += std::chrono::microseconds(nOfSamples*std::micro::den/sampleRate);
+    }
+
+    for (int t = 0; t < 3; t++) {
+        tails[t]->processFrame(ret);
+        mixedFrame = tails[t]->extract();
+        CPPUNIT_ASSERT(mixedFrame);
+        CPPUNIT_ASSERT(mixedFrame->getSamples() == (unsigned) nOfSamples);
+
+        for (int c = 0; c < channels; c++) {
+            CPPUNIT_ASSERT(AudioMixer::bytesToFloat(mixedFrame->getPlanarDataBuf()[c], fValue, sFmt));
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[t], fValue, 1e-6);
+        }
+    }
+
+    for (int t = 0; t < 3; t++) {
+        delete tails[t];
+    }
+
+    for (int h = 0; h < 2; h++) {
+        delete heads[h];
+        delete frames[h];
+    }
+
+    delete mmMixer;
+}
+
+void AudioMixerFunctionalTest::meteringTest()
+{
+    AudioMixer* vadMixer;
+    AudioHeadFilterMockup* heads[2];
+    AudioTailFilterMockup* tail;
+    PlanarAudioFrame* frames[2];
+    PlanarAudioFrame* mixedFrame = NULL;
+    PlanarAudioFrame* outFrame;
+    Jzon::Object state;
+    //Channel 1 talks after one frame of background noise, channel 2 only has background noise
+    const float toneValue = 0.5;
+    const float noiseValue = 0.01;
+    float value;
+    float fValue;
+    int nOfSamples;
+    int bytesPerSample;
+    int ret;
+    unsigned step = 0;
+    std::chrono::microseconds ts;
+    std::chrono::microseconds frameDuration;
+
+    bytesPerSample = utils::getBytesPerSampleFromFormat(sFmt);
+    vadMixer = new AudioMixer();
+    nOfSamples = vadMixer->getInputFrameSamples();
+    frameDuration = std::chrono::microseconds(nOfSamples*std::micro::den/sampleRate);
+
+    for (int h = 0; h < 2; h++) {
+        heads[h] = new AudioHeadFilterMockup(channels, sampleRate, sFmt);
+        CPPUNIT_ASSERT(heads[h]->connectOneToMany(vadMixer, h + 1));
+
+        frames[h] = PlanarAudioFrame::createNew(channels, sampleRate, AudioFrame::getMaxSamples(sampleRate), PCM, sFmt);
+        frames[h]->setLength(nOfSamples*bytesPerSample);
+        frames[h]->setSamples(nOfSamples);
+    }
+
+    tail = new AudioTailFilterMockup();
+    CPPUNIT_ASSERT(vadMixer->connectManyToMany(tail, 1, 1));
+
+    vadMixer->configMetering(true);
+
+    ts = std::chrono::microseconds(40000);
+
+    for (unsigned introduced = 0; introduced < vadMixer->getMixingThreshold() + nOfSamples; introduced += nOfSamples) {
+        for (int h = 0; h < 2; h++) {
+            for (int c = 0; c < channels; c++) {
+                for (int i = 0; i < nOfSamples; i++) {
+                    value = h == 0 && step > 0 ? toneValue : (i % 2 ? noiseValue : -noiseValue);
+                    AudioMixer::floatToBytes(frames[h]->getPlanarDataBuf()[c] + i*bytesPerSample, value, sFmt);
+                }
+            }
+
+            frames[h]->setPresentationTime(ts);
+            CPPUNIT_ASSERT(heads[h]->inject(frames[h]));
+            heads[h]->processFrame(ret);
+        }
+
+        vadMixer->processFrame(ret);
+        tail->processFrame(ret);
+
+        if ((outFrame = tail->extract()) != NULL) {
+            mixedFrame = outFrame;
+        }
+
+        ts += frameDuration;
+        step++;
+    }
+
+    //Skipping the noise of the silent channel does not change the mix
+    CPPUNIT_ASSERT(mixedFrame);
+    CPPUNIT_ASSERT(mixedFrame->getPresentationTime() == std::chrono::microseconds(40000) + frameDuration);
+
+    for (int c = 0; c < channels; c++) {
+        CPPUNIT_ASSERT(AudioMixer::bytesToFloat(mixedFrame->getPlanarDataBuf()[c], fValue, sFmt));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(toneValue*DEFAULT_MASTER_GAIN, fValue, 1e-4);
+    }
+
+    vadMixer->getState(state);
+    CPPUNIT_ASSERT(state.Get("skipSilent").ToBool());
+
+    const Jzon::Array &gains = state.Get("gains").AsArray();
+    CPPUNIT_ASSERT(gains.GetCount() == 2);
+
+    for (Jzon::Array::const_iterator it = gains.begin(); it != gains.end(); ++it) {
+        if ((*it).Get("id").ToInt() == 1) {
+            CPPUNIT_ASSERT((*it).Get("active").ToBool());
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(20*std::log10(toneValue), (*it).Get("rms").ToFloat(), 1e-3);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(20*std::log10(toneValue), (*it).Get("peak").ToFloat(), 1e-3);
+        } else {
+            //Noise over VAD_MIN_LEVEL is not taken as voice, the noise floor is seeded with its level
+            CPPUNIT_ASSERT(!(*it).Get("active").ToBool());
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(20*std::log10(noiseValue), (*it).Get("rms").ToFloat(), 0.1);
+        }
+    }
+
+    //Only the voice activity start of channel 1 has been notified, in ms
+    const Jzon::Array &activity = state.Get("activity").AsArray();
+    CPPUNIT_ASSERT(activity.GetCount() == 1);
+    CPPUNIT_ASSERT(activity.Get(0).Get("seq").ToInt() == 0);
+    CPPUNIT_ASSERT(activity.Get(0).Get("id").ToInt() == 1);
+    CPPUNIT_ASSERT(activity.Get(0).Get("active").ToBool());
+    CPPUNIT_ASSERT(std::stoll(activity.Get(0).Get("ts").ToString()) == 
+                   std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::microseconds(40000) + frameDuration).count());
+
+    delete tail;
+
+    for (int h = 0; h < 2; h++) {
+        delete heads[h];
+        delete frames[h];
+    }
+
+    delete vadMixer;
+}
+
+void AudioMixerFunctionalTest::limiterTest()
+{
+    LookaheadLimiter limiter;
+    const unsigned block = 1024;
+    const unsigned blocks = 16;
+    const unsigned burstStart = 3000;
+    const unsigned burstEnd = 4000;
+    std::vector<float> signal[2];
+    float* planes[2];
+    float amplitude;
+    float sampleGain;
+    float prevGain = 1;
+
+    limiter.config(sampleRate, LIMITER_THRESHOLD);
+
+    //Alternating sign samples, so that the gain of each sample is its absolute value over the amplitude
+    for (int c = 0; c < 2; c++) {
+        signal[c].resize(block*blocks + limiter.getLookahead());
+
+        for (unsigned j = 0; j < signal[c].size(); j++) {
+            amplitude = j >= burstStart && j < burstEnd ? 1.0 : 0.5;
+            signal[c][j] = j % 2 ? amplitude : -amplitude;
+        }
+    }
+
+    //Samples after each block are its look-ahead, as in the mixing buffer
+    for (unsigned b = 0; b < blocks; b++) {
+        for (int c = 0; c < 2; c++) {
+            planes[c] = signal[c].data() + b*block;
+        }
+
+        limiter.process(planes, 2, block, limiter.getLookahead());
+    }
+
+    for (unsigned j = 0; j < block*blocks; j++) {
+        amplitude = j >= burstStart && j < burstEnd ? 1.0 : 0.5;
+        sampleGain = std::fabs(signal[0][j])/amplitude;
+
+        //The full scale burst is not clipped and the gain changes smoothly
+        CPPUNIT_ASSERT(std::fabs(signal[0][j]) <= LIMITER_THRESHOLD + 1e-6);
+        CPPUNIT_ASSERT(std::fabs(sampleGain - prevGain) <= 1.0/limiter.getLookahead() + 1e-6);
+        CPPUNIT_ASSERT(signal[0][j] == signal[1][j]);
+        prevGain = sampleGain;
+    }
+
+    //Levels under the threshold are not changed before the look-ahead of the burst
+    CPPUNIT_ASSERT(std::fabs(signal[0][burstStart - limiter.getLookahead() - 1]) == 0.5);
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(LIMITER_THRESHOLD, std::fabs(signal[0][burstStart]), 1e-6);
+    CPPUNIT_ASSERT(limiter.getGain() > 0.999);
+}
+
+void AudioMixerFunctionalTest::limiterChannelOrderTest()
+{
+    LookaheadLimiter limiters[2];
+    const unsigned nOfSamples = 1024;
+    std::vector<float> signal[2][2];
+    float* planes[2][2];
+
+    for (int l = 0; l < 2; l++) {
+        limiters[l].config(sampleRate, LIMITER_THRESHOLD);
+
+        for (int c = 0; c < 2; c++) {
+            signal[l][c].resize(nOfSamples + limiters[l].getLookahead());
+        }
+    }
+
+    //A quiet channel and a loud one, fed in both orders
+    for (unsigned j = 0; j < signal[0][0].size(); j++) {
+        signal[0][0][j] = 0.2*std::sin(j*0.05);
+        signal[0][1][j] = 1.5*std::sin(j*0.01);
+        signal[1][0][j] = signal[0][1][j];
+        signal[1][1][j] = signal[0][0][j];
+    }
+
+    for (int l = 0; l < 2; l++) {
+        planes[l][0] = signal[l][0].data();
+        planes[l][1] = signal[l][1].data();
+        limiters[l].process(planes[l], 2, nOfSamples, limiters[l].getLookahead());
+    }
+
+    for (unsigned j = 0; j < nOfSamples; j++) {
+        CPPUNIT_ASSERT(signal[0][0][j] == signal[1][1][j]);
+        CPPUNIT_ASSERT(signal[0][1][j] == signal[1][0][j]);
+        CPPUNIT_ASSERT(std::fabs(signal[0][1][j]) <= LIMITER_THRESHOLD + 1e-6);
+    }
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(AudioMixerFunctionalTest);
 
 int main(int argc, char* argv[])
@@ -243,7 +243,7 @@ private:
 class ManyToOneAudioScenarioMockup {
 
 public:
-    ManyToOneAudioScenarioMockup(ManyToOneFilter* fToTest): filterToTest(fToTest)
+    ManyToOneAudioScenarioMockup(BaseFilter* fToTest): filterToTest(fToTest)
     {
         tailF = new AudioTailFilterMockup();
     };
@@ -311,7 +311,7 @@ public:
 
 private:
     std::map<int,AudioHeadFilterMockup*> headFilters;
-    ManyToOneFilter *filterToTest;
+    BaseFilter *filterToTest;
     AudioTailFilterMockup *tailF;
 };
 
@@ -47,6 +47,9 @@ class SlicedVideoFrameQueueTest : public CppUnit::TestFixture
     CPPUNIT_TEST(create);
     CPPUNIT_TEST(okSliceBehaviour);
     CPPUNIT_TEST(tooManySlices);
+    CPPUNIT_TEST(earlySlices);
+    CPPUNIT_TEST(arenaWrap);
+    CPPUNIT_TEST(timedSlices);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -57,6 +60,9 @@ protected:
     void create();
     void okSliceBehaviour();
     void tooManySlices();
+    void earlySlices();
+    void arenaWrap();
+    void timedSlices();
 
     SlicedVideoFrameQueue* queue;
     unsigned maxFrames;
@@ -201,6 +207,121 @@ void SlicedVideoFrameQueueTest::tooManySlices()
     CPPUNIT_ASSERT(!outputFrame);
 }
 
+void SlicedVideoFrameQueueTest::earlySlices()
+{
+    unsigned char data[maxSliceSize + 1];
+    SlicedVideoFrame* slicedFrame;
+    Frame* outputFrame;
+    std::chrono::microseconds ts(40000);
+
+    slicedFrame = dynamic_cast<SlicedVideoFrame*>(queue->getRear());
+    CPPUNIT_ASSERT(slicedFrame);
+    slicedFrame->setPresentationTime(ts);
+    slicedFrame->setSequenceNumber(7);
+
+    //Slices are readable as soon as they are pushed, before the frame is added
+    std::fill_n(data, maxSliceSize, 1);
+    CPPUNIT_ASSERT(queue->pushSlice(data, maxSliceSize));
+    CPPUNIT_ASSERT(queue->getElements() == 1);
+
+    outputFrame = queue->getFront();
+    CPPUNIT_ASSERT(outputFrame);
+    CPPUNIT_ASSERT(*outputFrame->getDataBuf() == 1);
+    CPPUNIT_ASSERT(outputFrame->getLength() == maxSliceSize);
+    CPPUNIT_ASSERT(outputFrame->getPresentationTime() == ts);
+    CPPUNIT_ASSERT(outputFrame->getSequenceNumber() == 7);
+    queue->removeFrame();
+
+    CPPUNIT_ASSERT(!queue->pushSlice(data, maxSliceSize + 1));
+
+    //Adding the frame without pending slices does not queue anything else
+    queue->addFrame();
+    CPPUNIT_ASSERT(queue->getElements() == 0);
+}
+
+void SlicedVideoFrameQueueTest::timedSlices()
+{
+    unsigned char data[maxSliceSize];
+    SlicedVideoFrame* slicedFrame;
+    InterleavedVideoFrame* times;
+    Frame* outputFrame;
+
+    slicedFrame = dynamic_cast<SlicedVideoFrame*>(queue->getRear());
+    CPPUNIT_ASSERT(slicedFrame);
+    slicedFrame->setPresentationTime(std::chrono::microseconds(40000));
+    slicedFrame->setSequenceNumber(7);
+
+    times = InterleavedVideoFrame::createNew(H264, 0);
+    times->setPresentationTime(std::chrono::microseconds(80000));
+    times->setSequenceNumber(9);
+    times->setSize(320, 240);
+
+    //Given times are used instead of the input frame ones
+    std::fill_n(data, maxSliceSize, 2);
+    CPPUNIT_ASSERT(queue->pushSlice(data, maxSliceSize, times));
+
+    outputFrame = queue->getFront();
+    CPPUNIT_ASSERT(outputFrame);
+    CPPUNIT_ASSERT(*outputFrame->getDataBuf() == 2);
+    CPPUNIT_ASSERT(outputFrame->getPresentationTime() == std::chrono::microseconds(80000));
+    CPPUNIT_ASSERT(outputFrame->getSequenceNumber() == 9);
+    CPPUNIT_ASSERT(dynamic_cast<VideoFrame*>(outputFrame)->getWidth() == 320);
+    queue->removeFrame();
+
+    CPPUNIT_ASSERT(queue->pushSlice(data, maxSliceSize));
+    outputFrame = queue->getFront();
+    CPPUNIT_ASSERT(outputFrame->getSequenceNumber() == 7);
+    queue->removeFrame();
+
+    delete times;
+}
+
+void SlicedVideoFrameQueueTest::arenaWrap()
+{
+    unsigned char data[maxSliceSize];
+    unsigned sizes[maxFrames - 1];
+    Frame* outputFrame;
+
+    //Slices of different sizes wrap around the arena many times, unread ones are never overwritten
+    for (unsigned i = 0; i < 40; i++) {
+        for (unsigned j = 0; j < maxFrames - 1; j++) {
+            sizes[j] = (i * 7 + j * 5) % maxSliceSize + 1;
+            std::fill_n(data, sizes[j], i + j);
+            CPPUNIT_ASSERT(queue->pushSlice(data, sizes[j]));
+        }
+
+        CPPUNIT_ASSERT(queue->getElements() == maxFrames - 1);
+
+        for (unsigned j = 0; j < maxFrames - 1; j++) {
+            outputFrame = queue->getFront();
+            CPPUNIT_ASSERT(outputFrame);
+            CPPUNIT_ASSERT(outputFrame->getLength() == sizes[j]);
+            CPPUNIT_ASSERT(outputFrame->getDataBuf()[0] == i + j);
+            CPPUNIT_ASSERT(outputFrame->getDataBuf()[sizes[j] - 1] == i + j);
+            queue->removeFrame();
+        }
+    }
+
+    //The last removed slice is kept while newer ones are pushed
+    outputFrame = queue->forceGetFront();
+    CPPUNIT_ASSERT(outputFrame->getDataBuf()[0] == 39 + maxFrames - 2);
+
+    for (unsigned j = 0; j < maxFrames - 1; j++) {
+        std::fill_n(data, maxSliceSize, 100 + j);
+        CPPUNIT_ASSERT(queue->pushSlice(data, maxSliceSize));
+    }
+
+    CPPUNIT_ASSERT(outputFrame->getDataBuf()[0] == 39 + maxFrames - 2);
+    CPPUNIT_ASSERT(outputFrame->getDataBuf()[outputFrame->getLength() - 1] == 39 + maxFrames - 2);
+
+    for (unsigned j = 0; j < maxFrames - 1; j++) {
+        outputFrame = queue->getFront();
+        CPPUNIT_ASSERT(outputFrame->getDataBuf()[0] == 100 + j);
+        CPPUNIT_ASSERT(outputFrame->getDataBuf()[maxSliceSize - 1] == 100 + j);
+        queue->removeFrame();
+    }
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(SlicedVideoFrameQueueTest);
 
 int main(int argc, char* argv[])
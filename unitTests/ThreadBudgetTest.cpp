@@ -0,0 +1,153 @@
+/*
+ *  ThreadBudgetTest.cpp - ThreadBudget class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <fstream>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "ThreadBudget.hh"
+#include "Utils.hh"
+
+#define CORES 16
+#define POOL_THREADS 4
+
+class ThreadBudgetTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(ThreadBudgetTest);
+    CPPUNIT_TEST(poolTest);
+    CPPUNIT_TEST(shareTest);
+    CPPUNIT_TEST(oversubscriptionTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void poolTest();
+    void shareTest();
+    void oversubscriptionTest();
+
+private:
+    ThreadBudget* budget;
+};
+
+void ThreadBudgetTest::setUp()
+{
+    budget = new ThreadBudget(CORES, POOL_THREADS);
+}
+
+void ThreadBudgetTest::tearDown()
+{
+    delete budget;
+}
+
+void ThreadBudgetTest::poolTest()
+{
+    ThreadBudget defaultBudget(CORES);
+    ThreadBudget smallBudget(1);
+    ThreadBudget bigPoolBudget(CORES, 2 * CORES);
+
+    CPPUNIT_ASSERT(budget->getPoolThreads() == POOL_THREADS);
+    CPPUNIT_ASSERT(budget->getEncoderCores() == CORES - POOL_THREADS);
+    CPPUNIT_ASSERT(defaultBudget.getPoolThreads() == CORES * BUDGET_POOL_SHARE);
+    CPPUNIT_ASSERT(smallBudget.getPoolThreads() == 1);
+    CPPUNIT_ASSERT(bigPoolBudget.getPoolThreads() == CORES);
+    CPPUNIT_ASSERT(bigPoolBudget.getEncoderCores() == 0);
+}
+
+void ThreadBudgetTest::shareTest()
+{
+    std::map<int, unsigned> changes;
+
+    CPPUNIT_ASSERT(!budget->addEncoder(1, 0));
+    CPPUNIT_ASSERT(budget->addEncoder(1));
+
+    changes = budget->rebalance();
+    CPPUNIT_ASSERT(changes.size() == 1);
+    CPPUNIT_ASSERT(changes[1] == CORES - POOL_THREADS);
+
+    CPPUNIT_ASSERT(budget->rebalance().empty());
+
+    CPPUNIT_ASSERT(budget->addEncoder(2, 2));
+    changes = budget->rebalance();
+    CPPUNIT_ASSERT(changes.size() == 2);
+    CPPUNIT_ASSERT(budget->getEncoderThreads(1) == 4);
+    CPPUNIT_ASSERT(budget->getEncoderThreads(2) == 8);
+
+    CPPUNIT_ASSERT(budget->removeEncoder(1));
+    CPPUNIT_ASSERT(!budget->removeEncoder(1));
+    CPPUNIT_ASSERT(budget->getEncoderThreads(1) == 0);
+
+    changes = budget->rebalance();
+    CPPUNIT_ASSERT(changes.size() == 1);
+    CPPUNIT_ASSERT(changes[2] == CORES - POOL_THREADS);
+}
+
+void ThreadBudgetTest::oversubscriptionTest()
+{
+    unsigned total = 0;
+
+    for (int i = 0; i < 8; i++) {
+        CPPUNIT_ASSERT(budget->addEncoder(i));
+    }
+
+    budget->rebalance();
+
+    for (int i = 0; i < 8; i++) {
+        total += budget->getEncoderThreads(i);
+    }
+
+    CPPUNIT_ASSERT(total <= CORES - POOL_THREADS);
+
+    for (int i = 8; i < 20; i++) {
+        CPPUNIT_ASSERT(budget->addEncoder(i));
+    }
+
+    budget->rebalance();
+
+    for (int i = 0; i < 20; i++) {
+        CPPUNIT_ASSERT(budget->getEncoderThreads(i) == BUDGET_MIN_ENCODER_THREADS);
+    }
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ThreadBudgetTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("ThreadBudgetTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("", false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -69,6 +69,7 @@ class DashVideoSegmenterAVCTest : public CppUnit::TestFixture
     CPPUNIT_TEST(manageNonVCLNals);
     CPPUNIT_TEST(manageIDRNals);
     CPPUNIT_TEST(manageNonIDRNals);
+    CPPUNIT_TEST(manageReorderedNals);
     CPPUNIT_TEST(generateInitSegment);
     CPPUNIT_TEST(appendFrameToDashSegment);
     CPPUNIT_TEST(generateSegment);
@@ -83,6 +84,7 @@ protected:
     void manageNonVCLNals();
     void manageIDRNals();
     void manageNonIDRNals();
+    void manageReorderedNals();
     void generateInitSegment();
     void appendFrameToDashSegment();
     void generateSegment();
@@ -222,6 +224,31 @@ void DashVideoSegmenterAVCTest::manageIDRNals()
     CPPUNIT_ASSERT(vFrame->getLength() == idrNal->getLength() - nalStartCodeLength + avccHeaderLength);
 }
 
+void DashVideoSegmenterAVCTest::manageReorderedNals()
+{
+    Frame* frame;
+    std::chrono::microseconds timestamp(1000);
+
+    //Frames coded with B-frames are decoded before being presented
+    idrNal->setPresentationTime(timestamp + frameTime);
+    idrNal->setDecodeTime(timestamp);
+    idrNal->setSize(WIDTH, HEIGHT);
+    frame = segmenter->manageFrame(idrNal);
+    CPPUNIT_ASSERT(!frame);
+    CPPUNIT_ASSERT(segmenter->getFrameDataSize() <= 0);
+
+    //Frames in presentation order keep their decode time
+    idrNal->setPresentationTime(timestamp + frameTime);
+    frame = segmenter->manageFrame(idrNal);
+    CPPUNIT_ASSERT(!frame);
+    CPPUNIT_ASSERT(segmenter->getFrameDataSize() > 0);
+
+    audNal->setPresentationTime(timestamp + 2*frameTime);
+    frame = segmenter->manageFrame(audNal);
+    CPPUNIT_ASSERT(frame);
+    CPPUNIT_ASSERT(frame->getDecodeTime() == timestamp + frameTime);
+}
+
 void DashVideoSegmenterAVCTest::manageNonIDRNals()
 {
     Frame* frame;
@@ -0,0 +1,403 @@
+/*
+ *  FrameRateConverterTest.cpp - FrameRateConverter class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/frameRateConverter/FrameRateConverter.hh"
+#include "AVFramedQueue.hh"
+
+#define WIDTH 32
+#define HEIGHT 32
+
+class FrameRateConverterMock : public FrameRateConverter {
+public:
+    FrameRateConverterMock(unsigned fps, FrameRateMode mode) : FrameRateConverter(fps, mode) {};
+    using FrameRateConverter::configure0;
+
+    //Out of processFrame there are no more destination frames, so only the first slot is written
+    bool process(Frame *org, Frame *dst) {
+        org->setConsumed(true);
+        dst->setConsumed(false);
+
+        return doProcessFrame(org, dst);
+    };
+
+    int getStateValue(std::string key) {
+        Jzon::Object state;
+        doGetState(state);
+        return state.Get(key).ToInt();
+    };
+};
+
+/*! Writes raw frames with the given presentation times */
+class RawFramesHeadMock : public HeadFilter {
+public:
+    RawFramesHeadMock() : HeadFilter() {
+        outputStreamInfo = new StreamInfo(VIDEO);
+        outputStreamInfo->video.codec = RAW;
+        outputStreamInfo->video.pixelFormat = YUV420P;
+    };
+
+    ~RawFramesHeadMock() {delete outputStreamInfo;};
+
+    void write(std::chrono::microseconds ts) {
+        int ret;
+        nextTs = ts;
+        processFrame(ret);
+    };
+
+    void doGetState(Jzon::Object &filterNode) {};
+
+protected:
+    bool doProcessFrame(std::map<int, Frame*> &dstFrames) {
+        InterleavedVideoFrame *dst = dynamic_cast<InterleavedVideoFrame*>(dstFrames.begin()->second);
+
+        dst->setSize(WIDTH, HEIGHT);
+        dst->setPixelFormat(YUV420P);
+        dst->setLength(WIDTH*HEIGHT*3/2);
+        dst->setPresentationTime(nextTs);
+        dst->setConsumed(true);
+        return true;
+    };
+
+private:
+    FrameQueue *allocQueue(ConnectionData cData) {
+        return VideoFrameQueue::createNew(cData, outputStreamInfo, DEFAULT_RAW_VIDEO_FRAMES);
+    };
+
+    bool specificWriterConfig(int /*writerID*/) {return true;};
+    bool specificWriterDelete(int /*writerID*/) {return true;};
+
+    StreamInfo *outputStreamInfo;
+    std::chrono::microseconds nextTs;
+};
+
+/*! Reader of the converted frames, which keeps their presentation times */
+class RawFramesReaderMock : public TailFilter {
+public:
+    RawFramesReaderMock() : TailFilter() {};
+
+    void readAll() {
+        int ret;
+
+        for (unsigned i = 0; i < DEFAULT_RAW_VIDEO_FRAMES; i++) {
+            processFrame(ret);
+        }
+    };
+
+    std::vector<std::chrono::microseconds> times;
+
+protected:
+    bool doProcessFrame(std::map<int, Frame*> &orgFrames, std::vector<int> newFrames) {
+        if (!newFrames.empty()) {
+            times.push_back(orgFrames.begin()->second->getPresentationTime());
+        }
+        return true;
+    };
+
+    void doGetState(Jzon::Object &filterNode) {};
+    bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/) {return true;};
+    bool specificReaderDelete(int /*readerID*/) {return true;};
+};
+
+class FrameRateConverterTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(FrameRateConverterTest);
+    CPPUNIT_TEST(constructorTest);
+    CPPUNIT_TEST(configureTest);
+    CPPUNIT_TEST(dropTest);
+    CPPUNIT_TEST(repeatTest);
+    CPPUNIT_TEST(repeatedFramesTest);
+    CPPUNIT_TEST(blendTest);
+    CPPUNIT_TEST(planarViewBlendTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void constructorTest();
+    void configureTest();
+    void dropTest();
+    void repeatTest();
+    void repeatedFramesTest();
+    void blendTest();
+    void planarViewBlendTest();
+
+    void setPlanarView(InterleavedVideoFrame *frame, std::shared_ptr<unsigned char> buffer,
+                       unsigned char y, unsigned char u, unsigned char v);
+
+    InterleavedVideoFrame *org;
+    InterleavedVideoFrame *dst;
+};
+
+void FrameRateConverterTest::setUp()
+{
+    org = InterleavedVideoFrame::createNew(RAW, WIDTH, HEIGHT, YUV420P);
+    dst = InterleavedVideoFrame::createNew(RAW, WIDTH, HEIGHT, YUV420P);
+    org->setLength(WIDTH*HEIGHT*3/2);
+}
+
+void FrameRateConverterTest::tearDown()
+{
+    delete org;
+    delete dst;
+}
+
+void FrameRateConverterTest::constructorTest()
+{
+    FrameRateConverter* converter;
+
+    converter = FrameRateConverter::createNew(0);
+    CPPUNIT_ASSERT(!converter);
+
+    converter = FrameRateConverter::createNew(25, FRM_NONE);
+    CPPUNIT_ASSERT(!converter);
+
+    converter = FrameRateConverter::createNew();
+    CPPUNIT_ASSERT(converter);
+    CPPUNIT_ASSERT(converter->getType() == FRAME_RATE_CONVERTER);
+
+    delete converter;
+}
+
+void FrameRateConverterTest::configureTest()
+{
+    FrameRateConverterMock converter(25, DROP);
+
+    CPPUNIT_ASSERT(converter.configure0(30, BLEND));
+    CPPUNIT_ASSERT(!converter.configure0(0, DROP));
+    CPPUNIT_ASSERT(!converter.configure0(MAX_FPS + 1, DROP));
+    CPPUNIT_ASSERT(!converter.configure0(30, FRM_NONE));
+    CPPUNIT_ASSERT(converter.getStateValue("fps") == 30);
+
+    CPPUNIT_ASSERT(getFrameRateModeFromString("blend") == BLEND);
+    CPPUNIT_ASSERT(getFrameRateModeFromString("foo") == FRM_NONE);
+    CPPUNIT_ASSERT(getFrameRateModeAsString(DROP) == "drop");
+}
+
+void FrameRateConverterTest::dropTest()
+{
+    FrameRateConverterMock converter(25, DROP);
+    std::vector<int> outputTs;
+    int emitted = 0;
+
+    //30 fps to 25 fps: one frame out of six is dropped
+    for (int i = 0; i < 30; i++) {
+        org->setPresentationTime(std::chrono::microseconds(1000 + i * 33333));
+        if (converter.process(org, dst)) {
+            CPPUNIT_ASSERT(dst->getConsumed());
+            outputTs.push_back(dst->getPresentationTime().count());
+            CPPUNIT_ASSERT(dst->isView());
+            CPPUNIT_ASSERT(dst->getDataBuf() == org->getDataBuf());
+            emitted++;
+        }
+    }
+
+    CPPUNIT_ASSERT(emitted == 25);
+    CPPUNIT_ASSERT(converter.getStateValue("dropped") == 5);
+
+    //Output timestamps follow the output cadence
+    for (size_t i = 0; i < outputTs.size(); i++) {
+        CPPUNIT_ASSERT(outputTs[i] == 1000 + (int) i * 40000);
+    }
+}
+
+void FrameRateConverterTest::repeatTest()
+{
+    FrameRateConverterMock converter(50, DROP);
+
+    //25 fps to 50 fps: every frame is used twice
+    for (int i = 0; i < 10; i++) {
+        org->setPresentationTime(std::chrono::microseconds(i * 40000));
+        CPPUNIT_ASSERT(converter.process(org, dst));
+    }
+
+    CPPUNIT_ASSERT(converter.getStateValue("dropped") == 0);
+    CPPUNIT_ASSERT(converter.getStateValue("repeated") == 9);
+
+    //Timestamp gaps restart the cadence instead of flooding the queue
+    org->setPresentationTime(std::chrono::microseconds(10 * 1000000));
+    CPPUNIT_ASSERT(converter.process(org, dst));
+    CPPUNIT_ASSERT(converter.getStateValue("repeated") == 9);
+    CPPUNIT_ASSERT(dst->getPresentationTime().count() == 10 * 1000000);
+}
+
+void FrameRateConverterTest::repeatedFramesTest()
+{
+    FrameRateConverter *converter = FrameRateConverter::createNew(50, DROP);
+    RawFramesHeadMock *head = new RawFramesHeadMock();
+    RawFramesReaderMock *reader = new RawFramesReaderMock();
+    std::vector<int> enabledJobs;
+    int ret;
+
+    head->setId(1);
+    converter->setId(2);
+    reader->setId(3);
+    CPPUNIT_ASSERT(head->connectOneToOne(converter));
+    CPPUNIT_ASSERT(converter->connectOneToOne(reader));
+
+    //25 fps to 50 fps: the repeated frames are queued within the same processFrame
+    for (int i = 0; i < 5; i++) {
+        head->write(std::chrono::microseconds(i * 40000));
+        enabledJobs = converter->processFrame(ret);
+        CPPUNIT_ASSERT(std::count(enabledJobs.begin(), enabledJobs.end(), reader->getId()) > 0);
+        reader->readAll();
+    }
+
+    CPPUNIT_ASSERT(reader->times.size() == 9);
+
+    for (size_t i = 0; i < reader->times.size(); i++) {
+        CPPUNIT_ASSERT(reader->times[i] == std::chrono::microseconds(i * 20000));
+    }
+
+    delete reader;
+    delete converter;
+    delete head;
+}
+
+void FrameRateConverterTest::blendTest()
+{
+    FrameRateConverterMock converter(25, BLEND);
+
+    //50 fps to 25 fps, with an offset that puts output slots between input frames
+    memset(org->getDataBuf(), 0, org->getLength());
+    org->setPresentationTime(std::chrono::microseconds(0));
+    CPPUNIT_ASSERT(converter.process(org, dst));
+
+    memset(org->getDataBuf(), 200, org->getLength());
+    org->setPresentationTime(std::chrono::microseconds(20000));
+    CPPUNIT_ASSERT(!converter.process(org, dst));
+
+    memset(org->getDataBuf(), 100, org->getLength());
+    org->setPresentationTime(std::chrono::microseconds(50000));
+    CPPUNIT_ASSERT(converter.process(org, dst));
+
+    CPPUNIT_ASSERT(!dst->isView());
+    CPPUNIT_ASSERT(dst->getPresentationTime().count() == 40000);
+    CPPUNIT_ASSERT(dst->getLength() == org->getLength());
+
+    //Slot is at 2/3 between 200 and 100
+    CPPUNIT_ASSERT(dst->getDataBuf()[0] >= 132 && dst->getDataBuf()[0] <= 134);
+    CPPUNIT_ASSERT(dst->getDataBuf()[org->getLength() - 1] == dst->getDataBuf()[0]);
+}
+
+void FrameRateConverterTest::setPlanarView(InterleavedVideoFrame *frame, std::shared_ptr<unsigned char> buffer,
+                                           unsigned char y, unsigned char u, unsigned char v)
+{
+    unsigned char *planes[MAX_PLANES] = {NULL};
+    int strides[MAX_PLANES] = {0};
+
+    //Padded lines and chroma planes in reverse order, as decoders may lay them out
+    strides[0] = WIDTH + 16;
+    strides[1] = WIDTH/2 + 16;
+    strides[2] = WIDTH/2 + 16;
+    planes[0] = buffer.get();
+    planes[2] = planes[0] + strides[0] * HEIGHT;
+    planes[1] = planes[2] + strides[2] * HEIGHT/2;
+
+    memset(buffer.get(), 255, strides[0] * HEIGHT + strides[1] * HEIGHT);
+    for (int i = 0; i < HEIGHT; i++) {
+        memset(planes[0] + i * strides[0], y, WIDTH);
+    }
+    for (int i = 0; i < HEIGHT/2; i++) {
+        memset(planes[1] + i * strides[1], u, WIDTH/2);
+        memset(planes[2] + i * strides[2], v, WIDTH/2);
+    }
+
+    frame->setPlanarView(buffer, planes, strides);
+}
+
+void FrameRateConverterTest::planarViewBlendTest()
+{
+    FrameRateConverterMock converter(25, BLEND);
+    InterleavedVideoFrame *view = InterleavedVideoFrame::createNew(RAW, WIDTH, HEIGHT, YUV420P);
+    std::shared_ptr<unsigned char> buffers[3];
+    unsigned char *planes[MAX_PLANES];
+    int strides[MAX_PLANES];
+
+    for (int i = 0; i < 3; i++) {
+        buffers[i].reset(new unsigned char [(WIDTH + 16) * HEIGHT * 2], std::default_delete<unsigned char[]>());
+    }
+
+    view->setLength(WIDTH*HEIGHT*3/2);
+
+    setPlanarView(view, buffers[0], 0, 10, 20);
+    view->setPresentationTime(std::chrono::microseconds(0));
+    CPPUNIT_ASSERT(converter.process(view, dst));
+
+    setPlanarView(view, buffers[1], 200, 110, 220);
+    view->setPresentationTime(std::chrono::microseconds(20000));
+    CPPUNIT_ASSERT(!converter.process(view, dst));
+
+    setPlanarView(view, buffers[2], 100, 50, 160);
+    view->setPresentationTime(std::chrono::microseconds(50000));
+    CPPUNIT_ASSERT(converter.process(view, dst));
+
+    CPPUNIT_ASSERT(!dst->isView());
+    CPPUNIT_ASSERT(dst->getPresentationTime().count() == 40000);
+    CPPUNIT_ASSERT(dst->getLength() == WIDTH*HEIGHT*3/2);
+    CPPUNIT_ASSERT(dst->getPlanes(planes, strides) == 3);
+
+    //Each plane is blended with its own samples, padding is left out. Slot is at 2/3 between frames
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            CPPUNIT_ASSERT(planes[0][y * strides[0] + x] >= 132 && planes[0][y * strides[0] + x] <= 134);
+        }
+    }
+
+    for (int y = 0; y < HEIGHT/2; y++) {
+        for (int x = 0; x < WIDTH/2; x++) {
+            CPPUNIT_ASSERT(planes[1][y * strides[1] + x] >= 69 && planes[1][y * strides[1] + x] <= 71);
+            CPPUNIT_ASSERT(planes[2][y * strides[2] + x] >= 179 && planes[2][y * strides[2] + x] <= 181);
+        }
+    }
+
+    delete view;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FrameRateConverterTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("FrameRateConverterTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("", false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+ *  RateControllerTest.cpp - RateController class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <fstream>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/transmitter/RateController.hh"
+#include "Utils.hh"
+
+#define MIN_BITRATE 300
+#define MAX_BITRATE 3000
+#define FPS 25
+#define RTT 20
+
+class RateControllerTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(RateControllerTest);
+    CPPUNIT_TEST(lossTest);
+    CPPUNIT_TEST(delayTest);
+    CPPUNIT_TEST(boundsTest);
+    CPPUNIT_TEST(receiverReportTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void lossTest();
+    void delayTest();
+    void boundsTest();
+    void receiverReportTest();
+
+    RateController* controller;
+};
+
+void RateControllerTest::setUp()
+{
+    controller = new RateController(MIN_BITRATE, MAX_BITRATE, FPS);
+}
+
+void RateControllerTest::tearDown()
+{
+    delete controller;
+}
+
+void RateControllerTest::lossTest()
+{
+    CPPUNIT_ASSERT(!controller->update(0, RTT, MAX_BITRATE));
+    CPPUNIT_ASSERT(controller->getBitrate() == MAX_BITRATE);
+
+    //Multiplicative decrease proportional to the losses
+    CPPUNIT_ASSERT(controller->update(20, RTT, MAX_BITRATE));
+    CPPUNIT_ASSERT(controller->getBitrate() == 2700);
+
+    //The next report is only observed
+    CPPUNIT_ASSERT(!controller->update(0, RTT, 2700));
+    CPPUNIT_ASSERT(controller->getBitrate() == 2700);
+
+    CPPUNIT_ASSERT(controller->update(0, RTT, 2700));
+    CPPUNIT_ASSERT(controller->getBitrate() == 2916);
+
+    //Moderate losses hold the bitrate
+    CPPUNIT_ASSERT(!controller->update(5, RTT, 2916));
+    CPPUNIT_ASSERT(controller->getBitrate() == 2916);
+    CPPUNIT_ASSERT(controller->getFps() == FPS);
+}
+
+void RateControllerTest::delayTest()
+{
+    CPPUNIT_ASSERT(!controller->update(0, RTT, MAX_BITRATE));
+
+    //Growing round trip delay brings the bitrate under the sent one
+    CPPUNIT_ASSERT(controller->update(0, RTT + 200, 1000));
+    CPPUNIT_ASSERT(controller->getBitrate() == 850);
+    CPPUNIT_ASSERT(controller->getFps() == FPS);
+
+    CPPUNIT_ASSERT(!controller->update(0, RTT, 850));
+    CPPUNIT_ASSERT(controller->update(0, RTT, 850));
+    CPPUNIT_ASSERT(controller->getBitrate() == 918);
+}
+
+void RateControllerTest::boundsTest()
+{
+    for (int i = 0; i < 20; i++) {
+        controller->update(50, RTT, 0);
+    }
+
+    CPPUNIT_ASSERT(controller->getBitrate() == MIN_BITRATE);
+    CPPUNIT_ASSERT(controller->getFps() == FPS/2);
+
+    for (int i = 0; i < 100; i++) {
+        controller->update(0, RTT, 0);
+    }
+
+    CPPUNIT_ASSERT(controller->getBitrate() == MAX_BITRATE);
+    CPPUNIT_ASSERT(controller->getFps() == FPS);
+}
+
+void RateControllerTest::receiverReportTest()
+{
+    //Raw receiver report values: 13/256 lost and 20 ms of round trip delay
+    CPPUNIT_ASSERT(RateController::lossPercentage(13) == 5);
+    CPPUNIT_ASSERT(RateController::rttMs(1311) == 20);
+    CPPUNIT_ASSERT(RateController::lossPercentage(255) == 99);
+    CPPUNIT_ASSERT(RateController::rttMs(65536) == 1000);
+
+    CPPUNIT_ASSERT(!controller->update(RateController::lossPercentage(0),
+                                       RateController::rttMs(1311), MAX_BITRATE));
+
+    //Moderate losses and a stable delay hold the bitrate
+    CPPUNIT_ASSERT(!controller->update(RateController::lossPercentage(13),
+                                       RateController::rttMs(1376), MAX_BITRATE));
+    CPPUNIT_ASSERT(controller->getBitrate() == MAX_BITRATE);
+
+    //51/256 lost is a 19% loss ratio
+    CPPUNIT_ASSERT(controller->update(RateController::lossPercentage(51),
+                                      RateController::rttMs(1311), MAX_BITRATE));
+    CPPUNIT_ASSERT(controller->getBitrate() == 2715);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RateControllerTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("RateControllerTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("", false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
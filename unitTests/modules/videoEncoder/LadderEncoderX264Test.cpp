@@ -0,0 +1,239 @@
+/*
+ *  LadderEncoderX264Test - LadderEncoderX264 class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoEncoder/LadderEncoderX264.hh"
+
+class LadderEncoderX264Mock : public LadderEncoderX264 {
+public:
+    LadderEncoderX264Mock(unsigned gop) : LadderEncoderX264(VIDEO_DEFAULT_FRAMERATE, gop, 1, DEFAULT_PRESET) {};
+    using LadderEncoderX264::configRendition0;
+    using LadderEncoderX264::configure0;
+    using LadderEncoderX264::keyframeDecision;
+    using LadderEncoderX264::configSegments0;
+    using LadderEncoderX264::allocQueue;
+    using LadderEncoderX264::specificWriterConfig;
+    using LadderEncoderX264::specificWriterDelete;
+};
+
+class LadderEncoderX264Test : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(LadderEncoderX264Test);
+    CPPUNIT_TEST(constructorTest);
+    CPPUNIT_TEST(renditionConfigTest);
+    CPPUNIT_TEST(sceneAnalyzerTest);
+    CPPUNIT_TEST(keyframeTest);
+    CPPUNIT_TEST(segmentTest);
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    void constructorTest();
+    void renditionConfigTest();
+    void sceneAnalyzerTest();
+    void keyframeTest();
+    void segmentTest();
+};
+
+void LadderEncoderX264Test::constructorTest()
+{
+    LadderEncoderX264* encoder;
+
+    encoder = LadderEncoderX264::createNew(0);
+    CPPUNIT_ASSERT(!encoder);
+
+    encoder = LadderEncoderX264::createNew(25, 25, 1, "");
+    CPPUNIT_ASSERT(!encoder);
+
+    encoder = LadderEncoderX264::createNew();
+    CPPUNIT_ASSERT(encoder);
+    CPPUNIT_ASSERT(encoder->getType() == LADDER_ENCODER);
+
+    delete encoder;
+}
+
+void LadderEncoderX264Test::renditionConfigTest()
+{
+    LadderEncoderX264Mock* encoder;
+    FrameQueue *queue;
+    ConnectionData cData;
+    int id = 100;
+
+    encoder = new LadderEncoderX264Mock(DEFAULT_GOP);
+
+    CPPUNIT_ASSERT(!encoder->configRendition0(id, 1280, 720, 3000));
+
+    CPPUNIT_ASSERT(encoder->specificWriterConfig(id));
+    CPPUNIT_ASSERT(!encoder->specificWriterConfig(id));
+
+    CPPUNIT_ASSERT(encoder->configRendition0(id, 1280, 720, 3000));
+    CPPUNIT_ASSERT(!encoder->configRendition0(id, 0, 720, 3000));
+    CPPUNIT_ASSERT(!encoder->configRendition0(id, 1281, 720, 3000));
+    CPPUNIT_ASSERT(!encoder->configRendition0(id, 1280, 720, 0));
+
+    CPPUNIT_ASSERT(!encoder->configure0(0, DEFAULT_GOP, 1, DEFAULT_PRESET, true));
+    CPPUNIT_ASSERT(!encoder->configure0(25, 0, 1, DEFAULT_PRESET, true));
+    CPPUNIT_ASSERT(encoder->configure0(30, 60, 2, "veryfast", false));
+
+    cData.writerId = id;
+    queue = encoder->allocQueue(cData);
+    CPPUNIT_ASSERT(queue);
+    CPPUNIT_ASSERT(queue->getStreamInfo()->video.codec == H264);
+    CPPUNIT_ASSERT(queue->getStreamInfo()->video.width == 1280);
+    CPPUNIT_ASSERT(queue->getStreamInfo()->video.height == 720);
+    delete queue;
+
+    CPPUNIT_ASSERT(encoder->specificWriterDelete(id));
+    CPPUNIT_ASSERT(!encoder->specificWriterDelete(id));
+
+    delete encoder;
+}
+
+void LadderEncoderX264Test::sceneAnalyzerTest()
+{
+    SceneAnalyzer analyzer;
+    int width = 64;
+    int height = 64;
+    unsigned char luma[width*height];
+
+    std::memset(luma, 100, sizeof(luma));
+    CPPUNIT_ASSERT(!analyzer.analyze(luma, width, height, width));
+    CPPUNIT_ASSERT(!analyzer.analyze(luma, width, height, width));
+
+    //Slight changes are motion inside the scene
+    std::memset(luma, 104, sizeof(luma));
+    CPPUNIT_ASSERT(!analyzer.analyze(luma, width, height, width));
+    CPPUNIT_ASSERT(analyzer.getDifference() == 4);
+
+    std::memset(luma, 200, sizeof(luma));
+    CPPUNIT_ASSERT(analyzer.analyze(luma, width, height, width));
+
+    //After a reset there is nothing to compare with
+    analyzer.reset();
+    std::memset(luma, 0, sizeof(luma));
+    CPPUNIT_ASSERT(!analyzer.analyze(luma, width, height, width));
+}
+
+void LadderEncoderX264Test::keyframeTest()
+{
+    LadderEncoderX264Mock* encoder;
+    LadderRendition rendition;
+    InterleavedVideoFrame *picture;
+    unsigned gop = 20;
+    std::vector<unsigned> keys;
+
+    encoder = new LadderEncoderX264Mock(gop);
+    rendition.config(64, 64, DEFAULT_RENDITION_BITRATE);
+    picture = rendition.getPicture();
+    CPPUNIT_ASSERT(picture);
+
+    std::memset(picture->getDataBuf(), 100, 64*64);
+
+    for (unsigned i = 0; i < 80; i++) {
+        //A scene cut too close to the previous keyframe is ignored
+        if (i == 2 || i == 30) {
+            std::memset(picture->getDataBuf(), i == 2 ? 200 : 50, 64*64);
+        }
+
+        if (encoder->keyframeDecision(&rendition, std::chrono::microseconds(i * 40000))) {
+            keys.push_back(i);
+        }
+    }
+
+    CPPUNIT_ASSERT(keys.size() == 5);
+    CPPUNIT_ASSERT(keys[0] == 0);
+    CPPUNIT_ASSERT(keys[1] == 20);
+    CPPUNIT_ASSERT(keys[2] == 30);
+    CPPUNIT_ASSERT(keys[3] == 50);
+    CPPUNIT_ASSERT(keys[4] == 70);
+
+    delete encoder;
+}
+
+void LadderEncoderX264Test::segmentTest()
+{
+    LadderEncoderX264Mock* encoders[2];
+    LadderRendition rendition;
+    InterleavedVideoFrame *picture;
+    std::chrono::microseconds pTime(0);
+    std::vector<unsigned> keys[2];
+
+    //Both encoders place keyframes at the same frames, whatever their gop
+    encoders[0] = new LadderEncoderX264Mock(20);
+    encoders[1] = new LadderEncoderX264Mock(7);
+    rendition.config(64, 64, DEFAULT_RENDITION_BITRATE);
+    picture = rendition.getPicture();
+    CPPUNIT_ASSERT(picture);
+
+    std::memset(picture->getDataBuf(), 100, 64*64);
+
+    for (int i = 0; i < 2; i++) {
+        CPPUNIT_ASSERT(encoders[i]->configure0(VIDEO_DEFAULT_FRAMERATE, i == 0 ? 20 : 7, 1, DEFAULT_PRESET, false));
+        CPPUNIT_ASSERT(encoders[i]->configSegments0(1000));
+    }
+
+    //Input frame rate wobbles between 25 and 30 fps
+    for (unsigned i = 0; i < 100; i++) {
+        for (int j = 0; j < 2; j++) {
+            if (encoders[j]->keyframeDecision(&rendition, pTime)) {
+                keys[j].push_back(pTime.count() / 1000);
+            }
+        }
+
+        pTime += std::chrono::microseconds(i % 2 == 0 ? 40000 : 33333);
+    }
+
+    CPPUNIT_ASSERT(keys[0] == keys[1]);
+    CPPUNIT_ASSERT(keys[0].size() == 4);
+
+    for (unsigned i = 0; i < keys[0].size(); i++) {
+        CPPUNIT_ASSERT(keys[0][i] >= i * 1000 && keys[0][i] < i * 1000 + 40);
+    }
+
+    delete encoders[0];
+    delete encoders[1];
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LadderEncoderX264Test);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("LadderEncoderX264Test.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("", false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+/*
+ *  VideoEncoderPluginTest - VideoEncoderPlugin class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This file is part of media-streamer.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <deque>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoEncoder/VideoEncoderPlugin.hh"
+
+#define WIDTH 64
+#define HEIGHT 48
+
+/*! Backend returning each picture delay submits later, as backends with lookahead do */
+class DelayedBackendMock : public EncoderBackend {
+public:
+    DelayedBackendMock() : opens(0), rateChanges(0), delay(1) {};
+
+    std::string getName() {return "mock";};
+
+    EncoderCapabilities getCapabilities() {
+        EncoderCapabilities caps;
+        caps.codec = VP8;
+        caps.inputFormats = {YUV420P};
+        caps.rateReconfig = true;
+        caps.forceKeyframe = true;
+        caps.maxThreads = 2;
+        return caps;
+    };
+
+    bool open(EncoderConfig const& config_) {config = config_; opens++; pictures.clear(); return true;};
+    bool setRate(unsigned bitrate) {config.bitrate = bitrate; rateChanges++; return true;};
+
+    bool submit(unsigned char **planes, int* /*strides*/, int64_t pts, bool key) {
+        MockPicture picture;
+
+        //The payload is coded from the submitted picture and returned with its pts
+        picture.pts = pts;
+        picture.key = key;
+        picture.data.fill(planes[0][0]);
+
+        polled.clear();
+        pictures.push_back(picture);
+        return true;
+    };
+
+    bool poll(EncodedPacket &packet) {
+        if (pictures.size() <= delay) {
+            return false;
+        }
+
+        polled.push_back(pictures.front());
+        pictures.pop_front();
+
+        packet.data = polled.back().data.data();
+        packet.size = polled.back().data.size();
+        packet.pts = polled.back().pts;
+        packet.key = polled.back().key;
+        return true;
+    };
+
+    void close() {};
+
+    EncoderConfig config;
+    unsigned opens;
+    unsigned rateChanges;
+    //Pictures held by the backend
+    unsigned delay;
+
+private:
+    struct MockPicture {
+        int64_t pts;
+        bool key;
+        std::array<unsigned char, 4> data;
+    };
+
+    std::deque<MockPicture> pictures;
+    //Polled packets are valid until the next submit
+    std::deque<MockPicture> polled;
+};
+
+class VideoEncoderPluginMock : public VideoEncoderPlugin {
+public:
+    VideoEncoderPluginMock(EncoderBackend *backend) : VideoEncoderPlugin(backend) {};
+    using VideoEncoderPlugin::doProcessFrame;
+    using VideoEncoderPlugin::configure0;
+};
+
+class VideoEncoderPluginTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(VideoEncoderPluginTest);
+    CPPUNIT_TEST(backendsTest);
+    CPPUNIT_TEST(delayedPacketsTest);
+    CPPUNIT_TEST(burstPacketsTest);
+    CPPUNIT_TEST(inputFormatTest);
+    CPPUNIT_TEST(reconfigTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void backendsTest();
+    void delayedPacketsTest();
+    void burstPacketsTest();
+    void inputFormatTest();
+    void reconfigTest();
+
+    DelayedBackendMock* backend;
+    VideoEncoderPluginMock* encoder;
+    InterleavedVideoFrame* rawFrame;
+    InterleavedVideoFrame* codedFrame;
+};
+
+void VideoEncoderPluginTest::setUp()
+{
+    backend = new DelayedBackendMock();
+    encoder = new VideoEncoderPluginMock(backend);
+    rawFrame = InterleavedVideoFrame::createNew(RAW, WIDTH, HEIGHT, YUV420P);
+    codedFrame = InterleavedVideoFrame::createNew(VP8, LENGTH_VP8);
+}
+
+void VideoEncoderPluginTest::tearDown()
+{
+    delete encoder;
+    delete rawFrame;
+    delete codedFrame;
+}
+
+void VideoEncoderPluginTest::backendsTest()
+{
+    VideoEncoderPlugin *plugin;
+    std::vector<std::string> names;
+
+    CPPUNIT_ASSERT(!VideoEncoderPlugin::createNew("unknown"));
+    CPPUNIT_ASSERT(EncoderBackend::registerBackend("mock", [](){return new DelayedBackendMock();}));
+    CPPUNIT_ASSERT(!EncoderBackend::registerBackend("mock", [](){return new DelayedBackendMock();}));
+    CPPUNIT_ASSERT(!EncoderBackend::registerBackend("", [](){return new DelayedBackendMock();}));
+
+    names = EncoderBackend::getBackends();
+    CPPUNIT_ASSERT(std::find(names.begin(), names.end(), "vp8") != names.end());
+    CPPUNIT_ASSERT(std::find(names.begin(), names.end(), "mock") != names.end());
+
+    plugin = VideoEncoderPlugin::createNew("mock");
+    CPPUNIT_ASSERT(plugin);
+    CPPUNIT_ASSERT(plugin->getType() == PLUGIN_ENCODER);
+    delete plugin;
+}
+
+void VideoEncoderPluginTest::delayedPacketsTest()
+{
+    for (unsigned i = 0; i < 5; i++) {
+        rawFrame->getDataBuf()[0] = i;
+        rawFrame->setPresentationTime(std::chrono::microseconds(i * 40000));
+        rawFrame->setSequenceNumber(i);
+
+        //The first picture is still inside the backend
+        CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame) == (i > 0));
+
+        if (i > 0) {
+            CPPUNIT_ASSERT(codedFrame->getLength() == 4);
+            CPPUNIT_ASSERT(codedFrame->getDataBuf()[0] == i - 1);
+            CPPUNIT_ASSERT(codedFrame->getPresentationTime() == std::chrono::microseconds((i - 1) * 40000));
+            CPPUNIT_ASSERT(codedFrame->getSequenceNumber() == i - 1);
+            CPPUNIT_ASSERT(codedFrame->getWidth() == WIDTH);
+        }
+    }
+
+    CPPUNIT_ASSERT(backend->opens == 1);
+    CPPUNIT_ASSERT(backend->config.width == WIDTH);
+    CPPUNIT_ASSERT(backend->config.height == HEIGHT);
+}
+
+void VideoEncoderPluginTest::burstPacketsTest()
+{
+    backend->delay = 2;
+
+    for (unsigned i = 0; i < 8; i++) {
+        rawFrame->getDataBuf()[0] = i;
+        rawFrame->setPresentationTime(std::chrono::microseconds(i * 40000));
+        rawFrame->setSequenceNumber(i);
+
+        //The backend returns all the pictures it holds with the fourth one
+        if (i == 3) {
+            backend->delay = 0;
+        }
+
+        CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame) == (i > 1));
+
+        //Pictures are written one per frame, the ones returned together are kept for the next frames
+        if (i > 1) {
+            CPPUNIT_ASSERT(codedFrame->getLength() == 4);
+            CPPUNIT_ASSERT(codedFrame->getDataBuf()[0] == i - 2);
+            CPPUNIT_ASSERT(codedFrame->getPresentationTime() == std::chrono::microseconds((i - 2) * 40000));
+            CPPUNIT_ASSERT(codedFrame->getSequenceNumber() == i - 2);
+        }
+    }
+}
+
+void VideoEncoderPluginTest::inputFormatTest()
+{
+    InterleavedVideoFrame *rgbFrame;
+
+    rgbFrame = InterleavedVideoFrame::createNew(RAW, WIDTH, HEIGHT, RGB24);
+    CPPUNIT_ASSERT(!encoder->doProcessFrame(rgbFrame, codedFrame));
+    CPPUNIT_ASSERT(backend->opens == 0);
+    delete rgbFrame;
+}
+
+void VideoEncoderPluginTest::reconfigTest()
+{
+    CPPUNIT_ASSERT(!encoder->configure0(0, 25, 25, 1));
+
+    encoder->doProcessFrame(rawFrame, codedFrame);
+    CPPUNIT_ASSERT(backend->opens == 1);
+
+    //Bitrate changes are applied without reopening the backend
+    CPPUNIT_ASSERT(encoder->configure0(500, VIDEO_DEFAULT_FRAMERATE, DEFAULT_GOP, DEFAULT_THREADS));
+    encoder->doProcessFrame(rawFrame, codedFrame);
+    CPPUNIT_ASSERT(backend->opens == 1);
+    CPPUNIT_ASSERT(backend->rateChanges == 1);
+    CPPUNIT_ASSERT(backend->config.bitrate == 500);
+
+    //Threads are limited to the backend capabilities
+    CPPUNIT_ASSERT(encoder->configure0(500, 30, DEFAULT_GOP, 8));
+    encoder->doProcessFrame(rawFrame, codedFrame);
+    CPPUNIT_ASSERT(backend->opens == 2);
+    CPPUNIT_ASSERT(backend->config.fps == 30);
+    CPPUNIT_ASSERT(backend->config.threads == 2);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VideoEncoderPluginTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("VideoEncoderPluginTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("", false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
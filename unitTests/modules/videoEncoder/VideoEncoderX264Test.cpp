@@ -0,0 +1,404 @@
+/*
+ *  VideoEncoderX264Test.cpp - VideoEncoderX264 class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors:  Marc Palau <marc.palau@i2cat.net>
+ *
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoEncoder/VideoEncoderX264.hh"
+
+class VideoEncoderX264Mock : public VideoEncoderX264
+{
+public:
+    VideoEncoderX264Mock() : VideoEncoderX264() {};
+
+    int getEncoderThreads() {
+        Jzon::Object state;
+        getState(state);
+        return state.Has("encoderThreads") ? state.Get("encoderThreads").ToInt() : 0;
+    };
+
+    using VideoEncoderX264::configure0;
+    using VideoEncoderX264::setThreads;
+    using VideoEncoderX264::configSegments0;
+    using VideoEncoderX264::setAsync;
+    using VideoEncoderX264::setLowLatency;
+    using VideoEncoderX264::doProcessFrame;
+    using VideoEncoderX264::encoderMtx;
+};
+
+/*! Reader of the coded frames, which keeps their presentation times */
+class CodedFramesReaderMock : public TailFilter
+{
+public:
+    CodedFramesReaderMock() : TailFilter() {};
+
+    void readAll() {
+        int ret;
+
+        for (unsigned i = 0; i < ASYNC_QUEUE_SIZE*2; i++) {
+            processFrame(ret);
+        }
+    };
+
+    std::vector<std::chrono::microseconds> times;
+
+protected:
+    bool doProcessFrame(std::map<int, Frame*> &orgFrames, std::vector<int> newFrames) {
+        if (!newFrames.empty()) {
+            times.push_back(orgFrames.begin()->second->getPresentationTime());
+        }
+        return true;
+    };
+
+    void doGetState(Jzon::Object &filterNode) {};
+    bool specificReaderConfig(int /*readerID*/, FrameQueue* /*queue*/) {return true;};
+    bool specificReaderDelete(int /*readerID*/) {return true;};
+};
+
+class VideoEncoderX264Test : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(VideoEncoderX264Test);
+    CPPUNIT_TEST(threadsBudgetTest);
+    CPPUNIT_TEST(segmentThreadsTest);
+    CPPUNIT_TEST(asyncOrderTest);
+    CPPUNIT_TEST(asyncQueueFullTest);
+    CPPUNIT_TEST(asyncReconfigureTest);
+    CPPUNIT_TEST(asyncStopTest);
+    CPPUNIT_TEST(lowLatencySlicesTest);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp();
+    void tearDown();
+
+protected:
+    void threadsBudgetTest();
+    void segmentThreadsTest();
+    void asyncOrderTest();
+    void asyncQueueFullTest();
+    void asyncReconfigureTest();
+    void asyncStopTest();
+    void lowLatencySlicesTest();
+
+    void configAsync();
+    void encode(unsigned frames);
+    bool waitEnabledJobs(unsigned jobs);
+
+    VideoEncoderX264Mock* encoder;
+    CodedFramesReaderMock* reader;
+    InterleavedVideoFrame* rawFrame;
+    SlicedVideoFrame* codedFrame;
+    std::mutex jobsMtx;
+    std::vector<int> enabledJobs;
+    unsigned encodedFrames;
+};
+
+void VideoEncoderX264Test::setUp()
+{
+    encoder = new VideoEncoderX264Mock();
+    reader = new CodedFramesReaderMock();
+    rawFrame = InterleavedVideoFrame::createNew(RAW, 64, 48, YUV420P);
+    rawFrame->setLength(64*48*3/2);
+    codedFrame = SlicedVideoFrame::createNew(H264);
+    encodedFrames = 0;
+
+    encoder->setId(1);
+    reader->setId(2);
+    CPPUNIT_ASSERT(encoder->connectOneToOne(reader));
+
+    //Jobs enabled out of processFrame, which a WorkersPool would run
+    encoder->setJobEnabler([this](std::vector<int> jobs) {
+        std::lock_guard<std::mutex> guard(jobsMtx);
+        enabledJobs.insert(enabledJobs.end(), jobs.begin(), jobs.end());
+    });
+}
+
+void VideoEncoderX264Test::tearDown()
+{
+    delete encoder;
+    delete reader;
+    delete rawFrame;
+    delete codedFrame;
+}
+
+void VideoEncoderX264Test::configAsync()
+{
+    //Pictures are not delayed by x264, so each submitted one completes a frame
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, 25, DEFAULT_GOP, 0, 1, DEFAULT_ANNEXB, "ultrafast", 0));
+    CPPUNIT_ASSERT(encoder->setAsync(true));
+}
+
+void VideoEncoderX264Test::encode(unsigned frames)
+{
+    for (unsigned i = 0; i < frames; i++) {
+        rawFrame->setPresentationTime(std::chrono::microseconds(encodedFrames*40000));
+        rawFrame->setSequenceNumber(encodedFrames);
+        //As the output queue does once the frame is added
+        codedFrame->clear();
+        encoder->doProcessFrame(rawFrame, codedFrame);
+        encodedFrames++;
+    }
+}
+
+bool VideoEncoderX264Test::waitEnabledJobs(unsigned jobs)
+{
+    for (unsigned i = 0; i < 2000; i++) {
+        {
+            std::lock_guard<std::mutex> guard(jobsMtx);
+            if (enabledJobs.size() >= jobs) {
+                return enabledJobs.size() == jobs;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return false;
+}
+
+void VideoEncoderX264Test::threadsBudgetTest()
+{
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, 25, DEFAULT_GOP, DEFAULT_LOOKAHEAD, 2,
+                                       DEFAULT_ANNEXB, DEFAULT_PRESET, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 0);
+
+    encoder->doProcessFrame(rawFrame, codedFrame);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 2);
+
+    //Threads are not changed by x264_encoder_reconfig, so the running encoder is replaced
+    CPPUNIT_ASSERT(!encoder->setThreads(0));
+    CPPUNIT_ASSERT(encoder->setThreads(4));
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 2);
+
+    encoder->doProcessFrame(rawFrame, codedFrame);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 4);
+
+    CPPUNIT_ASSERT(encoder->setThreads(1));
+    encoder->doProcessFrame(rawFrame, codedFrame);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 1);
+}
+
+void VideoEncoderX264Test::segmentThreadsTest()
+{
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, 25, DEFAULT_GOP, 0, 2, DEFAULT_ANNEXB, "ultrafast", 0));
+    CPPUNIT_ASSERT(encoder->configSegments0(1000));
+    encode(1);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 2);
+
+    //Reopening the encoder would start it with an IDR, so it waits for the next segment
+    CPPUNIT_ASSERT(encoder->setThreads(4));
+    encode(24);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 2);
+
+    encode(1);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 4);
+
+    //Going back to the running threads cancels the pending change
+    CPPUNIT_ASSERT(encoder->setThreads(1));
+    CPPUNIT_ASSERT(encoder->setThreads(4));
+    encode(25);
+    CPPUNIT_ASSERT(encoder->getEncoderThreads() == 4);
+}
+
+void VideoEncoderX264Test::asyncOrderTest()
+{
+    configAsync();
+
+    //Asynchronous frames are not written to the coded frame
+    encode(6);
+    CPPUNIT_ASSERT(!codedFrame->getConsumed());
+
+    //Readers are woken up by the encoding thread, without more input frames
+    CPPUNIT_ASSERT(waitEnabledJobs(6));
+    CPPUNIT_ASSERT(std::count(enabledJobs.begin(), enabledJobs.end(), reader->getId()) == 6);
+
+    reader->readAll();
+    CPPUNIT_ASSERT(reader->times.size() == 6);
+
+    for (unsigned i = 0; i < reader->times.size(); i++) {
+        CPPUNIT_ASSERT(reader->times[i] == std::chrono::microseconds(i*40000));
+    }
+}
+
+void VideoEncoderX264Test::asyncQueueFullTest()
+{
+    configAsync();
+    encode(1);
+    CPPUNIT_ASSERT(waitEnabledJobs(1));
+
+    //The encoding thread holds the picture it is coding, so the queue fills up with the following ones
+    {
+        std::lock_guard<std::mutex> guard(encoder->encoderMtx);
+        encode(ASYNC_QUEUE_SIZE + 3);
+    }
+
+    CPPUNIT_ASSERT(waitEnabledJobs(ASYNC_QUEUE_SIZE + 1));
+
+    reader->readAll();
+    CPPUNIT_ASSERT(reader->times.size() == ASYNC_QUEUE_SIZE + 1);
+
+    //Pictures submitted to a full queue are discarded, the queued ones keep their order
+    for (unsigned i = 0; i < reader->times.size(); i++) {
+        CPPUNIT_ASSERT(reader->times[i] == std::chrono::microseconds(i*40000));
+    }
+}
+
+void VideoEncoderX264Test::asyncReconfigureTest()
+{
+    configAsync();
+    encode(1);
+    CPPUNIT_ASSERT(waitEnabledJobs(1));
+
+    {
+        std::lock_guard<std::mutex> guard(encoder->encoderMtx);
+        encode(4);
+    }
+
+    //Reconfiguring the encoder codes the submitted pictures first
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, 25, DEFAULT_GOP*2, 0, 1, DEFAULT_ANNEXB, "ultrafast", 0));
+    encode(1);
+    {
+        std::lock_guard<std::mutex> guard(jobsMtx);
+        CPPUNIT_ASSERT(enabledJobs.size() >= 5);
+    }
+
+    CPPUNIT_ASSERT(waitEnabledJobs(6));
+
+    reader->readAll();
+    CPPUNIT_ASSERT(reader->times.size() == 6);
+
+    for (unsigned i = 0; i < reader->times.size(); i++) {
+        CPPUNIT_ASSERT(reader->times[i] == std::chrono::microseconds(i*40000));
+    }
+}
+
+void VideoEncoderX264Test::asyncStopTest()
+{
+    configAsync();
+    encode(1);
+    CPPUNIT_ASSERT(waitEnabledJobs(1));
+
+    {
+        std::lock_guard<std::mutex> guard(encoder->encoderMtx);
+        encode(3);
+    }
+
+    //Disabling it codes the submitted pictures before the next synchronous one
+    CPPUNIT_ASSERT(encoder->setAsync(false));
+    encode(1);
+    CPPUNIT_ASSERT(codedFrame->getConsumed());
+    CPPUNIT_ASSERT(codedFrame->getPresentationTime() == std::chrono::microseconds(4*40000));
+    {
+        std::lock_guard<std::mutex> guard(jobsMtx);
+        CPPUNIT_ASSERT(enabledJobs.size() == 4);
+    }
+
+    //Low latency mode stops it as well
+    codedFrame->setConsumed(false);
+    CPPUNIT_ASSERT(encoder->setAsync(true));
+    {
+        std::lock_guard<std::mutex> guard(encoder->encoderMtx);
+        encode(2);
+    }
+
+    CPPUNIT_ASSERT(encoder->setLowLatency(true, DEFAULT_SLICE_MAX_SIZE));
+    encode(1);
+    CPPUNIT_ASSERT(codedFrame->getConsumed());
+    {
+        std::lock_guard<std::mutex> guard(jobsMtx);
+        CPPUNIT_ASSERT(enabledJobs.size() > 6);
+    }
+
+    //Low latency slices are published to the queue while encoding, after the asynchronous frames
+    reader->readAll();
+    CPPUNIT_ASSERT(reader->times.size() >= 6);
+
+    for (unsigned i = 0; i < 6; i++) {
+        CPPUNIT_ASSERT(reader->times[i] == std::chrono::microseconds(i*40000 + (i > 3 ? 40000 : 0)));
+    }
+}
+
+void VideoEncoderX264Test::lowLatencySlicesTest()
+{
+    std::vector<size_t> readSlices;
+    InterleavedVideoFrame* noiseFrame = InterleavedVideoFrame::createNew(RAW, 320, 240, YUV420P);
+
+    noiseFrame->setLength(320*240*3/2);
+    for (unsigned i = 0; i < noiseFrame->getLength(); i++) {
+        noiseFrame->getDataBuf()[i] = rand() % 256;
+    }
+
+    //A single thread codes the slices in order, the reader takes the published ones when it is woken up
+    CPPUNIT_ASSERT(encoder->configure0(8000, 25, DEFAULT_GOP, 0, 1, DEFAULT_ANNEXB, "ultrafast", 0));
+    CPPUNIT_ASSERT(encoder->setLowLatency(true, MIN_SLICE_MAX_SIZE));
+    encoder->setJobEnabler([this, &readSlices](std::vector<int> jobs) {
+        if (std::count(jobs.begin(), jobs.end(), reader->getId()) > 0) {
+            reader->readAll();
+            readSlices.push_back(reader->times.size());
+        }
+    });
+
+    noiseFrame->setPresentationTime(std::chrono::microseconds(0));
+    encoder->doProcessFrame(noiseFrame, codedFrame);
+    CPPUNIT_ASSERT(codedFrame->getConsumed());
+
+    //The first slices were read before the last one was coded
+    CPPUNIT_ASSERT(readSlices.size() > 1);
+    CPPUNIT_ASSERT(readSlices.front() > 0);
+    CPPUNIT_ASSERT(readSlices.front() < readSlices.back());
+    CPPUNIT_ASSERT(readSlices.back() == reader->times.size());
+
+    for (unsigned i = 0; i < reader->times.size(); i++) {
+        CPPUNIT_ASSERT(reader->times[i] == std::chrono::microseconds(0));
+    }
+
+    delete noiseFrame;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VideoEncoderX264Test);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("VideoEncoderX264Test.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+    runner.run( "", false );
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}
@@ -24,6 +24,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -37,26 +38,67 @@
 class VideoEncoderX264or5Mock : public VideoEncoderX264or5 
 {
 public:
-    VideoEncoderX264or5Mock() : VideoEncoderX264or5(MASTER, true) {};
+    VideoEncoderX264or5Mock() : VideoEncoderX264or5(), nPlanes(0), fillPicturePlanesRetVal(true), encodeFrameRetVal(true), 
+    reconfigureRetVal(true), reconfigureRateRetVal(true), reconfigurations(0), rateReconfigurations(0) {};
     ~VideoEncoderX264or5Mock(){};
-    bool fillPicturePlanes(unsigned char** data, int* linesize) {return fillPicturePlanesRetVal;};
-    bool encodeFrame(VideoFrame* codedFrame) {return encodeFrameRetVal;};
-    bool reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame) {return reconfigureRetVal;};
+    bool fillPicturePlanes(unsigned char** data, int* linesize, int planes) {
+        nPlanes = planes;
+        for (int i = 0; i < MAX_PLANES; i++) {
+            filledPlanes[i] = data[i];
+            filledStrides[i] = linesize[i];
+        }
+        return fillPicturePlanesRetVal;
+    };
+    bool encodeFrame(VideoFrame* codedFrame) {codedFrame->setConsumed(true); return encodeFrameRetVal;};
+    bool reconfigure(VideoFrame* orgFrame, VideoFrame* dstFrame) {
+        if (needsConfig) {
+            reconfigurations++;
+            needsConfig = false;
+            needsRateConfig = false;
+        }
+        return reconfigureRetVal;
+    };
+    bool reconfigureRate() {rateReconfigurations++; needsRateConfig = false; return reconfigureRateRetVal;};
     void setFillPicturePlanesRetVal(bool val) {fillPicturePlanesRetVal = val;};
     void setEncodeFrameRetVal(bool val) {encodeFrameRetVal = val;};
     void setReconfigureRetVal(bool val) {reconfigureRetVal = val;};
-    FrameQueue *allocQueue(int wId) {return NULL;};
+    void setReconfigureRateRetVal(bool val) {reconfigureRateRetVal = val;};
+    unsigned getReconfigurations() {return reconfigurations;};
+    unsigned getRateReconfigurations() {return rateReconfigurations;};
+    unsigned getBitrate() {return bitrate;};
+    FrameQueue *allocQueue(struct ConnectionData cData) {return NULL;};
+
+    //Planes handed to the encoder by the last frame
+    int nPlanes;
+    unsigned char *filledPlanes[MAX_PLANES];
+    int filledStrides[MAX_PLANES];
+
+    using VideoEncoderX264or5::configure0;
+    using VideoEncoderX264or5::setRate;
+    using VideoEncoderX264or5::setThreads;
+    using VideoEncoderX264or5::doProcessFrame;
+    using VideoEncoderX264or5::getVbvMaxrate;
+    using VideoEncoderX264or5::setOutputTimes;
 
 private:
     bool fillPicturePlanesRetVal;
     bool encodeFrameRetVal;
     bool reconfigureRetVal;
+    bool reconfigureRateRetVal;
+    unsigned reconfigurations;
+    unsigned rateReconfigurations;
 };
 
 class VideoEncoderX264or5Test : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(VideoEncoderX264or5Test);
     CPPUNIT_TEST(configureTest);
+    CPPUNIT_TEST(rateReconfigureTest);
+    CPPUNIT_TEST(threadsReconfigureTest);
+    CPPUNIT_TEST(packedPlanesTest);
+    CPPUNIT_TEST(stridedPlanesTest);
+    CPPUNIT_TEST(planarViewTest);
+    CPPUNIT_TEST(outputTimesTest);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -65,18 +107,31 @@ public:
 
 protected:
     void configureTest();
+    void rateReconfigureTest();
+    void threadsReconfigureTest();
+    void packedPlanesTest();
+    void stridedPlanesTest();
+    void planarViewTest();
+    void outputTimesTest();
 
     VideoEncoderX264or5Mock* encoder;
+    InterleavedVideoFrame* rawFrame;
+    InterleavedVideoFrame* codedFrame;
 };
 
 void VideoEncoderX264or5Test::setUp()
 {
     encoder = new VideoEncoderX264or5Mock();
+    rawFrame = InterleavedVideoFrame::createNew(RAW, 64, 48, YUV420P);
+    rawFrame->setLength(64*48*3/2);
+    codedFrame = InterleavedVideoFrame::createNew(H264, MAX_H264_OR_5_NAL_SIZE);
 }
 
 void VideoEncoderX264or5Test::tearDown()
 {
     delete encoder;
+    delete rawFrame;
+    delete codedFrame;
 }
 
 void VideoEncoderX264or5Test::configureTest()
@@ -96,15 +151,189 @@ void VideoEncoderX264or5Test::configureTest()
     std::string emptyPreset;
     std::string goodPreset = "superfast";
 
-    CPPUNIT_ASSERT(!encoder->configure(badBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(!encoder->configure(goodBitrate, fps1, badGop, goodLookahead1, goodThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(!encoder->configure(goodBitrate, fps1, goodGop, badLookahead, goodThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(!encoder->configure(goodBitrate, fps1, goodGop, goodLookahead1, badThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(!encoder->configure(goodBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, emptyPreset));
-    CPPUNIT_ASSERT(encoder->configure(goodBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(encoder->configure(goodBitrate, fps1, goodGop, goodLookahead2, goodThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(encoder->configure(goodBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, goodPreset));
-    CPPUNIT_ASSERT(encoder->configure(goodBitrate, fps2, goodGop, goodLookahead1, goodThreads, annexb, goodPreset));
+    CPPUNIT_ASSERT(!encoder->configure0(badBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(!encoder->configure0(goodBitrate, fps1, badGop, goodLookahead1, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(!encoder->configure0(goodBitrate, fps1, goodGop, badLookahead, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(!encoder->configure0(goodBitrate, fps1, goodGop, goodLookahead1, badThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(!encoder->configure0(goodBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, emptyPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->configure0(goodBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->configure0(goodBitrate, fps1, goodGop, goodLookahead2, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->configure0(goodBitrate, fps1, goodGop, goodLookahead1, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->configure0(goodBitrate, fps2, goodGop, goodLookahead1, goodThreads, annexb, goodPreset, DEFAULT_BFRAMES));
+}
+
+void VideoEncoderX264or5Test::rateReconfigureTest()
+{
+    int fps = 25;
+
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, fps, DEFAULT_GOP, DEFAULT_LOOKAHEAD, DEFAULT_THREADS, 
+                                       DEFAULT_ANNEXB, DEFAULT_PRESET, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 1);
+    CPPUNIT_ASSERT(encoder->getRateReconfigurations() == 0);
+
+    //A configuration that only changes the bitrate is applied as a rate change
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE*2, fps, DEFAULT_GOP, DEFAULT_LOOKAHEAD, DEFAULT_THREADS, 
+                                       DEFAULT_ANNEXB, DEFAULT_PRESET, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 1);
+    CPPUNIT_ASSERT(encoder->getRateReconfigurations() == 1);
+    CPPUNIT_ASSERT(encoder->getBitrate() == DEFAULT_BITRATE*2);
+
+    //Explicit rate changes never reopen the encoder, even if they fail
+    CPPUNIT_ASSERT(!encoder->setRate(DEFAULT_BITRATE, DEFAULT_BITRATE/2, 0));
+    CPPUNIT_ASSERT(encoder->setRate(DEFAULT_BITRATE, DEFAULT_BITRATE*3, 0));
+    encoder->setReconfigureRateRetVal(false);
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 1);
+    CPPUNIT_ASSERT(encoder->getRateReconfigurations() == 2);
+    CPPUNIT_ASSERT(encoder->getVbvMaxrate() == DEFAULT_BITRATE*3);
+
+    //Frames without rate changes do not touch the rate control
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getRateReconfigurations() == 2);
+
+    //Any other change reopens it
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, fps, DEFAULT_GOP*2, DEFAULT_LOOKAHEAD, DEFAULT_THREADS, 
+                                       DEFAULT_ANNEXB, DEFAULT_PRESET, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 2);
+    CPPUNIT_ASSERT(encoder->getRateReconfigurations() == 2);
+}
+
+void VideoEncoderX264or5Test::threadsReconfigureTest()
+{
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, 25, DEFAULT_GOP, DEFAULT_LOOKAHEAD, DEFAULT_THREADS, 
+                                       DEFAULT_ANNEXB, DEFAULT_PRESET, DEFAULT_BFRAMES));
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 1);
+
+    //Budgets that keep the threads do not touch the encoder
+    CPPUNIT_ASSERT(!encoder->setThreads(0));
+    CPPUNIT_ASSERT(encoder->setThreads(DEFAULT_THREADS));
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 1);
+
+    CPPUNIT_ASSERT(encoder->setThreads(DEFAULT_THREADS + 1));
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->getReconfigurations() == 2);
+    CPPUNIT_ASSERT(encoder->getRateReconfigurations() == 0);
+}
+
+void VideoEncoderX264or5Test::packedPlanesTest()
+{
+    unsigned char *data = rawFrame->getDataBuf();
+
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->nPlanes == 3);
+    CPPUNIT_ASSERT(encoder->filledPlanes[0] == data);
+    CPPUNIT_ASSERT(encoder->filledStrides[0] == 64);
+    CPPUNIT_ASSERT(encoder->filledPlanes[1] == data + 64*48);
+    CPPUNIT_ASSERT(encoder->filledStrides[1] == 32);
+    CPPUNIT_ASSERT(encoder->filledPlanes[2] == data + 64*48 + 32*24);
+    CPPUNIT_ASSERT(encoder->filledStrides[2] == 32);
+}
+
+void VideoEncoderX264or5Test::stridedPlanesTest()
+{
+    const int stride = 80;
+    std::shared_ptr<unsigned char> buffer(new unsigned char[stride*48*3/2], std::default_delete<unsigned char[]>());
+
+    //A view of a frame with padded lines, chroma lines are padded as luma ones
+    rawFrame->setView(buffer, buffer.get(), stride);
+
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->nPlanes == 3);
+    CPPUNIT_ASSERT(encoder->filledPlanes[0] == buffer.get());
+    CPPUNIT_ASSERT(encoder->filledStrides[0] == stride);
+    CPPUNIT_ASSERT(encoder->filledPlanes[1] == buffer.get() + stride*48);
+    CPPUNIT_ASSERT(encoder->filledStrides[1] == stride/2);
+    CPPUNIT_ASSERT(encoder->filledPlanes[2] == buffer.get() + stride*48 + stride/2*24);
+    CPPUNIT_ASSERT(encoder->filledStrides[2] == stride/2);
+    //The whole layout fits in the shared buffer
+    CPPUNIT_ASSERT(encoder->filledPlanes[2] + stride/2*24 == buffer.get() + stride*48*3/2);
+
+    rawFrame->releaseView();
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->filledPlanes[0] == rawFrame->getDataBuf());
+    CPPUNIT_ASSERT(encoder->filledStrides[1] == 32);
+}
+
+void VideoEncoderX264or5Test::planarViewTest()
+{
+    const int lumaStride = 96;
+    const int chromaStride = 64;
+    const int height = 48;
+    std::shared_ptr<unsigned char> buffer(new unsigned char[4096 + lumaStride*height + 2*chromaStride*height/2], 
+                                          std::default_delete<unsigned char[]>());
+    unsigned char *planes[MAX_PLANES] = {NULL};
+    int strides[MAX_PLANES] = {0};
+
+    //Aligned planes with their own strides and gaps between them, as decoders allocate them
+    planes[0] = buffer.get() + 64;
+    planes[1] = planes[0] + lumaStride*height + 1024;
+    planes[2] = planes[1] + chromaStride*height/2 + 1024;
+    strides[0] = lumaStride;
+    strides[1] = chromaStride;
+    strides[2] = chromaStride;
+
+    rawFrame->setPlanarView(buffer, planes, strides);
+    CPPUNIT_ASSERT(rawFrame->isPlanarView());
+    CPPUNIT_ASSERT(rawFrame->isView());
+    CPPUNIT_ASSERT(rawFrame->getDataBuf() == planes[0]);
+    CPPUNIT_ASSERT(rawFrame->getStride() == lumaStride);
+
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->nPlanes == 3);
+
+    for (int i = 0; i < 3; i++) {
+        CPPUNIT_ASSERT(encoder->filledPlanes[i] == planes[i]);
+        CPPUNIT_ASSERT(encoder->filledStrides[i] == strides[i]);
+    }
+
+    CPPUNIT_ASSERT(encoder->filledPlanes[3] == NULL);
+
+    //A regular view drops the planar one
+    rawFrame->setView(buffer, planes[0], lumaStride);
+    CPPUNIT_ASSERT(!rawFrame->isPlanarView());
+    CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    CPPUNIT_ASSERT(encoder->filledPlanes[1] == planes[0] + lumaStride*height);
+}
+
+void VideoEncoderX264or5Test::outputTimesTest()
+{
+    const unsigned fps = 25;
+    const std::chrono::microseconds period(std::micro::den/fps);
+    const std::chrono::microseconds firstTs(1000000);
+
+    CPPUNIT_ASSERT(encoder->configure0(DEFAULT_BITRATE, fps, DEFAULT_GOP, DEFAULT_LOOKAHEAD, DEFAULT_THREADS, 
+                                       DEFAULT_ANNEXB, DEFAULT_PRESET, 2));
+
+    for (unsigned i = 0; i < 4; i++) {
+        rawFrame->setPresentationTime(firstTs + i*period);
+        rawFrame->setSequenceNumber(i);
+        CPPUNIT_ASSERT(encoder->doProcessFrame(rawFrame, codedFrame));
+    }
+
+    //Reordered frame: the P frame with input pts 3 is decoded at the presentation time of input pts 1
+    CPPUNIT_ASSERT(encoder->setOutputTimes(codedFrame, 3, 1));
+    CPPUNIT_ASSERT(codedFrame->getPresentationTime() == firstTs + 3*period);
+    CPPUNIT_ASSERT(codedFrame->getDecodeTime() == firstTs + period);
+    CPPUNIT_ASSERT(codedFrame->getSequenceNumber() == 3);
+
+    //First frames have negative dts, which are extrapolated with the frame period
+    CPPUNIT_ASSERT(encoder->setOutputTimes(codedFrame, 0, -2));
+    CPPUNIT_ASSERT(codedFrame->getPresentationTime() == firstTs);
+    CPPUNIT_ASSERT(codedFrame->getDecodeTime() == firstTs - 2*period);
+    CPPUNIT_ASSERT(codedFrame->getSequenceNumber() == 0);
+
+    //Frames in presentation order are decoded when presented
+    CPPUNIT_ASSERT(encoder->setOutputTimes(codedFrame, 2, 2));
+    CPPUNIT_ASSERT(codedFrame->getDecodeTime() == codedFrame->getPresentationTime());
+
+    //Frames out of the encoder delay are refused
+    CPPUNIT_ASSERT(!encoder->setOutputTimes(codedFrame, 5, 3));
+    CPPUNIT_ASSERT(!encoder->setOutputTimes(codedFrame, -1, -3));
 }
 
 CPPUNIT_TEST_SUITE_REGISTRATION(VideoEncoderX264or5Test);
@@ -0,0 +1,188 @@
+/*
+ *  VideoLadderTest.cpp - VideoLadder class test
+ *  Copyright (C) 2015  Fundació i2CAT, Internet i Innovació digital a Catalunya
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Authors: Marc Palau <marc.palau@i2cat.net>
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TextTestRunner.h>
+#include <cppunit/TestResult.h>
+#include <cppunit/TestResultCollector.h>
+#include <cppunit/XmlOutputter.h>
+
+#include "modules/videoLadder/VideoLadder.hh"
+
+class VideoLadderMock : public VideoLadder {
+public:
+    VideoLadderMock() : VideoLadder(YUV420P) {};
+    using VideoLadder::configRung0;
+    using VideoLadder::configure0;
+    using VideoLadder::allocQueue;
+    using VideoLadder::specificWriterConfig;
+    using VideoLadder::specificWriterDelete;
+    using VideoLadder::doProcessFrame;
+};
+
+class VideoLadderTest : public CppUnit::TestFixture {
+    CPPUNIT_TEST_SUITE(VideoLadderTest);
+    CPPUNIT_TEST(constructorTest);
+    CPPUNIT_TEST(rungConfigTest);
+    CPPUNIT_TEST(streamInfoTest);
+    CPPUNIT_TEST(cascadeTest);
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    void constructorTest();
+    void rungConfigTest();
+    void streamInfoTest();
+    void cascadeTest();
+};
+
+void VideoLadderTest::constructorTest()
+{
+    VideoLadder* ladder;
+
+    ladder = VideoLadder::createNew(P_NONE);
+    CPPUNIT_ASSERT(!ladder);
+
+    ladder = VideoLadder::createNew();
+    CPPUNIT_ASSERT(ladder);
+
+    delete ladder;
+}
+
+void VideoLadderTest::rungConfigTest()
+{
+    VideoLadderMock* ladder;
+    int id = 100;
+
+    ladder = new VideoLadderMock();
+
+    CPPUNIT_ASSERT(!ladder->configRung0(id, 1280, 720));
+
+    CPPUNIT_ASSERT(ladder->specificWriterConfig(id));
+    CPPUNIT_ASSERT(!ladder->specificWriterConfig(id));
+
+    CPPUNIT_ASSERT(ladder->configRung0(id, 1280, 720));
+    CPPUNIT_ASSERT(!ladder->configRung0(id, 0, 720));
+    CPPUNIT_ASSERT(!ladder->configRung0(id, 1280, -1));
+
+    CPPUNIT_ASSERT(ladder->configure0(RGB24, BICUBIC));
+    CPPUNIT_ASSERT(!ladder->configure0(P_NONE, BICUBIC));
+    CPPUNIT_ASSERT(!ladder->configure0(YUV420P, SA_NONE));
+
+    CPPUNIT_ASSERT(ladder->specificWriterDelete(id));
+    CPPUNIT_ASSERT(!ladder->specificWriterDelete(id));
+
+    delete ladder;
+}
+
+void VideoLadderTest::streamInfoTest()
+{
+    VideoLadderMock* ladder;
+    FrameQueue *q720, *q360;
+    ConnectionData cData;
+
+    ladder = new VideoLadderMock();
+
+    cData.writerId = 1;
+    CPPUNIT_ASSERT(!ladder->allocQueue(cData));
+
+    CPPUNIT_ASSERT(ladder->specificWriterConfig(1));
+    CPPUNIT_ASSERT(ladder->specificWriterConfig(2));
+    CPPUNIT_ASSERT(ladder->configRung0(1, 1280, 720));
+    CPPUNIT_ASSERT(ladder->configRung0(2, 640, 360));
+
+    q720 = ladder->allocQueue(cData);
+    cData.writerId = 2;
+    q360 = ladder->allocQueue(cData);
+
+    CPPUNIT_ASSERT(q720 && q360);
+    CPPUNIT_ASSERT(q720->getStreamInfo() != q360->getStreamInfo());
+    CPPUNIT_ASSERT(q720->getStreamInfo()->video.codec == RAW);
+    CPPUNIT_ASSERT(q720->getStreamInfo()->video.pixelFormat == YUV420P);
+    CPPUNIT_ASSERT(q720->getStreamInfo()->video.width == 1280);
+    CPPUNIT_ASSERT(q360->getStreamInfo()->video.height == 360);
+
+    delete q720;
+    delete q360;
+    delete ladder;
+}
+
+void VideoLadderTest::cascadeTest()
+{
+    VideoLadderMock* ladder;
+    InterleavedVideoFrame *org;
+    std::map<int, Frame*> dstFrames;
+    VideoFrame *dst;
+    int widths[] = {640, 1280, 320};
+    int heights[] = {360, 720, 180};
+
+    ladder = new VideoLadderMock();
+    org = InterleavedVideoFrame::createNew(RAW, 1920, 1080, YUV420P);
+    org->setLength(1920*1080*3/2);
+    org->setPresentationTime(std::chrono::microseconds(40000));
+    org->setSequenceNumber(3);
+
+    //Rungs are configured out of order, the ladder sorts them by size
+    for (int id = 0; id < 3; id++) {
+        CPPUNIT_ASSERT(ladder->specificWriterConfig(id));
+        CPPUNIT_ASSERT(ladder->configRung0(id, widths[id], heights[id]));
+        dstFrames[id] = InterleavedVideoFrame::createNew(RAW, 1920, 1080, YUV420P);
+        dstFrames[id]->setConsumed(false);
+    }
+
+    CPPUNIT_ASSERT(ladder->doProcessFrame(org, dstFrames));
+
+    for (int id = 0; id < 3; id++) {
+        dst = dynamic_cast<VideoFrame*>(dstFrames[id]);
+        CPPUNIT_ASSERT(dst->getConsumed());
+        CPPUNIT_ASSERT(dst->getWidth() == widths[id]);
+        CPPUNIT_ASSERT(dst->getHeight() == heights[id]);
+        CPPUNIT_ASSERT(dst->getPixelFormat() == YUV420P);
+        CPPUNIT_ASSERT(dst->getLength() == (unsigned) widths[id]*heights[id]*3/2);
+        CPPUNIT_ASSERT(dst->getPresentationTime() == std::chrono::microseconds(40000));
+        CPPUNIT_ASSERT(dst->getSequenceNumber() == 3);
+        delete dstFrames[id];
+    }
+
+    delete org;
+    delete ladder;
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VideoLadderTest);
+
+int main(int argc, char* argv[])
+{
+    std::ofstream xmlout("VideoLadderTest.xml");
+    CPPUNIT_NS::TextTestRunner runner;
+    CPPUNIT_NS::XmlOutputter *outputter = new CPPUNIT_NS::XmlOutputter(&runner.result(), xmlout);
+
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+    runner.run("", false);
+    outputter->write();
+
+    utils::printMood(runner.result().wasSuccessful());
+    delete outputter;
+
+    return runner.result().wasSuccessful() ? 0 : 1;
+}